@@ -0,0 +1,180 @@
+#include "Arena.h"
+#include "Debug/Debug.h"
+#include <math.h>
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+
+// VARIABLES
+
+static void *	arenas[MAX_PLAYERS + 1];	// The shared geometry of every amount of players, NULL until it is needed
+
+// FUNCTIONS
+
+static void		SetSegment( struct ArenaSegment *segment, struct Point2D start, struct Point2D end );
+
+/*
+====================
+SetSegment
+
+Fills in everything about a segment from its end points.
+====================
+*/
+static void SetSegment( struct ArenaSegment *segment, struct Point2D start, struct Point2D end ) {
+	float angle = atan2f( start.y, start.x );
+
+	segment->start = start;
+	segment->end = end;
+	segment->vector.dx = end.x - start.x;
+	segment->vector.dy = end.y - start.y;
+	segment->length = sqrtf( segment->vector.dx * segment->vector.dx + segment->vector.dy * segment->vector.dy );
+	segment->inverseLength = 1.0f / segment->length;
+	segment->direction.dx = segment->vector.dx * segment->inverseLength;
+	segment->direction.dy = segment->vector.dy * segment->inverseLength;
+	// Right of a clockwise segment is inside.
+	segment->normal.dx = segment->direction.dy;
+	segment->normal.dy = -segment->direction.dx;
+	segment->offset = start.x * segment->normal.dx + start.y * segment->normal.dy;
+	segment->angle = angle < 0.0f ? angle + 2.0f * ( float )M_PI : angle;
+}
+
+/*
+====================
+CreateArenaGeometry
+
+Builds the arena for any amount of players from 2 on. The polygon of three or more
+players is as big as fits into ARENA_EXTENT in both directions. Returns NULL on failure.
+====================
+*/
+struct ArenaGeometry *CreateArenaGeometry( int numPlayers ) {
+	struct ArenaGeometry *	arena;
+	struct Point2D			start;
+	struct Point2D			end;
+	float					angle;
+	float					reach = 0.0f;
+	float					radius;
+	int						i;
+
+	DebugAssert( numPlayers >= 2 );
+	if( numPlayers < 2 ) {
+		return NULL;
+	}
+	arena = calloc( 1, sizeof( struct ArenaGeometry ) );
+	if( !arena ) {
+		return NULL;
+	}
+	arena->numPlayers = numPlayers;
+	arena->numSegments = numPlayers == 2 ? 4 : numPlayers;
+	arena->sectorAngle = 2.0f * ( float )M_PI / numPlayers;
+	arena->segments = calloc( arena->numSegments, sizeof( struct ArenaSegment ) );
+	if( !arena->segments ) {
+		free( arena );
+		return NULL;
+	}
+
+	// Two players have a rectangle with the paddles on the left and right and walls in between.
+	if( numPlayers == 2 ) {
+		static const struct Point2D corners[] = {	{ .x = -ARENA_EXTENT,	.y = -1.0f },
+													{ .x = -ARENA_EXTENT,	.y = 1.0f },
+													{ .x = ARENA_EXTENT,	.y = 1.0f },
+													{ .x = ARENA_EXTENT,	.y = -1.0f } };
+		static const struct Point2D walls[] = {		{ .x = 1.0f,	.y = -1.0f },
+													{ .x = -1.0f,	.y = -1.0f },
+													{ .x = -1.0f,	.y = 1.0f },
+													{ .x = 1.0f,	.y = 1.0f } };
+
+		SetSegment( &arena->segments[0], corners[0], corners[1] );
+		SetSegment( &arena->segments[1], corners[2], corners[3] );
+		SetSegment( &arena->segments[2], walls[0], walls[1] );
+		SetSegment( &arena->segments[3], walls[2], walls[3] );
+		return arena;
+	}
+
+	// Corner i is where the segment of player i starts. The segment of player 0 is centered at the top.
+	for( i = 0; i < numPlayers; i++ ) {
+		angle = ( float )M_PI / 2.0f + arena->sectorAngle / 2.0f - i * arena->sectorAngle;
+		reach = fmaxf( reach, fmaxf( fabsf( cosf( angle ) ), fabsf( sinf( angle ) ) ) );
+	}
+	radius = ARENA_EXTENT / reach;
+	for( i = 0; i < numPlayers; i++ ) {
+		angle = ( float )M_PI / 2.0f + arena->sectorAngle / 2.0f - i * arena->sectorAngle;
+		start.x = radius * cosf( angle );
+		start.y = radius * sinf( angle );
+		end.x = radius * cosf( angle - arena->sectorAngle );
+		end.y = radius * sinf( angle - arena->sectorAngle );
+		SetSegment( &arena->segments[i], start, end );
+	}
+	return arena;
+}
+
+/*
+====================
+DestroyArenaGeometry
+
+Frees an arena made with CreateArenaGeometry.
+====================
+*/
+void DestroyArenaGeometry( struct ArenaGeometry *arena ) {
+	if( arena ) {
+		free( arena->segments );
+		free( arena );
+	}
+}
+
+/*
+====================
+GetArenaGeometry
+
+Returns the arena for the given amount of players, which is built the first time it is
+needed and shared by all matches from then on. It lives as long as the program.
+Returns NULL if there can't be that many players.
+====================
+*/
+const struct ArenaGeometry *GetArenaGeometry( int numPlayers ) {
+	struct ArenaGeometry *arena;
+
+	if( numPlayers < 2 || numPlayers > MAX_PLAYERS ) {
+		return NULL;
+	}
+	arena = SDL_AtomicGetPtr( &arenas[numPlayers] );
+	if( arena ) {
+		return arena;
+	}
+
+	// Two threads may build the same arena at once, then the one that comes second throws its own away.
+	arena = CreateArenaGeometry( numPlayers );
+	if( arena && !SDL_AtomicCASPtr( &arenas[numPlayers], NULL, arena ) ) {
+		DestroyArenaGeometry( arena );
+		arena = SDL_AtomicGetPtr( &arenas[numPlayers] );
+	}
+	return arena;
+}
+
+/*
+====================
+GetArenaSegment
+
+Returns the player whose sector of the arena the point is in. The point belongs to
+the segment whose line is closest. Going from one segment to the next crosses the boundary
+between their half-planes, the ray from the center through their shared corner, so comparing
+the distances along the inward normals is the same as testing the point against those
+boundaries. That takes two multiplies and a compare per player, and the selects compile
+without branches.
+====================
+*/
+int GetArenaSegment( const struct ArenaGeometry *arena, struct Point2D point ) {
+	const struct ArenaSegment *	segment = arena->segments;
+	float						dx = point.x - arena->center.x;
+	float						dy = point.y - arena->center.y;
+	float						closest = dx * segment[0].normal.dx + dy * segment[0].normal.dy;
+	float						distance;
+	int							result = 0;
+	int							player;
+
+	// Ties keep the lower ID, so the center itself belongs to player 0.
+	for( player = 1; player < arena->numPlayers; player++ ) {
+		distance = dx * segment[player].normal.dx + dy * segment[player].normal.dy;
+		result = distance < closest ? player : result;
+		closest = distance < closest ? distance : closest;
+	}
+	return result;
+}
@@ -0,0 +1,54 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include "Game.h"
+
+#define ARENA_EXTENT 0.9f		// The arena reaches this far from the center along either axis
+
+/*
+==========================================================
+
+One side of the arena. For the players, it goes clockwise
+from where their paddle position is 0 to where it is 1. The
+inside of the arena is on its right.
+
+==========================================================
+*/
+struct ArenaSegment {
+	struct Point2D	start;
+	struct Point2D	end;
+	struct Vector2D	vector;			// From start to end
+	struct Vector2D	direction;		// The vector scaled to length 1
+	struct Vector2D	normal;			// Unit normal that points into the arena, also what GetArenaSegment sorts points by
+	float			offset;			// start * normal, so that p * normal - offset is how far p is inside
+	float			length;
+	float			inverseLength;
+	float			angle;			// Of the start around the center, counterclockwise from the x axis, in [0, 2 * PI)
+};
+
+/*
+==========================================================
+
+The shape of the arena for a given amount of players. With
+three or more players it is a regular polygon around the
+center with one side per player, player 0 at the top and
+the others following clockwise. Two players face each other
+left and right, with walls at the top and bottom. Built once
+and never changed, so any number of threads may read it.
+
+==========================================================
+*/
+struct ArenaGeometry {
+	int						numPlayers;
+	int						numSegments;	// The players' segments first, in the order of their IDs, then the walls
+	struct ArenaSegment *	segments;
+	struct Point2D			center;			// Where the ball starts
+	float					sectorAngle;	// 2 * PI / numPlayers, the angle every player's segment spans around the center
+};
+
+struct ArenaGeometry *			CreateArenaGeometry( int numPlayers );
+void							DestroyArenaGeometry( struct ArenaGeometry *arena );
+const struct ArenaGeometry *	GetArenaGeometry( int numPlayers );
+int								GetArenaSegment( const struct ArenaGeometry *arena, struct Point2D point );
+
+#endif
@@ -0,0 +1,361 @@
+#include "Balls.h"
+#include "Physics.h"
+#include "Debug/Debug.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#define BALLS_SSE2
+#endif
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#include <immintrin.h>
+#define BALLS_AVX2
+#endif
+
+#define BALLS_ALIGNMENT 32		// Bytes, so that every array starts where an AVX register load wants it
+
+// FUNCTIONS
+
+#ifdef BALLS_SSE2
+static int		SweepBallsSse2( struct BallSet *balls, const struct ArenaGeometry *arena, float deltaSeconds );
+#endif
+#ifdef BALLS_AVX2
+static int		SweepBallsAvx2( struct BallSet *balls, const struct ArenaGeometry *arena, float deltaSeconds );
+#endif
+
+/*
+====================
+CreateBallSet
+
+Makes room for at least capacity balls, all in one block. Returns 0 on success and -1 on failure.
+====================
+*/
+int CreateBallSet( struct BallSet *balls, int capacity ) {
+	size_t	floats;
+	char *	aligned;
+
+	memset( balls, 0, sizeof( *balls ) );
+	if( capacity < 1 ) {
+		capacity = 1;
+	}
+	balls->capacity = ( capacity + BALLS_LANES - 1 ) / BALLS_LANES * BALLS_LANES;
+	floats = balls->capacity * sizeof( float );
+	balls->memory = calloc( 1, BALLS_ALIGNMENT + 4 * floats + 5 * balls->capacity * sizeof( int ) + BALLS_GRID_CELLS * sizeof( int ) );
+	if( !balls->memory ) {
+		DebugPrintF( "Could not allocate %d balls.", balls->capacity );
+		return -1;
+	}
+
+	// floats is a multiple of BALLS_LANES floats, so every array stays aligned.
+	aligned = ( char * )balls->memory + BALLS_ALIGNMENT - ( uintptr_t )balls->memory % BALLS_ALIGNMENT;
+	balls->x = ( float * )aligned;
+	balls->y = ( float * )( aligned + floats );
+	balls->dx = ( float * )( aligned + 2 * floats );
+	balls->dy = ( float * )( aligned + 3 * floats );
+	balls->lastHit = ( int * )( aligned + 4 * floats );
+	balls->touching = balls->lastHit + balls->capacity;
+	balls->cell = balls->touching + balls->capacity;
+	balls->nextInCell = balls->cell + balls->capacity;
+	balls->previousInCell = balls->nextInCell + balls->capacity;
+	balls->cellHeads = balls->previousInCell + balls->capacity;
+	memset( balls->cell, -1, balls->capacity * sizeof( int ) );
+	memset( balls->cellHeads, -1, BALLS_GRID_CELLS * sizeof( int ) );
+	return 0;
+}
+
+/*
+====================
+DestroyBallSet
+
+Frees the balls made with CreateBallSet.
+====================
+*/
+void DestroyBallSet( struct BallSet *balls ) {
+	free( balls->memory );
+	memset( balls, 0, sizeof( *balls ) );
+}
+
+/*
+====================
+AddBall
+
+Adds a ball that nobody has hit yet. Returns its index, or -1 if the set is full.
+====================
+*/
+int AddBall( struct BallSet *balls, struct Ball ball ) {
+	if( balls->numBalls == balls->capacity ) {
+		return -1;
+	}
+	SetBall( balls, balls->numBalls, ball );
+	balls->lastHit[balls->numBalls] = -1;
+	return balls->numBalls++;
+}
+
+/*
+====================
+GetBall
+
+Returns the ball at index as a struct, for the code that handles one ball at a time.
+====================
+*/
+struct Ball GetBall( const struct BallSet *balls, int index ) {
+	struct Ball ball;
+
+	ball.position.x = balls->x[index];
+	ball.position.y = balls->y[index];
+	ball.direction.dx = balls->dx[index];
+	ball.direction.dy = balls->dy[index];
+	return ball;
+}
+
+/*
+====================
+SetBall
+
+Writes a ball back to index.
+====================
+*/
+void SetBall( struct BallSet *balls, int index, struct Ball ball ) {
+	balls->x[index] = ball.position.x;
+	balls->y[index] = ball.position.y;
+	balls->dx[index] = ball.direction.dx;
+	balls->dy[index] = ball.direction.dy;
+}
+
+/*
+====================
+GetBallCell
+
+Returns the cell of the grid a point is in. Points beyond the edge of the grid are in the cells along it.
+====================
+*/
+int GetBallCell( float x, float y ) {
+	int column = ( int )( ( x + 1.0f ) * ( BALLS_GRID_SIZE / 2.0f ) );
+	int row = ( int )( ( y + 1.0f ) * ( BALLS_GRID_SIZE / 2.0f ) );
+
+	column = column < 0 ? 0 : column >= BALLS_GRID_SIZE ? BALLS_GRID_SIZE - 1 : column;
+	row = row < 0 ? 0 : row >= BALLS_GRID_SIZE ? BALLS_GRID_SIZE - 1 : row;
+	return row * BALLS_GRID_SIZE + column;
+}
+
+/*
+====================
+UpdateBallGrid
+
+Moves the balls that left their cell since the last update to the list of their new one.
+Within one tick only a few balls cross into another cell, so this is much cheaper than
+building the grid anew.
+====================
+*/
+void UpdateBallGrid( struct BallSet *balls ) {
+	int cell;
+	int ball;
+
+	for( ball = 0; ball < balls->numBalls; ball++ ) {
+		cell = GetBallCell( balls->x[ball], balls->y[ball] );
+		if( cell == balls->cell[ball] ) {
+			continue;
+		}
+
+		// Take the ball out of its old list.
+		if( balls->cell[ball] != -1 ) {
+			if( balls->previousInCell[ball] != -1 ) {
+				balls->nextInCell[balls->previousInCell[ball]] = balls->nextInCell[ball];
+			} else {
+				balls->cellHeads[balls->cell[ball]] = balls->nextInCell[ball];
+			}
+			if( balls->nextInCell[ball] != -1 ) {
+				balls->previousInCell[balls->nextInCell[ball]] = balls->previousInCell[ball];
+			}
+		}
+
+		// And put it in front of the new one.
+		balls->cell[ball] = cell;
+		balls->previousInCell[ball] = -1;
+		balls->nextInCell[ball] = balls->cellHeads[cell];
+		if( balls->cellHeads[cell] != -1 ) {
+			balls->previousInCell[balls->cellHeads[cell]] = ball;
+		}
+		balls->cellHeads[cell] = ball;
+	}
+}
+
+/*
+====================
+SweepBalls
+
+Moves every ball that touches no segment of the arena within deltaSeconds all the way and
+lists the others in balls->touching, in ascending order, without moving them. A ball
+touches a segment when it moves towards its line and ends up closer to it than its radius.
+Returns the amount of touching balls. Uses the widest kernel the processor has, all of
+which give exactly the same results as SweepBallsScalar.
+====================
+*/
+int SweepBalls( struct BallSet *balls, const struct ArenaGeometry *arena, float deltaSeconds ) {
+#ifdef BALLS_AVX2
+	if( SDL_HasAVX2() ) {
+		return SweepBallsAvx2( balls, arena, deltaSeconds );
+	}
+#endif
+#ifdef BALLS_SSE2
+	return SweepBallsSse2( balls, arena, deltaSeconds );
+#else
+	return SweepBallsScalar( balls, arena, deltaSeconds );
+#endif
+}
+
+/*
+====================
+GetBallKernelName
+
+Returns the name of the kernel SweepBalls uses on this processor.
+====================
+*/
+const char *GetBallKernelName( void ) {
+#ifdef BALLS_AVX2
+	if( SDL_HasAVX2() ) {
+		return "AVX2";
+	}
+#endif
+#ifdef BALLS_SSE2
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+/*
+====================
+SweepBallsScalar
+
+SweepBalls one ball at a time, for processors without a kernel of their own and to check the others against.
+====================
+*/
+int SweepBallsScalar( struct BallSet *balls, const struct ArenaGeometry *arena, float deltaSeconds ) {
+	const struct ArenaSegment *	segment;
+	float						endX;
+	float						endY;
+	int							numTouching = 0;
+	int							touches;
+	int							ball;
+	int							i;
+
+	for( ball = 0; ball < balls->numBalls; ball++ ) {
+		endX = balls->x[ball] + balls->dx[ball] * deltaSeconds;
+		endY = balls->y[ball] + balls->dy[ball] * deltaSeconds;
+		touches = 0;
+		for( i = 0; i < arena->numSegments; i++ ) {
+			segment = &arena->segments[i];
+			touches |= ( balls->dx[ball] * segment->normal.dx + balls->dy[ball] * segment->normal.dy < 0.0f )
+				& ( endX * segment->normal.dx + endY * segment->normal.dy - ( segment->offset + DEFAULT_BALL_RADIUS ) <= 0.0f );
+		}
+		if( touches ) {
+			balls->touching[numTouching++] = ball;
+		} else {
+			balls->x[ball] = endX;
+			balls->y[ball] = endY;
+		}
+	}
+	return numTouching;
+}
+
+#ifdef BALLS_SSE2
+/*
+====================
+SweepBallsSse2
+
+SweepBalls four balls at a time.
+====================
+*/
+static int SweepBallsSse2( struct BallSet *balls, const struct ArenaGeometry *arena, float deltaSeconds ) {
+	const struct ArenaSegment *	segment;
+	__m128						seconds = _mm_set1_ps( deltaSeconds );
+	__m128						zero = _mm_setzero_ps();
+	__m128						x, y, dx, dy, endX, endY;
+	__m128						normalX, normalY, limit, touches;
+	int							numTouching = 0;
+	int							mask;
+	int							ball;
+	int							i;
+
+	for( ball = 0; ball < balls->numBalls; ball += 4 ) {
+		x = _mm_load_ps( &balls->x[ball] );
+		y = _mm_load_ps( &balls->y[ball] );
+		dx = _mm_load_ps( &balls->dx[ball] );
+		dy = _mm_load_ps( &balls->dy[ball] );
+		endX = _mm_add_ps( x, _mm_mul_ps( dx, seconds ) );
+		endY = _mm_add_ps( y, _mm_mul_ps( dy, seconds ) );
+		touches = zero;
+		for( i = 0; i < arena->numSegments; i++ ) {
+			segment = &arena->segments[i];
+			normalX = _mm_set1_ps( segment->normal.dx );
+			normalY = _mm_set1_ps( segment->normal.dy );
+			limit = _mm_set1_ps( segment->offset + DEFAULT_BALL_RADIUS );
+			touches = _mm_or_ps( touches, _mm_and_ps(
+				_mm_cmplt_ps( _mm_add_ps( _mm_mul_ps( dx, normalX ), _mm_mul_ps( dy, normalY ) ), zero ),
+				_mm_cmple_ps( _mm_sub_ps( _mm_add_ps( _mm_mul_ps( endX, normalX ), _mm_mul_ps( endY, normalY ) ), limit ), zero ) ) );
+		}
+
+		// Only the balls that touch nothing move, the padding never does.
+		_mm_store_ps( &balls->x[ball], _mm_or_ps( _mm_and_ps( touches, x ), _mm_andnot_ps( touches, endX ) ) );
+		_mm_store_ps( &balls->y[ball], _mm_or_ps( _mm_and_ps( touches, y ), _mm_andnot_ps( touches, endY ) ) );
+		for( mask = _mm_movemask_ps( touches ); mask; mask &= mask - 1 ) {
+			balls->touching[numTouching++] = ball + __builtin_ctz( mask );
+		}
+	}
+	return numTouching;
+}
+#endif
+
+#ifdef BALLS_AVX2
+/*
+====================
+SweepBallsAvx2
+
+SweepBalls eight balls at a time. Compiled for AVX2 whatever the rest of the program is
+compiled for, so SweepBalls must only call it after asking the processor.
+====================
+*/
+__attribute__(( target( "avx2" ) ))
+static int SweepBallsAvx2( struct BallSet *balls, const struct ArenaGeometry *arena, float deltaSeconds ) {
+	const struct ArenaSegment *	segment;
+	__m256						seconds = _mm256_set1_ps( deltaSeconds );
+	__m256						zero = _mm256_setzero_ps();
+	__m256						x, y, dx, dy, endX, endY;
+	__m256						normalX, normalY, limit, touches;
+	int							numTouching = 0;
+	int							mask;
+	int							ball;
+	int							i;
+
+	for( ball = 0; ball < balls->numBalls; ball += 8 ) {
+		x = _mm256_load_ps( &balls->x[ball] );
+		y = _mm256_load_ps( &balls->y[ball] );
+		dx = _mm256_load_ps( &balls->dx[ball] );
+		dy = _mm256_load_ps( &balls->dy[ball] );
+		endX = _mm256_add_ps( x, _mm256_mul_ps( dx, seconds ) );
+		endY = _mm256_add_ps( y, _mm256_mul_ps( dy, seconds ) );
+		touches = zero;
+		for( i = 0; i < arena->numSegments; i++ ) {
+			segment = &arena->segments[i];
+			normalX = _mm256_set1_ps( segment->normal.dx );
+			normalY = _mm256_set1_ps( segment->normal.dy );
+			limit = _mm256_set1_ps( segment->offset + DEFAULT_BALL_RADIUS );
+			touches = _mm256_or_ps( touches, _mm256_and_ps(
+				_mm256_cmp_ps( _mm256_add_ps( _mm256_mul_ps( dx, normalX ), _mm256_mul_ps( dy, normalY ) ), zero, _CMP_LT_OQ ),
+				_mm256_cmp_ps( _mm256_sub_ps( _mm256_add_ps( _mm256_mul_ps( endX, normalX ), _mm256_mul_ps( endY, normalY ) ), limit ), zero, _CMP_LE_OQ ) ) );
+		}
+
+		// Only the balls that touch nothing move, the padding never does.
+		_mm256_store_ps( &balls->x[ball], _mm256_blendv_ps( endX, x, touches ) );
+		_mm256_store_ps( &balls->y[ball], _mm256_blendv_ps( endY, y, touches ) );
+		for( mask = _mm256_movemask_ps( touches ); mask; mask &= mask - 1 ) {
+			balls->touching[numTouching++] = ball + __builtin_ctz( mask );
+		}
+	}
+	return numTouching;
+}
+#endif
@@ -0,0 +1,51 @@
+#ifndef _BALLS_H
+#define _BALLS_H
+
+#include "Game.h"
+#include "Arena.h"
+
+#define BALLS_LANES 8		// Balls the widest kernel handles at once, capacities are rounded up to this
+#define BALLS_GRID_SIZE 20	// Rows and columns of the grid over [-1, 1] x [-1, 1], so that no cell is narrower than a ball
+#define BALLS_GRID_CELLS ( BALLS_GRID_SIZE * BALLS_GRID_SIZE )
+
+/*
+==========================================================
+
+Any amount of balls, stored as one array per coordinate so
+that the kernels can load several balls at once. The arrays
+are padded up to capacity with balls that stand still at
+the center and never touch anything.
+
+==========================================================
+*/
+struct BallSet {
+	int		numBalls;
+	int		capacity;		// A multiple of BALLS_LANES
+	float *	x;
+	float *	y;
+	float *	dx;
+	float *	dy;
+	int *	lastHit;		// The player who hit each ball last, -1 if nobody has since it was reset
+	int *	touching;		// The balls the last sweep left for BallLogic to bounce, see SweepBalls
+
+	// Every cell of the grid has a doubly linked list of the balls in it, see UpdateBallGrid.
+	int *	cell;			// The cell every ball was in when the grid was last updated, -1 for none yet
+	int *	nextInCell;		// -1 ends the list
+	int *	previousInCell;	// -1 for the first ball of a cell
+	int *	cellHeads;		// The first ball of every cell, -1 for an empty one
+
+	void *	memory;			// The block all of the above live in
+};
+
+int				CreateBallSet( struct BallSet *balls, int capacity );
+void			DestroyBallSet( struct BallSet *balls );
+int				AddBall( struct BallSet *balls, struct Ball ball );
+struct Ball		GetBall( const struct BallSet *balls, int index );
+void			SetBall( struct BallSet *balls, int index, struct Ball ball );
+int				SweepBalls( struct BallSet *balls, const struct ArenaGeometry *arena, float deltaSeconds );
+int				SweepBallsScalar( struct BallSet *balls, const struct ArenaGeometry *arena, float deltaSeconds );
+const char *	GetBallKernelName( void );
+void			UpdateBallGrid( struct BallSet *balls );
+int				GetBallCell( float x, float y );
+
+#endif
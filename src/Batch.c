@@ -0,0 +1,223 @@
+#include "Batch.h"
+#include "Main.h"
+#include "Arena.h"
+#include "Random.h"
+#include "Debug/Debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// VARIABLES
+
+int64_t						batchMatches = 0;			// Set with --simulate, 0 if we don't simulate
+const char *				batchStatisticsPath = BATCH_STATISTICS_FILE;	// Set with --stats
+struct SimulationParameters	batchParameters = {			// Changed with --simulation
+	.tickRate = DEFAULT_TICK_RATE,
+	.physics = DEFAULT_PHYSICS_PARAMETERS,
+	.pointsToWin = SIMULATION_POINTS_TO_WIN,
+	.maxTicks = SIMULATION_MAX_SECONDS * DEFAULT_TICK_RATE
+};
+
+// Imported from Game.
+extern int		gameDedicatedPlayers;
+extern uint64_t	gameSeed;
+// Imported from Server.
+extern int	serverThreads;
+
+// FUNCTIONS
+
+static int		TakeMatches( struct BatchWorker *worker, int64_t *first, int64_t *last );
+static int		StealMatches( struct BatchWorker *worker );
+static int		BatchThread( void *data );
+
+/*
+====================
+TakeMatches
+
+Takes up to BATCH_CHUNK matches from the front of the worker's range, stealing a new
+range first if it is empty. Returns 0 if there is nothing left to run.
+====================
+*/
+static int TakeMatches( struct BatchWorker *worker, int64_t *first, int64_t *last ) {
+	do {
+		SDL_AtomicLock( &worker->lock );
+		*first = worker->next;
+		*last = worker->end - worker->next > BATCH_CHUNK ? worker->next + BATCH_CHUNK : worker->end;
+		worker->next = *last;
+		SDL_AtomicUnlock( &worker->lock );
+		if( *first < *last ) {
+			return 1;
+		}
+	} while( StealMatches( worker ) );
+	return 0;
+}
+
+/*
+====================
+StealMatches
+
+Moves the back half of the largest range of the other workers to this worker, whose own
+range is empty. Only one lock is held at a time: the stolen matches belong to nobody but
+this worker in between. Returns 0 if all other ranges were empty.
+====================
+*/
+static int StealMatches( struct BatchWorker *worker ) {
+	struct BatchPool *		pool = worker->pool;
+	struct BatchWorker *	victim = NULL;
+	int64_t					largest = 0;
+	int64_t					remaining;
+	int64_t					middle;
+	int64_t					end;
+	int						i;
+
+	// Without locks this is only a guess, which is all we need to pick a victim.
+	for( i = 0; i < pool->numWorkers; i++ ) {
+		remaining = pool->workers[i].end - pool->workers[i].next;
+		if( &pool->workers[i] != worker && remaining > largest ) {
+			largest = remaining;
+			victim = &pool->workers[i];
+		}
+	}
+	if( !victim ) {
+		return 0;
+	}
+
+	SDL_AtomicLock( &victim->lock );
+	end = victim->end;
+	middle = victim->next + ( victim->end - victim->next ) / 2;
+	victim->end = middle;
+	SDL_AtomicUnlock( &victim->lock );
+
+	// The victim may have run most of it meanwhile; an empty steal just means we look again.
+	SDL_AtomicLock( &worker->lock );
+	worker->next = middle < end ? middle : end;
+	worker->end = end;
+	SDL_AtomicUnlock( &worker->lock );
+	worker->numSteals++;
+	return 1;
+}
+
+/*
+====================
+BatchThread
+
+Runs matches of the pool with TrackingBot in every seat until there are none left.
+====================
+*/
+static int BatchThread( void *data ) {
+	struct BatchWorker *	worker = data;
+	struct BatchPool *		pool = worker->pool;
+	struct SimulationMatch	match;
+	int64_t					first;
+	int64_t					last;
+	int64_t					i;
+
+	while( TakeMatches( worker, &first, &last ) ) {
+		for( i = first; i < last; i++ ) {
+			InitializeSimulationMatch( &match, pool->parameters, pool->arena, &worker->statistics, GetRandom( pool->seed, ( uint64_t )i ) );
+			RunSimulationMatch( &match, &TrackingBot, &pool->skill );
+		}
+	}
+	return 0;
+}
+
+/*
+====================
+RunSimulationBatch
+
+Simulates numMatches matches of numPlayers players on numWorkers threads, or one per
+processor if numWorkers is 0, and adds up what happened in statistics. The same seed
+always gives the same statistics, however many threads there are. Returns 0 on success.
+====================
+*/
+int RunSimulationBatch( const struct SimulationParameters *parameters, int numPlayers, int64_t numMatches, int numWorkers, uint64_t seed, struct SimulationStatistics *statistics ) {
+	struct BatchPool	pool;
+	int					i;
+
+	pool.arena = GetArenaGeometry( numPlayers );
+	if( !pool.arena || numMatches < 1 ) {
+		return -1;
+	}
+	if( numWorkers < 1 ) {
+		numWorkers = SDL_GetCPUCount() > 0 ? SDL_GetCPUCount() : 1;
+	}
+	if( numWorkers > numMatches ) {
+		numWorkers = ( int )numMatches;
+	}
+	pool.workers = calloc( numWorkers, sizeof( struct BatchWorker ) );
+	if( !pool.workers ) {
+		return -1;
+	}
+	pool.numWorkers = numWorkers;
+	pool.parameters = parameters;
+	pool.skill.aimSpread = BATCH_BOT_AIM_SPREAD;
+	pool.skill.deadZone = BATCH_BOT_DEAD_ZONE;
+	pool.seed = seed;
+
+	// Every worker starts with an even share, all ranges are set before any thread starts.
+	for( i = 0; i < numWorkers; i++ ) {
+		pool.workers[i].pool = &pool;
+		pool.workers[i].next = i * numMatches / numWorkers;
+		pool.workers[i].end = ( i + 1 ) * numMatches / numWorkers;
+	}
+	for( i = 0; i < numWorkers; i++ ) {
+		pool.workers[i].thread = SDL_CreateThread( &BatchThread, "Batch", &pool.workers[i] );
+		DebugAssert( pool.workers[i].thread );
+	}
+	// A worker that could not start leaves its range to be stolen; only if none started do we run it here.
+	for( i = 0; i < numWorkers && !pool.workers[i].thread; i++ );
+	if( i == numWorkers ) {
+		BatchThread( &pool.workers[0] );
+	}
+
+	for( i = 0; i < numWorkers; i++ ) {
+		if( pool.workers[i].thread ) {
+			SDL_WaitThread( pool.workers[i].thread, NULL );
+		}
+		AddSimulationStatistics( statistics, &pool.workers[i].statistics );
+		DebugPrintF( "Batch worker %d stole %d times.", i, pool.workers[i].numSteals );
+	}
+
+	free( pool.workers );
+	return 0;
+}
+
+/*
+====================
+RunBatch
+
+Simulates batchMatches matches of gameDedicatedPlayers bots on serverThreads threads and
+writes the statistics to batchStatisticsPath. gameSeed seeds the batch, 0 included.
+====================
+*/
+enum ProgramState RunBatch( void ) {
+	struct SimulationStatistics	statistics = { 0 };
+	uint64_t					start = SDL_GetPerformanceCounter();
+	double						seconds;
+
+	printf( "Simulating %lld matches of %d players...\n", ( long long )batchMatches, gameDedicatedPlayers );
+	if( RunSimulationBatch( &batchParameters, gameDedicatedPlayers, batchMatches, serverThreads, gameSeed, &statistics ) ) {
+		printf( "Could not run the simulation.\n" );
+		return PS_QUIT;
+	}
+	seconds = ( SDL_GetPerformanceCounter() - start ) / ( double )SDL_GetPerformanceFrequency();
+	printf( "Simulated %llu matches in %.2f seconds, %.0f matches and %.0f ticks per second.\n",
+			( unsigned long long )statistics.numMatches, seconds, statistics.numMatches / seconds, statistics.numTicks / seconds );
+
+	if( WriteSimulationStatistics( batchStatisticsPath, &statistics, &batchParameters, gameDedicatedPlayers ) ) {
+		printf( "Could not write the statistics to %s.\n", batchStatisticsPath );
+	} else {
+		printf( "Wrote the statistics to %s.\n", batchStatisticsPath );
+	}
+	return PS_QUIT;
+}
+
+/*
+====================
+IsBatch
+
+Determines whether the program simulates matches instead of running the game.
+====================
+*/
+int IsBatch( void ) {
+	return batchMatches > 0;
+}
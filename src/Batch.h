@@ -0,0 +1,53 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <stdint.h>
+#include <SDL2/SDL.h>
+#include "Simulation.h"
+
+#define BATCH_STATISTICS_FILE "simulation.txt"	// Where a batch writes its statistics unless --stats says otherwise
+#define BATCH_CHUNK 256					// Matches a worker takes from its own range at once
+#define BATCH_BOT_AIM_SPREAD 1.5f		// How far off the middle of the paddle the bots aim, see TrackingBotSkill
+#define BATCH_BOT_DEAD_ZONE 0.0125f		// How close to its target the paddle of a bot stops
+
+/*
+==========================================================
+
+A thread that simulates matches. It owns the range of match
+numbers [next, end) and runs them from the front. A worker
+whose range is empty steals the back half of the largest
+range of another one, and returns when nothing is left.
+
+==========================================================
+*/
+struct BatchWorker {
+	SDL_Thread *				thread;
+	SDL_SpinLock				lock;			// Guards next and end
+	int64_t						next;
+	int64_t						end;
+	int							numSteals;
+	struct BatchPool *			pool;
+	struct SimulationStatistics	statistics;		// Of the matches this worker ran
+};
+
+/*
+==========================================================
+
+What all workers of a batch share.
+
+==========================================================
+*/
+struct BatchPool {
+	struct BatchWorker *				workers;
+	int									numWorkers;
+	const struct SimulationParameters *	parameters;
+	const struct ArenaGeometry *		arena;
+	struct TrackingBotSkill				skill;
+	uint64_t							seed;		// Match i is seeded with GetRandom( seed, i )
+};
+
+enum ProgramState	RunBatch( void );
+int					IsBatch( void );
+int					RunSimulationBatch( const struct SimulationParameters *parameters, int numPlayers, int64_t numMatches, int numWorkers, uint64_t seed, struct SimulationStatistics *statistics );
+
+#endif
@@ -0,0 +1,599 @@
+#include "Benchmark.h"
+#include "Main.h"
+#include "Game.h"
+#include "Server.h"
+#include "Physics.h"
+#include "Replay.h"
+#include "Arena.h"
+#include "Balls.h"
+#include "Snapshot.h"
+#include "Debug/Debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+// TYPES
+
+/*
+==========================================================
+
+A function that runs one benchmark and prints its results.
+Returns 0 on success.
+
+==========================================================
+*/
+typedef int( *benchmarkFunction_t )( void );
+
+/*
+==========================================================
+
+A couple of a name and the implementation function of a benchmark.
+
+==========================================================
+*/
+struct BenchmarkNameFunctionCouple {
+	const char *		name;
+	benchmarkFunction_t	function;
+	const char *		description;
+};
+
+// VARIABLES
+
+const char *	benchmarkName = NULL;	// Set with --benchmark
+
+// Imported from Game.
+extern int		gameTickRate;
+extern int		gameDedicatedPlayers;
+// Imported from Server.
+extern int		serverMatches;
+extern int		serverThreads;
+// Imported from Replay.
+extern const char *	replayRecordPath;
+
+// FUNCTIONS
+
+static int		BenchmarkMatches( void );
+static int		BenchmarkReplay( void );
+static int		BenchmarkSectors( void );
+static int		GetArenaSegmentByAngle( const struct ArenaGeometry *arena, struct Point2D point );
+static int		BenchmarkBalls( void );
+static int		CreateRandomBalls( struct BallSet *balls, int numBalls );
+static void		SweepAndTurnBalls( struct BallSet *balls, const struct ArenaGeometry *arena, int isScalar );
+static int		BenchmarkChaos( void );
+static int		BenchmarkSnapshots( void );
+static void		SimulateReplayTick( struct GameState *state, uint32_t tick );
+static double	Seconds( uint64_t start );
+
+// The map of names and functions for --benchmark.
+static struct BenchmarkNameFunctionCouple benchmarkNameFunctionMap[] = {
+	{ .name = "matches", .function = &BenchmarkMatches, .description = "Server ticks per second of many matches on 1, 2, 4, ... threads" },
+	{ .name = "replay", .function = &BenchmarkReplay, .description = "Records an hour of a game, then plays it back and seeks in it" },
+	{ .name = "sectors", .function = &BenchmarkSectors, .description = "Checks which segment points are on against angles and times both" },
+	{ .name = "balls", .function = &BenchmarkBalls, .description = "Checks and times the multi-ball kernels with more and more balls" },
+	{ .name = "chaos", .function = &BenchmarkChaos, .description = "Step times of multi-ball games with balls bouncing off each other" },
+	{ .name = "snapshots", .function = &BenchmarkSnapshots, .description = "Checks the quantization error of every snapshot field over its whole range" }
+};
+
+/*
+====================
+BenchmarkMatches
+
+Runs the same amount of matches on more and more worker threads, up to one per
+processor or --threads, and prints how many matches each configuration could
+host at the tick rate.
+====================
+*/
+static int BenchmarkMatches( void ) {
+	int		numMatches = serverMatches > 1 ? serverMatches : BENCHMARK_MATCHES;
+	int		maxWorkers = serverThreads > 0 ? serverThreads : SDL_GetCPUCount();
+	int		numWorkers;
+	double	ticksPerSecond;
+	double	baseline = 0.0;
+
+	printf( "%d matches of %d players at %d Hz, %d processors\n", numMatches, gameDedicatedPlayers, gameTickRate, SDL_GetCPUCount() );
+	printf( "%8s %14s %10s %9s\n", "threads", "ticks/s", "matches", "speedup" );
+	for( numWorkers = 1; ; numWorkers = numWorkers * 2 < maxWorkers ? numWorkers * 2 : maxWorkers ) {
+		if( BenchmarkMatchServer( numMatches, numWorkers, gameDedicatedPlayers, BENCHMARK_DURATION, &ticksPerSecond ) ) {
+			return -1;
+		}
+		if( baseline == 0.0 ) {
+			baseline = ticksPerSecond;
+		}
+		printf( "%8d %14.0f %10.0f %8.2fx\n", numWorkers, ticksPerSecond, ticksPerSecond / gameTickRate, ticksPerSecond / baseline );
+		fflush( stdout );
+		if( numWorkers >= maxWorkers ) {
+			break;
+		}
+	}
+	return 0;
+}
+
+/*
+====================
+Seconds
+
+Returns the seconds since the performance counter read start.
+====================
+*/
+static double Seconds( uint64_t start ) {
+	return ( SDL_GetPerformanceCounter() - start ) / ( double )SDL_GetPerformanceFrequency();
+}
+
+/*
+====================
+SimulateReplayTick
+
+Moves the ball and the paddles of a made-up game along, with a hit every couple of seconds
+and a point every now and then. Cheap enough not to show up next to the recording.
+====================
+*/
+static void SimulateReplayTick( struct GameState *state, uint32_t tick ) {
+	float	seconds = tick / ( float )gameTickRate;
+	int		player;
+
+	state->ball.position = AddVectorToPoint2D( state->ball.position, ScaleVector2D( state->ball.direction, 1.0f / gameTickRate ) );
+	if( fabsf( state->ball.position.x ) > 0.7f ) {
+		state->ball.direction.dx = -state->ball.direction.dx;
+		RegisterHit( state, tick % state->numPlayers );
+	}
+	if( fabsf( state->ball.position.y ) > 0.7f ) {
+		state->ball.direction.dy = -state->ball.direction.dy;
+	}
+	for( player = 0; player < state->numPlayers; player++ ) {
+		state->players[player].position = PADDLE_MAX_POS * ( 0.5f + 0.5f * sinf( seconds * ( 1.0f + 0.3f * player ) ) );
+	}
+	if( tick % ( 10 * gameTickRate ) == 0 && state->lastHit >= 0 ) {
+		state->players[state->lastHit].score++;
+		RegisterScore( state, state->lastHit );
+	}
+}
+
+/*
+====================
+BenchmarkReplay
+
+Records BENCHMARK_REPLAY_SECONDS of a made-up game at the tick rate, plays the whole
+file back as fast as possible and seeks to random points of it. Checks that playback
+ends on the last tick and that every seek lands on the tick it asked for.
+====================
+*/
+static int BenchmarkReplay( void ) {
+	const char *		path = replayRecordPath ? replayRecordPath : BENCHMARK_REPLAY_FILE;
+	uint32_t			numTicks = BENCHMARK_REPLAY_SECONDS * gameTickRate;
+	struct GameState	state = { .numPlayers = gameDedicatedPlayers, .lastHit = -1 };
+	struct ReplayWriter	writer;
+	struct ReplayReader	reader;
+	uint32_t			tick;
+	uint32_t			target;
+	uint64_t			start;
+	double				seconds;
+	long				size;
+	int					result;
+	int					i;
+	FILE *				file;
+
+	state.players = calloc( state.numPlayers, sizeof( struct Player ) );
+	if( !state.players || OpenReplayWriter( &writer, path, &state, gameTickRate ) ) {
+		free( state.players );
+		return -1;
+	}
+	state.ball.direction.dx = 0.6f * DEFAULT_BALL_SPEED;
+	state.ball.direction.dy = 0.8f * DEFAULT_BALL_SPEED;
+	printf( "%d seconds of %d players at %d Hz, %u ticks\n", BENCHMARK_REPLAY_SECONDS, state.numPlayers, gameTickRate, numTicks );
+
+	SelectReplayWriter( &writer );
+	start = SDL_GetPerformanceCounter();
+	for( tick = 0; tick < numTicks; tick++ ) {
+		SimulateReplayTick( &state, tick );
+		RecordTick( &state );
+	}
+	CloseReplayWriter( &writer );
+	seconds = Seconds( start );
+	file = fopen( path, "rb" );
+	size = -1;
+	if( file && !fseek( file, 0, SEEK_END ) ) {
+		size = ftell( file );
+	}
+	if( file ) {
+		fclose( file );
+	}
+	printf( "record   %12.0f ticks/s %10.1f MB %8.1f bytes/tick\n", numTicks / seconds, size / 1048576.0, size / ( double )numTicks );
+
+	if( OpenReplayReader( &reader, path, &state ) ) {
+		free( state.players );
+		return -1;
+	}
+	start = SDL_GetPerformanceCounter();
+	tick = 0;
+	while( !( result = ReadReplayTick( &reader, &state, 1 ) ) ) {
+		tick++;
+	}
+	seconds = Seconds( start );
+	printf( "play     %12.0f ticks/s %9.0fx real time\n", tick / seconds, tick / seconds / gameTickRate );
+	if( result != -2 || tick != numTicks || reader.tick != numTicks - 1 ) {
+		printf( "Playback stopped after %u of %u ticks.\n", tick, numTicks );
+		result = -1;
+	} else {
+		result = 0;
+	}
+
+	start = SDL_GetPerformanceCounter();
+	for( i = 0; i < BENCHMARK_REPLAY_SEEKS && !result; i++ ) {
+		target = ( uint32_t )( ( ( uint64_t )rand() * RAND_MAX + rand() ) % numTicks );
+		// Seeking to the start of the tick must land on exactly that tick.
+		if( SeekReplay( &reader, &state, ( uint32_t )( ( ( uint64_t )target * 1000 + gameTickRate - 1 ) / gameTickRate ) ) || reader.tick != target ) {
+			printf( "Seeking to tick %u landed on tick %u.\n", target, reader.tick );
+			result = -1;
+		}
+	}
+	seconds = Seconds( start );
+	if( !result ) {
+		printf( "seek     %12.0f seeks/s %8.1f us/seek\n", BENCHMARK_REPLAY_SEEKS / seconds, seconds * 1e6 / BENCHMARK_REPLAY_SEEKS );
+	}
+
+	CloseReplayReader( &reader );
+	free( state.players );
+	remove( path );
+	return result;
+}
+
+/*
+====================
+GetArenaSegmentByAngle
+
+The way GetPointSegment used to find the segment of a point: measures the angle from the
+start of player 0's segment clockwise to the point and divides it by the sector angle.
+====================
+*/
+static int GetArenaSegmentByAngle( const struct ArenaGeometry *arena, struct Point2D point ) {
+	float							dx = point.x - arena->center.x;
+	float							dy = point.y - arena->center.y;
+	float							angle;
+	int								segment;
+
+	if( dx == 0.0f && dy == 0.0f ) {
+		return 0;
+	}
+	angle = arena->segments[0].angle - atan2f( dy, dx );
+	if( angle < 0.0f ) {
+		angle += 2.0f * ( float )M_PI;
+	}
+	segment = ( int )floorf( angle / arena->sectorAngle );
+	return segment < arena->numPlayers ? segment : arena->numPlayers - 1;
+}
+
+/*
+====================
+BenchmarkSectors
+
+For every amount of players from 3 on, compares GetArenaSegment with GetArenaSegmentByAngle
+on every point of a BENCHMARK_SECTOR_GRID square grid over the screen, then times both on
+random points. Points so close to a boundary that rounding decides don't count as a mismatch.
+====================
+*/
+static int BenchmarkSectors( void ) {
+	struct Point2D	points[BENCHMARK_SECTOR_POINTS];
+	struct Point2D	point;
+	uint64_t		start;
+	double			halfPlaneSeconds;
+	double			angleSeconds;
+	long			numLookups;
+	long			checksum = 0;
+	int				numMismatches = 0;
+	int				numPlayers;
+	int				expected;
+	int				x;
+	int				y;
+	int				i;
+
+	for( i = 0; i < BENCHMARK_SECTOR_POINTS; i++ ) {
+		points[i].x = 2.0f * rand() / RAND_MAX - 1.0f;
+		points[i].y = 2.0f * rand() / RAND_MAX - 1.0f;
+	}
+	numLookups = 1000L * BENCHMARK_SECTOR_POINTS;
+
+	printf( "%8s %10s %14s %14s %9s\n", "players", "mismatches", "half-planes", "angles", "speedup" );
+	for( numPlayers = 3; numPlayers <= MAX_PLAYERS; numPlayers++ ) {
+		const struct ArenaGeometry *arena = GetArenaGeometry( numPlayers );
+		int mismatches = 0;
+
+		for( y = 0; y < BENCHMARK_SECTOR_GRID; y++ ) {
+			for( x = 0; x < BENCHMARK_SECTOR_GRID; x++ ) {
+				point.x = 2.0f * x / ( BENCHMARK_SECTOR_GRID - 1 ) - 1.0f;
+				point.y = 2.0f * y / ( BENCHMARK_SECTOR_GRID - 1 ) - 1.0f;
+				expected = GetArenaSegmentByAngle( arena, point );
+				if( GetArenaSegment( arena, point ) == expected ) {
+					continue;
+				}
+				// On a boundary both answers are right, one of them just rounded the other way.
+				float angle = remainderf( arena->segments[0].angle - atan2f( point.y, point.x ), arena->sectorAngle );
+				if( fabsf( angle ) > 1e-4f ) {
+					if( !mismatches ) {
+						printf( "%d players: (%f, %f) is on segment %d, not %d.\n", numPlayers, point.x, point.y, expected, GetArenaSegment( arena, point ) );
+					}
+					mismatches++;
+				}
+			}
+		}
+		numMismatches += mismatches;
+
+		start = SDL_GetPerformanceCounter();
+		for( i = 0; i < numLookups; i++ ) {
+			checksum += GetArenaSegment( arena, points[i % BENCHMARK_SECTOR_POINTS] );
+		}
+		halfPlaneSeconds = Seconds( start );
+		start = SDL_GetPerformanceCounter();
+		for( i = 0; i < numLookups; i++ ) {
+			checksum -= GetArenaSegmentByAngle( arena, points[i % BENCHMARK_SECTOR_POINTS] );
+		}
+		angleSeconds = Seconds( start );
+		printf( "%8d %10d %11.1f ns %11.1f ns %8.2fx\n", numPlayers, mismatches, halfPlaneSeconds * 1e9 / numLookups, angleSeconds * 1e9 / numLookups, angleSeconds / halfPlaneSeconds );
+		fflush( stdout );
+	}
+	// Both functions agree on the random points, so this is only there to keep the loops from being optimized away.
+	DebugPrintF( "Checksum %ld.", checksum );
+	return numMismatches ? -1 : 0;
+}
+
+/*
+====================
+CreateRandomBalls
+
+Makes numBalls balls at random places around the center, flying in random directions.
+====================
+*/
+static int CreateRandomBalls( struct BallSet *balls, int numBalls ) {
+	struct Ball	ball;
+	float		angle;
+	int			i;
+
+	if( CreateBallSet( balls, numBalls ) ) {
+		return -1;
+	}
+	for( i = 0; i < numBalls; i++ ) {
+		ball.position.x = 0.8f * rand() / RAND_MAX - 0.4f;
+		ball.position.y = 0.8f * rand() / RAND_MAX - 0.4f;
+		angle = 2.0f * ( float )M_PI * rand() / RAND_MAX;
+		ball.direction.dx = DEFAULT_BALL_SPEED * cosf( angle );
+		ball.direction.dy = DEFAULT_BALL_SPEED * sinf( angle );
+		AddBall( balls, ball );
+	}
+	return 0;
+}
+
+/*
+====================
+SweepAndTurnBalls
+
+Sweeps the balls for one tick with the kernel SweepBalls picks, or the scalar one, and sends
+the balls that touch something back where they came from. Never needs a random number, so
+the same balls always end up in the same places.
+====================
+*/
+static void SweepAndTurnBalls( struct BallSet *balls, const struct ArenaGeometry *arena, int isScalar ) {
+	int numTouching;
+	int i;
+
+	if( isScalar ) {
+		numTouching = SweepBallsScalar( balls, arena, 1.0f / gameTickRate );
+	} else {
+		numTouching = SweepBalls( balls, arena, 1.0f / gameTickRate );
+	}
+	for( i = 0; i < numTouching; i++ ) {
+		balls->dx[balls->touching[i]] = -balls->dx[balls->touching[i]];
+		balls->dy[balls->touching[i]] = -balls->dy[balls->touching[i]];
+	}
+}
+
+/*
+====================
+BenchmarkBalls
+
+For more and more balls in an arena for the dedicated server's amount of players, sweeps
+two copies of the same balls with SweepBalls and SweepBallsScalar and fails unless both end
+up in exactly the same places. Then times both kernels and MultiBallLogic, which also bounces
+the balls off the paddles.
+====================
+*/
+static int BenchmarkBalls( void ) {
+	const struct ArenaGeometry *	arena = GetArenaGeometry( gameDedicatedPlayers );
+	struct GameState				state = { .numPlayers = gameDedicatedPlayers, .lastHit = -1 };
+	struct BallSet					balls;
+	struct BallSet					scalarBalls;
+	uint64_t						start;
+	double							kernelSeconds;
+	double							scalarSeconds;
+	double							logicSeconds;
+	int								numBalls;
+	int								numTicks;
+	int								result = 0;
+	int								tick;
+	int								i;
+
+	state.players = calloc( state.numPlayers, sizeof( struct Player ) );
+	if( !arena || !state.players ) {
+		free( state.players );
+		return -1;
+	}
+	for( i = 0; i < state.numPlayers; i++ ) {
+		state.players[i].position = ( PADDLE_MAX_POS - PADDLE_MIN_POS ) / 2.0f;
+	}
+
+	printf( "%d players, %s kernel, ball ticks per second\n", state.numPlayers, GetBallKernelName() );
+	printf( "%8s %14s %14s %9s %14s\n", "balls", "kernel", "scalar", "speedup", "with bounces" );
+	for( numBalls = BENCHMARK_BALLS_MIN; numBalls <= BENCHMARK_BALLS_MAX && !result; numBalls *= 4 ) {
+		numTicks = BENCHMARK_BALL_TICKS / numBalls;
+
+		// Both kernels must agree on every tick, so the scalar one can stand in for the others.
+		srand( numBalls );
+		if( CreateRandomBalls( &balls, numBalls ) ) {
+			result = -1;
+			break;
+		}
+		srand( numBalls );
+		if( CreateRandomBalls( &scalarBalls, numBalls ) ) {
+			DestroyBallSet( &balls );
+			result = -1;
+			break;
+		}
+		for( tick = 0; tick < gameTickRate && !result; tick++ ) {
+			SweepAndTurnBalls( &balls, arena, 0 );
+			SweepAndTurnBalls( &scalarBalls, arena, 1 );
+			for( i = 0; i < numBalls; i++ ) {
+				if( balls.x[i] != scalarBalls.x[i] || balls.y[i] != scalarBalls.y[i] || balls.dx[i] != scalarBalls.dx[i] ) {
+					printf( "Tick %d: ball %d is at (%f, %f), not (%f, %f).\n", tick, i, balls.x[i], balls.y[i], scalarBalls.x[i], scalarBalls.y[i] );
+					result = -1;
+					break;
+				}
+			}
+		}
+
+		start = SDL_GetPerformanceCounter();
+		for( tick = 0; tick < numTicks; tick++ ) {
+			SweepAndTurnBalls( &balls, arena, 0 );
+		}
+		kernelSeconds = Seconds( start );
+		start = SDL_GetPerformanceCounter();
+		for( tick = 0; tick < numTicks; tick++ ) {
+			SweepAndTurnBalls( &scalarBalls, arena, 1 );
+		}
+		scalarSeconds = Seconds( start );
+		start = SDL_GetPerformanceCounter();
+		for( tick = 0; tick < numTicks; tick++ ) {
+			MultiBallLogic( &state, &balls, 1.0f / gameTickRate );
+		}
+		logicSeconds = Seconds( start );
+
+		printf( "%8d %14.0f %14.0f %8.2fx %14.0f\n", numBalls, ( double )numBalls * numTicks / kernelSeconds, ( double )numBalls * numTicks / scalarSeconds, scalarSeconds / kernelSeconds, ( double )numBalls * numTicks / logicSeconds );
+		fflush( stdout );
+		DestroyBallSet( &balls );
+		DestroyBallSet( &scalarBalls );
+	}
+	free( state.players );
+	return result;
+}
+
+/*
+====================
+BenchmarkChaos
+
+Runs BENCHMARK_CHAOS_SECONDS of a multi-ball game for more and more balls, which bounce off
+the paddles, the walls and each other, and prints how long a tick takes on average and at
+worst, next to the time a tick may take at the tick rate.
+====================
+*/
+static int BenchmarkChaos( void ) {
+	struct GameState	state = { .numPlayers = gameDedicatedPlayers, .lastHit = -1 };
+	struct BallSet		balls;
+	uint64_t			start;
+	double				seconds;
+	double				totalSeconds;
+	double				worstSeconds;
+	long				numCollisions;
+	int					numBalls;
+	int					numTicks = BENCHMARK_CHAOS_SECONDS * gameTickRate;
+	int					tick;
+	int					i;
+
+	state.players = calloc( state.numPlayers, sizeof( struct Player ) );
+	if( !state.players ) {
+		return -1;
+	}
+	for( i = 0; i < state.numPlayers; i++ ) {
+		state.players[i].position = ( PADDLE_MAX_POS - PADDLE_MIN_POS ) / 2.0f;
+	}
+
+	printf( "%d players at %d Hz, %.0f us per tick\n", state.numPlayers, gameTickRate, 1e6 / gameTickRate );
+	printf( "%8s %12s %12s %8s %14s\n", "balls", "average", "worst", "budget", "collisions" );
+	for( numBalls = BENCHMARK_BALLS_MIN; numBalls <= BENCHMARK_CHAOS_MAX; numBalls *= 2 ) {
+		srand( numBalls );
+		if( CreateRandomBalls( &balls, numBalls ) ) {
+			free( state.players );
+			return -1;
+		}
+		totalSeconds = 0.0;
+		worstSeconds = 0.0;
+		numCollisions = 0;
+		for( tick = 0; tick < numTicks; tick++ ) {
+			start = SDL_GetPerformanceCounter();
+			numCollisions += MultiBallLogic( &state, &balls, 1.0f / gameTickRate );
+			seconds = Seconds( start );
+			totalSeconds += seconds;
+			worstSeconds = seconds > worstSeconds ? seconds : worstSeconds;
+		}
+		printf( "%8d %9.1f us %9.1f us %7.1f%% %11.1f/tick\n", numBalls, totalSeconds * 1e6 / numTicks, worstSeconds * 1e6, totalSeconds * gameTickRate / numTicks * 100.0, numCollisions / ( double )numTicks );
+		fflush( stdout );
+		DestroyBallSet( &balls );
+	}
+	free( state.players );
+	return 0;
+}
+
+/*
+====================
+BenchmarkSnapshots
+
+Runs CheckSnapshotQuantization over BENCHMARK_SNAPSHOT_STEPS values of every field and prints
+the largest error of the ball's fields and of the paddles next to SNAPSHOT_MAX_ERROR, and how
+long a snapshot takes to capture, encode and decode. Fails if any value was off too far.
+====================
+*/
+static int BenchmarkSnapshots( void ) {
+	float		maxErrors[SNAPSHOT_NUM_FIELDS];
+	float		paddleError = 0.0f;
+	uint64_t	start = SDL_GetPerformanceCounter();
+	double		seconds;
+	int			numFailures;
+	int			field;
+
+	numFailures = CheckSnapshotQuantization( BENCHMARK_SNAPSHOT_STEPS, maxErrors );
+	seconds = Seconds( start );
+	for( field = 4; field < SNAPSHOT_NUM_FIELDS; field++ ) {
+		paddleError = maxErrors[field] > paddleError ? maxErrors[field] : paddleError;
+	}
+
+	printf( "%10s %10s %10s %10s %10s %10s\n", "x", "y", "dx", "dy", "paddles", "allowed" );
+	printf( "%10.3g %10.3g %10.3g %10.3g %10.3g %10.3g\n", maxErrors[0], maxErrors[1], maxErrors[2], maxErrors[3], paddleError, SNAPSHOT_MAX_ERROR );
+	printf( "%d values out of bounds, %.2f us per snapshot of %d players\n", numFailures, seconds * 1e6 / ( BENCHMARK_SNAPSHOT_STEPS + 2 ), MAX_PLAYERS );
+	return numFailures ? -1 : 0;
+}
+
+/*
+====================
+RunBenchmark
+
+Runs the benchmark given with --benchmark, or lists all of them if there is none by that name.
+====================
+*/
+enum ProgramState RunBenchmark( void ) {
+	int numBenchmarks = sizeof( benchmarkNameFunctionMap ) / sizeof( struct BenchmarkNameFunctionCouple );
+	int i;
+
+	for( i = 0; i < numBenchmarks; i++ ) {
+		if( !strcmp( benchmarkNameFunctionMap[i].name, benchmarkName ) ) {
+			if( benchmarkNameFunctionMap[i].function() ) {
+				DebugPrintF( "Benchmark %s failed.", benchmarkName );
+			}
+			return PS_QUIT;
+		}
+	}
+
+	printf( "There is no benchmark called %s. Available benchmarks:\n", benchmarkName );
+	for( i = 0; i < numBenchmarks; i++ ) {
+		printf( "  %-14s %s\n", benchmarkNameFunctionMap[i].name, benchmarkNameFunctionMap[i].description );
+	}
+	return PS_QUIT;
+}
+
+/*
+====================
+IsBenchmark
+
+Determines whether the program runs a benchmark instead of the game.
+====================
+*/
+int IsBenchmark( void ) {
+	return benchmarkName != NULL;
+}
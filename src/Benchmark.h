@@ -0,0 +1,21 @@
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+#define BENCHMARK_DURATION 2000		// Milliseconds every measurement runs
+#define BENCHMARK_MATCHES 256		// Matches the matches benchmark runs unless --matches says otherwise
+#define BENCHMARK_REPLAY_FILE "benchmark.replay"	// Where the replay benchmark records unless --record says otherwise
+#define BENCHMARK_REPLAY_SECONDS 3600	// Length of the game the replay benchmark records
+#define BENCHMARK_REPLAY_SEEKS 10000	// Random seeks the replay benchmark times
+#define BENCHMARK_SECTOR_GRID 1024		// Points per row and column of the grid the sectors benchmark checks
+#define BENCHMARK_SECTOR_POINTS 4096	// Random points the sectors benchmark times lookups of
+#define BENCHMARK_BALLS_MIN 16			// The balls benchmark starts with this many balls and quadruples them
+#define BENCHMARK_BALLS_MAX 16384		// up to this many
+#define BENCHMARK_BALL_TICKS 8388608	// Ball ticks every measurement of the balls benchmark runs
+#define BENCHMARK_CHAOS_MAX 4096		// The chaos benchmark doubles the balls from BENCHMARK_BALLS_MIN up to this many
+#define BENCHMARK_CHAOS_SECONDS 5		// Length of the game the chaos benchmark runs for every amount of balls
+#define BENCHMARK_SNAPSHOT_STEPS 1048576	// Values the snapshots benchmark sweeps every field through, 16 per step of the finest grid
+
+enum ProgramState	RunBenchmark( void );
+int					IsBenchmark( void );
+
+#endif
@@ -0,0 +1,160 @@
+#include <math.h>
+#include "BitStream.h"
+#include "Debug/Debug.h"
+
+/*
+====================
+InitBitWriter
+
+Prepares a writer that writes into the buffer with a capacity of maxlen bytes.
+====================
+*/
+void InitBitWriter( struct BitWriter *writer, char *buffer, int maxlen ) {
+	writer->buffer = ( unsigned char * )buffer;
+	writer->maxlen = maxlen;
+	writer->length = 0;
+	writer->scratch = 0;
+	writer->scratchBits = 0;
+	writer->overflow = 0;
+}
+
+/*
+====================
+WriteBits
+
+Appends the lowest numBits bits of value (1 to 32 bits) to the stream.
+====================
+*/
+void WriteBits( struct BitWriter *writer, uint32_t value, int numBits ) {
+	DebugAssert( numBits > 0 && numBits <= 32 );
+
+	if( numBits < 32 ) {
+		value &= ( 1u << numBits ) - 1u;
+	}
+	writer->scratch = ( writer->scratch << numBits ) | value;
+	writer->scratchBits += numBits;
+
+	// Move every complete byte to the buffer.
+	while( writer->scratchBits >= 8 ) {
+		writer->scratchBits -= 8;
+		if( writer->length < writer->maxlen ) {
+			writer->buffer[writer->length++] = ( unsigned char )( writer->scratch >> writer->scratchBits );
+		} else {
+			writer->overflow = 1;
+		}
+	}
+}
+
+/*
+====================
+WriteQuantized
+
+Quantizes a value from [min, max] to numBits bits and appends it to the stream.
+====================
+*/
+void WriteQuantized( struct BitWriter *writer, float value, float min, float max, int numBits ) {
+	WriteBits( writer, QuantizeFloat( value, min, max, numBits ), numBits );
+}
+
+/*
+====================
+FlushBitWriter
+
+Pads the last byte with zero bits. Returns the length of the stream in bytes or -1
+if it didn't fit into the buffer.
+====================
+*/
+int FlushBitWriter( struct BitWriter *writer ) {
+	if( writer->scratchBits > 0 ) {
+		WriteBits( writer, 0, 8 - writer->scratchBits );
+	}
+	return writer->overflow ? -1 : writer->length;
+}
+
+/*
+====================
+InitBitReader
+
+Prepares a reader for a buffer of length bytes.
+====================
+*/
+void InitBitReader( struct BitReader *reader, const char *buffer, int length ) {
+	reader->buffer = ( const unsigned char * )buffer;
+	reader->length = length;
+	reader->position = 0;
+	reader->scratch = 0;
+	reader->scratchBits = 0;
+	reader->overflow = 0;
+}
+
+/*
+====================
+ReadBits
+
+Reads the next numBits bits (1 to 32 bits) from the stream.
+====================
+*/
+uint32_t ReadBits( struct BitReader *reader, int numBits ) {
+	DebugAssert( numBits > 0 && numBits <= 32 );
+
+	// Load whole bytes until we have enough bits.
+	while( reader->scratchBits < numBits ) {
+		reader->scratch <<= 8;
+		if( reader->position < reader->length ) {
+			reader->scratch |= reader->buffer[reader->position++];
+		} else {
+			reader->overflow = 1;
+		}
+		reader->scratchBits += 8;
+	}
+
+	reader->scratchBits -= numBits;
+	if( numBits == 32 ) {
+		return ( uint32_t )( reader->scratch >> reader->scratchBits );
+	}
+	return ( uint32_t )( reader->scratch >> reader->scratchBits ) & ( ( 1u << numBits ) - 1u );
+}
+
+/*
+====================
+ReadQuantized
+
+Reads a value written by WriteQuantized with the same range and precision.
+====================
+*/
+float ReadQuantized( struct BitReader *reader, float min, float max, int numBits ) {
+	return DequantizeFloat( ReadBits( reader, numBits ), min, max, numBits );
+}
+
+/*
+====================
+QuantizeFloat
+
+Maps a value from [min, max] to the nearest of 2^numBits evenly spaced steps.
+Values outside of the range are clamped.
+====================
+*/
+uint32_t QuantizeFloat( float value, float min, float max, int numBits ) {
+	uint32_t steps = numBits < 32 ? ( 1u << numBits ) - 1u : 0xFFFFFFFFu;
+
+	if( !( value > min ) ) {
+		return 0;
+	}
+	if( value >= max ) {
+		return steps;
+	}
+	return ( uint32_t )floor( ( double )( value - min ) / ( max - min ) * steps + 0.5 );
+}
+
+/*
+====================
+DequantizeFloat
+
+Maps a step from QuantizeFloat back to a value from [min, max].
+====================
+*/
+float DequantizeFloat( uint32_t quantized, float min, float max, int numBits ) {
+	uint32_t steps = numBits < 32 ? ( 1u << numBits ) - 1u : 0xFFFFFFFFu;
+
+	return ( float )( min + ( double )quantized * ( max - min ) / steps );
+}
@@ -0,0 +1,62 @@
+#ifndef _BIT_STREAM_H
+#define _BIT_STREAM_H
+
+#include <stdint.h>
+
+/*
+==========================================================
+
+The largest error that quantizing a value in [min, max] to
+the given amount of bits can introduce, without the tiny
+float rounding error on top.
+
+==========================================================
+*/
+#define QUANTIZATION_MAX_ERROR( min, max, bits ) ( ( ( max ) - ( min ) ) / ( 2.0f * ( float )( ( 1u << ( bits ) ) - 1u ) ) )
+
+/*
+==========================================================
+
+Writes values to a byte buffer with bit granularity, most
+significant bit first. Writing past the end of the buffer
+sets overflow and discards the bits.
+
+==========================================================
+*/
+struct BitWriter {
+	unsigned char *	buffer;
+	int				maxlen;
+	int				length;			// Complete bytes written so far
+	uint64_t		scratch;		// Bits that don't fill a byte yet
+	int				scratchBits;
+	int				overflow;
+};
+
+/*
+==========================================================
+
+Reads values written by a BitWriter. Reading past the end of
+the buffer sets overflow and returns zero bits.
+
+==========================================================
+*/
+struct BitReader {
+	const unsigned char *	buffer;
+	int						length;
+	int						position;	// Next byte to load into scratch
+	uint64_t				scratch;
+	int						scratchBits;
+	int						overflow;
+};
+
+void		InitBitWriter( struct BitWriter *writer, char *buffer, int maxlen );
+void		WriteBits( struct BitWriter *writer, uint32_t value, int numBits );
+void		WriteQuantized( struct BitWriter *writer, float value, float min, float max, int numBits );
+int			FlushBitWriter( struct BitWriter *writer );
+void		InitBitReader( struct BitReader *reader, const char *buffer, int length );
+uint32_t	ReadBits( struct BitReader *reader, int numBits );
+float		ReadQuantized( struct BitReader *reader, float min, float max, int numBits );
+uint32_t	QuantizeFloat( float value, float min, float max, int numBits );
+float		DequantizeFloat( uint32_t quantized, float min, float max, int numBits );
+
+#endif
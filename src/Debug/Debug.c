@@ -24,9 +24,12 @@ int DebugPrintF( const char *format , ... ){
 	char	timeString[40];
 	
 	time( &t );
-	strcpy( timeString, ctime( &t ) );
 #ifdef __linux__
+	// Worker threads of a dedicated server print at the same time, ctime's buffer is shared.
+	ctime_r( &t, timeString );
 	*strchr( timeString, '\n' ) = ' ';
+#else
+	strcpy( timeString, ctime( &t ) );
 #endif
 	fprintf( fp, "%s", timeString );
 	formatString = malloc( strlen( format ) + 3 );
@@ -4,6 +4,7 @@
 #include "Debug/Debug.h"
 #include "Display.h"
 #include "Physics.h"
+#include "Arena.h"
 #include "Game.h"
 #include "Main.h"
 
@@ -35,6 +36,7 @@ static void				GetScreenSquare( struct Line2D *rectangle );
 static struct Point2D	GameToScreenCoordinates( struct Point2D point );
 static void				GenerateStringTexture( const char *string, SDL_Texture **texture );
 static void				DrawScores( struct GameState *state );
+static float			RenderedPaddlePosition( const struct Player *player );
 
 // Functions
 SDL_Window *GetSdlWindow( void );
@@ -137,14 +139,14 @@ int DisplayGameState( struct GameState *state ) {
 	 *		the x and y axes.
 	 * 2. (Optional) Draw the background.
 	 * 3. For each player, the paddle should be drawn like this:
-	 *		a) Get the player line using the GetPlayerLine function from Physics.
-	 *			This line contains one point on the coordinate system and a vector
-	 *			to the end of the line.
+	 *		a) Get the player's segment from the ArenaGeometry of the game.
+	 *			It contains the start point on the coordinate system and a vector
+	 *			to the end of the segment.
 	 *		b) The inner edge of the paddle should be exactly on this line, and the
 	 *			corners of the paddle should go from
-	 *				AddVectorToPoint2D( GetPlayerLine(...).point, ScaleVector2D( GetPlayerLine(...).vector, state->player[i].position ) )
+	 *				AddVectorToPoint2D( segment->start, ScaleVector2D( segment->vector, state->player[i].position ) )
 	 *			to
-	 *				AddVectorToPoint2D( GetPlayerLine(...).point, ScaleVector2D( GetPlayerLine(...).vector, state->player[i].position + PADDLE_SIZE ) )
+	 *				AddVectorToPoint2D( segment->start, ScaleVector2D( segment->vector, state->player[i].position + PADDLE_SIZE ) )
 	 *			. Refactor this code as much as you like, but this gives you two corner
 	 *			points of the paddle.
 	 *		c) Now draw a colored line from the first point to the second point.
@@ -262,14 +264,34 @@ Given a game state
 ====================
 */
 static void	CalculatePaddleCoordinates( struct GameState *state, int playerId, struct Point2D *start, struct Point2D *end ) {
+	const struct ArenaSegment *	segment = &GetArenaGeometry( state->numPlayers )->segments[playerId];
+	float						position = RenderedPaddlePosition( &state->players[playerId] );
 	if( start ) {
-		*start = GameToScreenCoordinates( AddVectorToPoint2D( GetPlayerLine( playerId, state->numPlayers ).point, ScaleVector2D( GetPlayerLine( playerId, state->numPlayers ).vector, state->players[playerId].position ) ) );
+		*start = GameToScreenCoordinates( AddVectorToPoint2D( segment->start, ScaleVector2D( segment->vector, position ) ) );
 	}
 	if( end ) {
-		*end = GameToScreenCoordinates( AddVectorToPoint2D( GetPlayerLine( playerId, state->numPlayers ).point, ScaleVector2D( GetPlayerLine( playerId, state->numPlayers ).vector, state->players[playerId].position + PADDLE_SIZE ) ) );
+		*end = GameToScreenCoordinates( AddVectorToPoint2D( segment->start, ScaleVector2D( segment->vector, position + PADDLE_SIZE ) ) );
 	}
 }
 
+/*
+====================
+RenderedPaddlePosition
+
+Returns where a paddle should be drawn, which includes the correction that smoothes out prediction errors.
+====================
+*/
+static float RenderedPaddlePosition( const struct Player *player ) {
+	float position = player->position + player->correction;
+	if( position > PADDLE_MAX_POS ) {
+		return PADDLE_MAX_POS;
+	}
+	if( position < PADDLE_MIN_POS ) {
+		return PADDLE_MIN_POS;
+	}
+	return position;
+}
+
 /*
 ====================
 CalculateBallCoordinates
@@ -314,10 +336,10 @@ To be called in between RenderClear and RenderPresent! :)
 ====================
 */
 static void DrawScores( struct GameState *state ) {
+	const struct ArenaGeometry *	arena = GetArenaGeometry( state->numPlayers );
+	const struct ArenaSegment *		segment;
 	int						n;
 	struct Point2D			rectCenter;
-	struct Line2D			playerLine;
-	struct Vector2D			orthoLeftVector;
 	struct ScoreTexture *	currentTex;
 	struct ScoreTexture *	lastTex;
 	int						currentScore;
@@ -332,15 +354,10 @@ static void DrawScores( struct GameState *state ) {
 
 	// Iterate over the players
 	for( n = 0; n < state->numPlayers; n++ ) {
-		// Get this player's line.
-		playerLine = GetPlayerLine( n, state->numPlayers );
-		orthoLeftVector.dx = -playerLine.vector.dy;
-		orthoLeftVector.dy = playerLine.vector.dx;
-		orthoLeftVector = ScaleVector2D( orthoLeftVector, 1.0f / sqrt(orthoLeftVector.dx*orthoLeftVector.dx + orthoLeftVector.dy*orthoLeftVector.dy ) );
-
-		// Find out the center of the text rectangle for this user.
-		rectCenter = AddVectorToPoint2D( playerLine.point, ScaleVector2D( playerLine.vector, state->players[n].position + PADDLE_SIZE / 2.0f ) );
-		rectCenter = AddVectorToPoint2D( rectCenter, ScaleVector2D( orthoLeftVector, 0.07f ) );
+		// Find out the center of the text rectangle for this user, just outside the arena.
+		segment = &arena->segments[n];
+		rectCenter = AddVectorToPoint2D( segment->start, ScaleVector2D( segment->vector, RenderedPaddlePosition( &state->players[n] ) + PADDLE_SIZE / 2.0f ) );
+		rectCenter = AddVectorToPoint2D( rectCenter, ScaleVector2D( segment->normal, -0.07f ) );
 
 		// Find the texture for the score
 		for( currentTex = scoreTexStart, currentScore = 0; currentTex != NULL && currentScore < state->players[n].score; currentTex = currentTex->next, currentScore++ );
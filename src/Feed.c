@@ -0,0 +1,229 @@
+#include "Feed.h"
+#include "Debug/Debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void	CopyFromRing( const struct SpectatorFeed *feed, uint64_t position, char *bytes, int length );
+
+/*
+====================
+CreateSpectatorFeed
+
+Allocates an empty feed.
+====================
+*/
+struct SpectatorFeed *CreateSpectatorFeed( void ) {
+	struct SpectatorFeed *feed = calloc( 1, sizeof( struct SpectatorFeed ) );
+
+	DebugAssert( feed );
+	if( !feed ) {
+		return NULL;
+	}
+	feed->lock = SDL_CreateMutex();
+	if( !feed->lock ) {
+		free( feed );
+		return NULL;
+	}
+	return feed;
+}
+
+/*
+====================
+DestroySpectatorFeed
+
+Frees a feed. Nobody may read or write it anymore.
+====================
+*/
+void DestroySpectatorFeed( struct SpectatorFeed *feed ) {
+	if( !feed ) {
+		return;
+	}
+	SDL_DestroyMutex( feed->lock );
+	free( feed );
+}
+
+/*
+====================
+SetFeedPreamble
+
+Starts a new game on the feed. Viewers that are already watching get the bytes as
+part of the stream, viewers that connect later get them first. An empty preamble
+makes late viewers wait for the next one.
+====================
+*/
+void SetFeedPreamble( struct SpectatorFeed *feed, const char *bytes, int length ) {
+	DebugAssert( length <= FEED_PREAMBLE_SIZE );
+	if( length > FEED_PREAMBLE_SIZE ) {
+		return;
+	}
+
+	PublishFeed( feed, bytes, length, 0 );
+	SDL_LockMutex( feed->lock );
+	if( length > 0 ) {
+		memcpy( feed->preamble, bytes, length );
+	}
+	feed->preambleLength = length;
+	feed->keyframe = feed->end;
+	SDL_UnlockMutex( feed->lock );
+}
+
+/*
+====================
+PublishFeed
+
+Appends complete packets to the stream. If isKeyframe is true, viewers that connect
+from now on start with them. Only the match thread writes a feed, so the bytes are
+copied without the lock: it is only taken to announce which bytes are about to be
+overwritten, and to publish them once they are complete.
+====================
+*/
+void PublishFeed( struct SpectatorFeed *feed, const char *bytes, int length, int isKeyframe ) {
+	uint64_t	start;
+	int			offset;
+	int			chunk;
+
+	DebugAssert( length <= FEED_BUFFER_SIZE );
+	SDL_LockMutex( feed->lock );
+	start = feed->end;
+	feed->reserved = start + length;
+	SDL_UnlockMutex( feed->lock );
+
+	for( offset = 0; offset < length; offset += chunk ) {
+		chunk = FEED_BUFFER_SIZE - ( int )( ( start + offset ) % FEED_BUFFER_SIZE );
+		if( chunk > length - offset ) {
+			chunk = length - offset;
+		}
+		memcpy( &feed->buffer[( start + offset ) % FEED_BUFFER_SIZE], &bytes[offset], chunk );
+	}
+
+	SDL_LockMutex( feed->lock );
+	if( isKeyframe ) {
+		feed->keyframe = start;
+	}
+	feed->end = start + length;
+	SDL_UnlockMutex( feed->lock );
+}
+
+/*
+====================
+CopyFromRing
+
+Copies bytes of the stream that are still in the ring buffer.
+====================
+*/
+static void CopyFromRing( const struct SpectatorFeed *feed, uint64_t position, char *bytes, int length ) {
+	int offset;
+	int chunk;
+
+	for( offset = 0; offset < length; offset += chunk ) {
+		chunk = FEED_BUFFER_SIZE - ( int )( ( position + offset ) % FEED_BUFFER_SIZE );
+		if( chunk > length - offset ) {
+			chunk = length - offset;
+		}
+		memcpy( &bytes[offset], &feed->buffer[( position + offset ) % FEED_BUFFER_SIZE], chunk );
+	}
+}
+
+/*
+====================
+PeekFeed
+
+Copies up to maxlen bytes that the viewer hasn't read yet into bytes, without
+moving the cursor. A new cursor, whose preambleLength is -1, starts with the
+preamble and the latest keyframe. Returns the amount of bytes copied, or -1 if
+the viewer fell so far behind that the bytes it needs are gone.
+
+Like a seqlock, the bytes are copied without the lock: if the match thread started
+to overwrite any of them meanwhile, the copy is thrown away.
+====================
+*/
+int PeekFeed( struct SpectatorFeed *feed, struct FeedCursor *cursor, char *bytes, int maxlen ) {
+	uint64_t	end;
+	uint64_t	reserved;
+	int			length = 0;
+	int			chunk;
+
+	SDL_LockMutex( feed->lock );
+	if( cursor->preambleLength < 0 ) {
+		memcpy( cursor->preamble, feed->preamble, feed->preambleLength );
+		cursor->preambleLength = feed->preambleLength;
+		cursor->preambleOffset = 0;
+		cursor->position = feed->keyframe;
+	}
+	end = feed->end;
+	SDL_UnlockMutex( feed->lock );
+	if( end - cursor->position > FEED_BUFFER_SIZE ) {
+		return -1;
+	}
+
+	// The rest of the preamble comes first.
+	chunk = cursor->preambleLength - cursor->preambleOffset;
+	if( chunk > maxlen ) {
+		chunk = maxlen;
+	}
+	memcpy( bytes, &cursor->preamble[cursor->preambleOffset], chunk );
+	length += chunk;
+
+	chunk = ( int )( end - cursor->position );
+	if( chunk > maxlen - length ) {
+		chunk = maxlen - length;
+	}
+	if( chunk > 0 ) {
+		CopyFromRing( feed, cursor->position, &bytes[length], chunk );
+		length += chunk;
+
+		SDL_LockMutex( feed->lock );
+		reserved = feed->reserved;
+		SDL_UnlockMutex( feed->lock );
+		if( reserved - cursor->position > FEED_BUFFER_SIZE ) {
+			return -1;
+		}
+	}
+
+	return length;
+}
+
+/*
+====================
+AdvanceFeedCursor
+
+Marks length bytes that PeekFeed returned as read.
+====================
+*/
+void AdvanceFeedCursor( struct FeedCursor *cursor, int length ) {
+	int chunk = cursor->preambleLength - cursor->preambleOffset;
+
+	if( chunk > length ) {
+		chunk = length;
+	}
+	cursor->preambleOffset += chunk;
+	cursor->position += length - chunk;
+}
+
+/*
+====================
+GetFeedEnd
+
+Returns the position after the newest byte of a feed.
+====================
+*/
+uint64_t GetFeedEnd( struct SpectatorFeed *feed ) {
+	uint64_t end;
+
+	SDL_LockMutex( feed->lock );
+	end = feed->end;
+	SDL_UnlockMutex( feed->lock );
+	return end;
+}
+
+/*
+====================
+IsFeedCursorAtEnd
+
+Determines whether a viewer has read everything up to end, see GetFeedEnd. This
+needs no lock, so a relay can skip viewers that are up to date cheaply.
+====================
+*/
+int IsFeedCursorAtEnd( const struct FeedCursor *cursor, uint64_t end ) {
+	return cursor->preambleLength >= 0 && cursor->preambleOffset == cursor->preambleLength && cursor->position == end;
+}
@@ -0,0 +1,62 @@
+#ifndef _FEED_H
+#define _FEED_H
+
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+#define FEED_BUFFER_SIZE 262144		// Bytes of the stream a feed keeps for viewers that are behind
+#define FEED_PREAMBLE_SIZE 1024
+
+/*
+==========================================================
+
+The stream of one match for its spectators: joins, the
+start of the game, snapshots and events, as they would go
+over a control socket. The match thread writes it once per
+snapshot, no matter how many viewers there are, and relay
+threads read it for every viewer at their own pace. The lock
+only guards the positions, never a copy of the bytes, so the
+match thread hardly ever waits for a reader.
+
+A viewer that connects late first gets the preamble, which
+describes the current game, and then the stream from the
+latest keyframe on. A keyframe needs nothing from before
+it. Viewers that fall further behind than the buffer holds
+can't catch up and have to be dropped.
+
+==========================================================
+*/
+struct SpectatorFeed {
+	SDL_mutex *	lock;							// Guards the positions and the preamble
+	char		buffer[FEED_BUFFER_SIZE];		// Ring buffer, the byte at position p is at p % FEED_BUFFER_SIZE
+	uint64_t	end;							// Position after the newest byte
+	uint64_t	reserved;						// Position after the bytes that are being written, end while nobody writes
+	uint64_t	keyframe;						// Position where late viewers start
+	char		preamble[FEED_PREAMBLE_SIZE];
+	int			preambleLength;
+};
+
+/*
+==========================================================
+
+How far one viewer has read a feed.
+
+==========================================================
+*/
+struct FeedCursor {
+	int			preambleOffset;		// Bytes of the preamble that have been read
+	int			preambleLength;		// Length of the preamble this viewer gets, -1 until it started reading
+	char		preamble[FEED_PREAMBLE_SIZE];
+	uint64_t	position;			// Position of the next byte in the stream
+};
+
+struct SpectatorFeed *	CreateSpectatorFeed( void );
+void					DestroySpectatorFeed( struct SpectatorFeed *feed );
+void					SetFeedPreamble( struct SpectatorFeed *feed, const char *bytes, int length );
+void					PublishFeed( struct SpectatorFeed *feed, const char *bytes, int length, int isKeyframe );
+int						PeekFeed( struct SpectatorFeed *feed, struct FeedCursor *cursor, char *bytes, int maxlen );
+void					AdvanceFeedCursor( struct FeedCursor *cursor, int length );
+uint64_t				GetFeedEnd( struct SpectatorFeed *feed );
+int						IsFeedCursorAtEnd( const struct FeedCursor *cursor, uint64_t end );
+
+#endif
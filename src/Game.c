@@ -3,34 +3,211 @@
 #include "Main.h"
 #include "Network.h"
 #include "Physics.h"
+#include "Replay.h"
+#include "Random.h"
 #include "Debug/Debug.h"
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL.h>
+#include <stdint.h>
+
+#define MAX_TICKS_PER_FRAME 8		// How many ticks the server may catch up on after a stall
+#define SNAP_DISTANCE 0.25f			// A ball that got further than this in one tick was reset, so it isn't interpolated
 
 static struct GameState	currentState;
+static struct GameState	previousState;	// The geometry before the last tick, to interpolate from
+static struct GameState	renderState;	// What is drawn, between previousState and currentState
+int						gameTickRate = DEFAULT_TICK_RATE;			// Set with --tickrate
+int						gameFrameRate = DEFAULT_FRAME_RATE;			// Set with --framerate
+int						gameSnapshotRate = DEFAULT_SNAPSHOT_RATE;	// Set with --snaprate
+int						gameDedicated = 0;							// Set with --dedicated
+int						gameDedicatedPlayers = DEFAULT_DEDICATED_PLAYERS;	// Set with --players
+uint64_t				gameSeed = 0;								// Set with --seed, 0 takes one from the clock
+static int				numGames;		// Games RunGame started so far, keys their seeds
 
-static int InitializeGame( void );
+extern int	IsServer( void );
+extern int	ThisClient( void );
+// Imported from Network.
+extern int			clientGameStarted;
+// Imported from Relay.
+extern const char *	spectateAddress;
+extern uint16_t		spectatePort;
+extern int			spectateMatch;
+// Imported from Replay.
+extern const char *	replayRecordPath;
+extern const char *	replayPlayPath;
+extern float		replaySpeed;
+extern float		replaySeek;
 
 /*
 ====================
-InitializeGame
+InitializeGameState
 
-Resets the GameState.
+Resets a GameState for the players in the lobby of the current network context. Its seed
+is drawn from --seed with key, so the same --seed and key always give the same game. Every
+game of a run needs a key of its own that doesn't depend on timing, e.g. its port and number.
 ====================
 */
-static int InitializeGame( void ) {
+int InitializeGameState( struct GameState *state, uint64_t key ) {
 	int 	i;
-	char *	playerNames[6];
-
-	GetPlayerList( playerNames, &currentState.numPlayers );
-	currentState.players = malloc( sizeof( struct Player ) * currentState.numPlayers );
-	for( i = 0; i < currentState.numPlayers; i++ ) {
-		currentState.players[i].name = playerNames[i];
-		currentState.players[i].position = 0.0f;
-		currentState.players[i].score = 0;
+	char *	playerNames[MAX_PLAYERS];
+
+	GetPlayerList( playerNames, &state->numPlayers );
+	free( state->players );
+	state->players = malloc( sizeof( struct Player ) * state->numPlayers );
+	for( i = 0; i < state->numPlayers; i++ ) {
+		state->players[i].name = playerNames[i];
+		state->players[i].position = 0.0f;
+		state->players[i].speed = 0.0f;
+		state->players[i].correction = 0.0f;
+		state->players[i].score = 0;
+	}
+	state->seed = GetRandom( gameSeed ? gameSeed : SDL_GetPerformanceCounter(), key );
+	state->tick = 0;
+	state->numDraws = 0;
+	InitializeBall( state );
+	return 0;
+}
+
+/*
+====================
+CopyGameState
+
+Makes target a copy of source with players of its own, so that source can go on changing.
+The names aren't copied, both states point to the same ones.
+====================
+*/
+static void CopyGameState( struct GameState *target, const struct GameState *source ) {
+	if( target->numPlayers != source->numPlayers || !target->players ) {
+		free( target->players );
+		target->players = malloc( sizeof( struct Player ) * source->numPlayers );
+	}
+	target->numPlayers = source->numPlayers;
+	target->ball = source->ball;
+	target->lastHit = source->lastHit;
+	target->seed = source->seed;
+	target->tick = source->tick;
+	target->numDraws = source->numDraws;
+	memcpy( target->players, source->players, sizeof( struct Player ) * source->numPlayers );
+}
+
+/*
+====================
+InterpolateGameState
+
+Writes the state that is alpha of the way from previous to current into result, alpha
+being in [0, 1]. Only what this program simulates itself is interpolated: everything on
+the server, but only our own paddle on a client, which gets the rest of the geometry
+already interpolated from its snapshots. Paddles are interpolated including their
+corrections, so a reconciliation doesn't make them jump.
+====================
+*/
+static void InterpolateGameState( const struct GameState *previous, const struct GameState *current, float alpha, struct GameState *result ) {
+	struct Vector2D	movement;
+	float			from;
+	float			to;
+	int				player;
+
+	CopyGameState( result, current );
+	if( previous->numPlayers != current->numPlayers || !previous->players ) {
+		return;
+	}
+
+	if( IsServer() ) {
+		movement.dx = current->ball.position.x - previous->ball.position.x;
+		movement.dy = current->ball.position.y - previous->ball.position.y;
+		if( VectorNorm2D( movement ) < SNAP_DISTANCE ) {
+			result->ball.position = AddVectorToPoint2D( previous->ball.position, ScaleVector2D( movement, alpha ) );
+		}
+	}
+	for( player = 0; player < current->numPlayers; player++ ) {
+		if( !IsServer() && player != ThisClient() ) {
+			continue;
+		}
+		from = previous->players[player].position + previous->players[player].correction;
+		to = current->players[player].position + current->players[player].correction;
+		result->players[player].position = from + ( to - from ) * alpha;
+		result->players[player].correction = 0.0f;
+	}
+}
+
+/*
+====================
+LimitBacklog
+
+Drops all of the accumulated time but MAX_TICKS_PER_FRAME ticks, so that a program that
+stalled doesn't take ever longer to catch up.
+====================
+*/
+static void LimitBacklog( double *accumulator, double tickSeconds ) {
+	if( *accumulator > MAX_TICKS_PER_FRAME * tickSeconds ) {
+		DebugPrintF( "%s is %.0f ms behind, skipping ahead.", IsServer() ? "Server" : "Client", ( *accumulator - MAX_TICKS_PER_FRAME * tickSeconds ) * 1000.0 );
+		*accumulator = MAX_TICKS_PER_FRAME * tickSeconds;
+	}
+}
+
+/*
+====================
+RunServerTicks
+
+Runs as many fixed-length server ticks as fit into the accumulated time. If the server
+fell behind by more than MAX_TICKS_PER_FRAME ticks, the rest of the backlog is dropped.
+Before every tick, the state is copied into previous unless that is NULL.
+Returns -2 when the game should be stopped.
+====================
+*/
+int RunServerTicks( struct GameState *state, struct GameState *previous, double *accumulator ) {
+	double	tickSeconds = 1.0 / gameTickRate;
+
+	LimitBacklog( accumulator, tickSeconds );
+	while( *accumulator >= tickSeconds ) {
+		*accumulator -= tickSeconds;
+		if( previous ) {
+			CopyGameState( previous, state );
+		}
+
+		// A dedicated server has nothing left to do when everybody is gone.
+		if( gameDedicated && !CountConnectedClients() ) {
+			DebugPrintF( "All clients have left, the match is over." );
+			return -2;
+		}
+
+		// When ProcessPhysics returns -2, this means that the program should be stopped because the user pressed escape.
+		if( ProcessPhysics( state, ( float )tickSeconds ) == -2 ) {
+			return -2;
+		}
+		RecordTick( state );
+		// On -2 the clients got quit packets or something similar.
+		if( ProcessInGame( state ) == -2 ) {
+			return -2;
+		}
+	}
+
+	return 0;
+}
+
+/*
+====================
+RunClientTicks
+
+Moves our own paddle in as many fixed-length ticks as fit into the accumulated time,
+just like the server does with everything. Before every tick, the state is copied into
+previous. Returns -2 when the user quits.
+====================
+*/
+static int RunClientTicks( struct GameState *state, struct GameState *previous, double *accumulator ) {
+	double tickSeconds = 1.0 / gameTickRate;
+
+	LimitBacklog( accumulator, tickSeconds );
+	while( *accumulator >= tickSeconds ) {
+		*accumulator -= tickSeconds;
+		CopyGameState( previous, state );
+		// When ProcessPhysics returns -2, this means that the program should be stopped because the user pressed escape.
+		if( ProcessPhysics( state, ( float )tickSeconds ) == -2 ) {
+			return -2;
+		}
 	}
-	InitializeBall( &currentState );
 	return 0;
 }
 
@@ -38,38 +215,169 @@ static int InitializeGame( void ) {
 ====================
 RunGame
 
-Currently, displays the GameState for 10 seconds.
+Runs the game until a player quits. Servers and clients simulate in fixed ticks of
+1 / gameTickRate seconds, no matter how fast they draw, and draw at most gameFrameRate
+frames per second, each interpolated between the last two ticks. A server records
+the game if --record is set.
 ====================
 */
 enum ProgramState RunGame( void ) {
-	int result = 0;
+	struct ReplayWriter	writer = { 0 };
+	int					result = 0;
+	double				frequency = ( double )SDL_GetPerformanceFrequency();
+	double				tickSeconds = 1.0 / gameTickRate;
+	double				frameSeconds = 1.0 / gameFrameRate;
+	double				accumulator = 0.0;
+	double				frameTime = frameSeconds;	// Seconds since the last frame was drawn
+	double				elapsed;
+	double				wait;
 
 	DebugPrintF( "RunGame called." );
-	InitializeGame();
+	InitializeGameState( &currentState, ( uint64_t )numGames++ );
+	CopyGameState( &previousState, &currentState );
+	SetNetworkRates( gameTickRate, gameSnapshotRate );
 	NetworkStartGame( NETWORK_STANDARD_DATA_PORT );
 
+	// Only the server knows every tick, clients would record their predictions.
+	if( IsServer() && replayRecordPath && !OpenReplayWriter( &writer, replayRecordPath, &currentState, gameTickRate ) ) {
+		SelectReplayWriter( &writer );
+	}
+
 	// For timekeeping...
-	unsigned int lastFrame = SDL_GetTicks();
+	uint64_t lastFrame = SDL_GetPerformanceCounter();
+	uint64_t now;
 
 	while( 1 ) {
-		// When ProcessPhysics returns -2, this means that the program should be stopped because the user pressed escape.
-		result = ProcessPhysics( &currentState, ( float )( SDL_GetTicks() - lastFrame ) / 1000.0f );
-		if( result == -2 ) {
-			return PS_QUIT;
+		now = SDL_GetPerformanceCounter();
+		elapsed = ( now - lastFrame ) / frequency;
+		lastFrame = now;
+		accumulator += elapsed;
+		frameTime += elapsed;
+
+		if( IsServer() ) {
+			result = RunServerTicks( &currentState, gameDedicated ? NULL : &previousState, &accumulator );
+			if( result == -2 ) {
+				break;
+			}
+		} else {
+			result = RunClientTicks( &currentState, &previousState, &accumulator );
+			if( result == -2 ) {
+				break;
+			}
+
+			// So here on -2 either the client or the server got quit packets or something similar.
+			result = ProcessInGame( &currentState );
+			if( result == -2 ) {
+				break;
+			}
 		}
 
-		lastFrame = SDL_GetTicks();
+		if( !gameDedicated && frameTime >= frameSeconds ) {
+			frameTime = frameTime - frameSeconds < frameSeconds ? frameTime - frameSeconds : 0.0;
+			InterpolateGameState( &previousState, &currentState, ( float )( accumulator / tickSeconds ), &renderState );
+			DisplayGameState( &renderState );
+		}
 
-		// So here on -2 either the client or the server got quit packets or something similar.
-		result = ProcessInGame( &currentState );
-		if( result == -2 ) {
+		// Sleep until the next tick or frame is due. The server handles incoming packets meanwhile.
+		wait = tickSeconds - accumulator;
+		if( !gameDedicated && frameSeconds - frameTime < wait ) {
+			wait = frameSeconds - frameTime;
+		}
+		wait = ( wait - ( SDL_GetPerformanceCounter() - lastFrame ) / frequency ) * 1000.0;
+		if( wait >= 1.0 ) {
+			if( IsServer() ) {
+				WaitForNetwork( &currentState, ( unsigned int )wait );
+			} else {
+				SDL_Delay( ( unsigned int )wait );
+			}
+		}
+	}
+
+	CloseReplayWriter( &writer );
+	return PS_QUIT;
+}
+
+/*
+====================
+RunSpectator
+
+Watches the match given with --spectate and --match. Waits until its next game
+starts, or joins the running one, and shows it like a client without a paddle.
+====================
+*/
+enum ProgramState RunSpectator( void ) {
+	if( ConnectSpectator( spectateAddress, spectatePort, spectateMatch ) ) {
+		DebugPrintF( "Could not watch match %d on %s:%d.", spectateMatch, spectateAddress, spectatePort );
+		return PS_QUIT;
+	}
+
+	while( !clientGameStarted ) {
+		SDL_PumpEvents();
+		if( SDL_HasEvent( SDL_QUIT ) ) {
+			return PS_QUIT;
+		}
+		if( ProcessLobby() == -1 ) {
+			DebugPrintF( "Lost the connection to match %d.", spectateMatch );
 			return PS_QUIT;
 		}
+		SDL_Delay( 10 );
+	}
+	return RunGame();
+}
+
+/*
+====================
+RunReplay
+
+Plays the replay given with --replay from --replay-seek seconds on, --replay-speed times
+as fast as it was recorded, until it ends or the user presses escape. Every tick that is
+due is played, so hits and points sound just like in the game.
+====================
+*/
+enum ProgramState RunReplay( void ) {
+	struct ReplayReader	reader;
+	const Uint8 *		keys = SDL_GetKeyboardState( NULL );
+	double				frequency = ( double )SDL_GetPerformanceFrequency();
+	double				begin = replaySeek * 1000.0;
+	double				replayTime;
+	uint64_t			start;
+	int					result;
 
+	if( OpenReplayReader( &reader, replayPlayPath, &currentState ) ) {
+		return PS_QUIT;
+	}
+	DebugPrintF( "Playing %s: %d players, %.1f seconds.", replayPlayPath, reader.numPlayers, ReplayDuration( &reader ) / 1000.0 );
+
+	result = SeekReplay( &reader, &currentState, ( uint32_t )begin );
+	start = SDL_GetPerformanceCounter();
+	while( !result ) {
 		DisplayGameState( &currentState );
-		// Ensures acceptable time measurements (We don't want ~positive infinity FPS, that would break physics)
+		SDL_PumpEvents();
+		if( keys[SDL_SCANCODE_ESCAPE] || SDL_HasEvent( SDL_QUIT ) ) {
+			break;
+		}
+
+		replayTime = begin + ( SDL_GetPerformanceCounter() - start ) / frequency * 1000.0 * replaySpeed;
+		while( !result && reader.tick * 1000.0 / reader.tickRate < replayTime ) {
+			result = ReadReplayTick( &reader, &currentState, 0 );
+		}
 		SDL_Delay( 10 );
 	}
 
-	return PS_MENU;
+	if( result == -1 ) {
+		DebugPrintF( "%s is broken after %.1f seconds.", replayPlayPath, reader.tick / ( double )reader.tickRate );
+	}
+	CloseReplayReader( &reader );
+	return PS_QUIT;
+}
+
+/*
+====================
+IsDedicated
+
+Determines whether the program runs as a dedicated server.
+====================
+*/
+int IsDedicated( void ) {
+	return gameDedicated;
 }
@@ -1,6 +1,15 @@
 #ifndef _GAME_H
 #define _GAME_H
 
+#include <stdint.h>
+
+#define MAX_PLAYERS 16			// Bounded by the snapshot field mask and the lobby, the arena fits any amount
+#define DEFAULT_TICK_RATE 120		// Physics steps per second on the server
+#define DEFAULT_SNAPSHOT_RATE 60	// Snapshots per second the server sends to every client
+#define MAX_TICK_RATE 1000
+#define DEFAULT_FRAME_RATE 100		// Frames per second clients and listen servers draw at most
+#define DEFAULT_DEDICATED_PLAYERS 2	// Players a dedicated server waits for before it starts a match
+
 /*
 ==========================================================
 
@@ -47,6 +56,8 @@ Information about a player in the game.
 struct Player {
 	char *	name;
 	float	position;
+	float	speed;			// Paddle speed, positive is clockwise
+	float	correction;		// Offset that smoothes out prediction errors on screen, decays to zero
 	int		score;
 };
 
@@ -61,8 +72,17 @@ struct GameState {
 	int 			numPlayers;
 	struct Player *	players;
 	struct Ball		ball;
+	int				lastHit;		// The player who hit the ball last, -1 if nobody has since it was reset
+	uint64_t		seed;			// Keys everything that is left to chance in the match, see Random.h
+	uint32_t		tick;			// Physics steps run so far
+	uint32_t		numDraws;		// Random numbers drawn in the current tick
 };
 
 enum ProgramState	RunGame( void );
+enum ProgramState	RunSpectator( void );
+enum ProgramState	RunReplay( void );
+int					InitializeGameState( struct GameState *state, uint64_t key );
+int					RunServerTicks( struct GameState *state, struct GameState *previous, double *accumulator );
+int					IsDedicated( void );
 
 #endif
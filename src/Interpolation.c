@@ -0,0 +1,183 @@
+#include <math.h>
+#include "Interpolation.h"
+#include "Physics.h"
+#include "Debug/Debug.h"
+
+#define JITTER_SMOOTHING 16.0f		// Inverse weight of a new sample in the jitter and interval averages
+#define DELAY_SMOOTHING 16.0f		// Inverse weight of the target delay in every delay update
+#define CLOCK_DRIFT 0.01f			// How fast the clock offset follows transit times that grow
+
+static const struct Snapshot *	SnapshotAt( const struct JitterBuffer *buffer, int index );
+static float					RelativeTime( const struct Snapshot *snapshot, const struct Snapshot *newest );
+static void						InterpolateSnapshots( const struct Snapshot *from, const struct Snapshot *to, float alpha, struct Snapshot *result );
+
+/*
+====================
+SnapshotAt
+
+Returns the snapshot at the given index, counted from the oldest one in the buffer.
+====================
+*/
+static const struct Snapshot *SnapshotAt( const struct JitterBuffer *buffer, int index ) {
+	DebugAssert( index >= 0 && index < buffer->count );
+
+	return &buffer->snapshots[( buffer->first + index ) % JITTER_BUFFER_LENGTH];
+}
+
+/*
+====================
+RelativeTime
+
+Returns the server time of a snapshot relative to the newest one, which is zero or negative.
+====================
+*/
+static float RelativeTime( const struct Snapshot *snapshot, const struct Snapshot *newest ) {
+	return ( float )( int32_t )( snapshot->time - newest->time );
+}
+
+/*
+====================
+ResetJitterBuffer
+
+Empties the buffer and forgets all measurements, e.g. when a new game starts.
+====================
+*/
+void ResetJitterBuffer( struct JitterBuffer *buffer ) {
+	buffer->first = 0;
+	buffer->count = 0;
+	buffer->lastReceiveTime = 0;
+	buffer->clockOffset = 0.0;
+	buffer->interval = 0.0f;
+	buffer->jitter = 0.0f;
+	buffer->delay = 0.0f;
+}
+
+/*
+====================
+PushSnapshot
+
+Adds a snapshot that arrived at the given local time and updates the jitter
+measurements and the interpolation delay. Snapshots that are not newer than
+the newest one in the buffer are ignored.
+====================
+*/
+void PushSnapshot( struct JitterBuffer *buffer, const struct Snapshot *snapshot, uint32_t receiveTime ) {
+	const struct Snapshot *	newest;
+	double					transit = ( double )( int32_t )( receiveTime - snapshot->time );
+	float					spacing;
+	float					variation;
+	float					target;
+
+	if( buffer->count == 0 ) {
+		buffer->clockOffset = transit;
+	} else {
+		newest = SnapshotAt( buffer, buffer->count - 1 );
+		spacing = RelativeTime( snapshot, newest );
+		if( spacing <= 0.0f ) {
+			return;
+		}
+
+		// How much later or earlier than the one before this snapshot arrived, see RFC 3550.
+		variation = ( float )( int32_t )( receiveTime - buffer->lastReceiveTime ) - spacing;
+		buffer->jitter += ( fabsf( variation ) - buffer->jitter ) / JITTER_SMOOTHING;
+		buffer->interval += ( spacing - buffer->interval ) / ( buffer->interval > 0.0f ? JITTER_SMOOTHING : 1.0f );
+
+		// Follow the fastest snapshots at once, and slower ones only slowly, e.g. when the route changes.
+		if( transit < buffer->clockOffset ) {
+			buffer->clockOffset = transit;
+		} else {
+			buffer->clockOffset += ( transit - buffer->clockOffset ) * CLOCK_DRIFT;
+		}
+
+		// We need the next snapshot to be there in time, even if it is late by a few times the jitter.
+		target = buffer->interval + JITTER_DELAY_FACTOR * buffer->jitter;
+		target = fmaxf( MIN_INTERPOLATION_DELAY, fminf( target, MAX_INTERPOLATION_DELAY ) );
+		if( buffer->count == 1 ) {
+			buffer->delay = target;
+		} else {
+			buffer->delay += ( target - buffer->delay ) / DELAY_SMOOTHING;
+		}
+	}
+
+	if( buffer->count == JITTER_BUFFER_LENGTH ) {
+		buffer->first = ( buffer->first + 1 ) % JITTER_BUFFER_LENGTH;
+		buffer->count--;
+	}
+	buffer->snapshots[( buffer->first + buffer->count ) % JITTER_BUFFER_LENGTH] = *snapshot;
+	buffer->count++;
+	buffer->lastReceiveTime = receiveTime;
+}
+
+/*
+====================
+SampleJitterBuffer
+
+Writes the geometry at the local time now minus the interpolation delay into result.
+If that is later than the newest snapshot, the newest one is used, and if it is
+earlier than the oldest one, the oldest one. Returns -1 if the buffer is empty.
+====================
+*/
+int SampleJitterBuffer( const struct JitterBuffer *buffer, uint32_t now, struct Snapshot *result ) {
+	const struct Snapshot *	newest;
+	float					renderTime;
+	int						index;
+
+	if( buffer->count == 0 ) {
+		return -1;
+	}
+
+	// The point in time we want to see, relative to the newest snapshot.
+	newest = SnapshotAt( buffer, buffer->count - 1 );
+	renderTime = ( float )( ( double )( int32_t )( now - newest->time ) - buffer->clockOffset - buffer->delay );
+	if( renderTime >= 0.0f ) {
+		*result = *newest;
+		return 0;
+	}
+
+	// Find the newest snapshot at or before that point in time.
+	for( index = buffer->count - 2; index >= 0; index-- ) {
+		if( RelativeTime( SnapshotAt( buffer, index ), newest ) <= renderTime ) {
+			break;
+		}
+	}
+	if( index < 0 ) {
+		*result = *SnapshotAt( buffer, 0 );
+		return 0;
+	}
+
+	const struct Snapshot *from = SnapshotAt( buffer, index );
+	const struct Snapshot *to = SnapshotAt( buffer, index + 1 );
+	InterpolateSnapshots( from, to, ( renderTime - RelativeTime( from, newest ) ) / ( RelativeTime( to, newest ) - RelativeTime( from, newest ) ), result );
+	return 0;
+}
+
+/*
+====================
+InterpolateSnapshots
+
+Blends two consecutive snapshots, alpha being 0 for from and 1 for to. If the ball moved
+further than it could have in between, it has been reset, so it isn't blended.
+====================
+*/
+static void InterpolateSnapshots( const struct Snapshot *from, const struct Snapshot *to, float alpha, struct Snapshot *result ) {
+	struct Vector2D	moved;
+	float			reach;
+	int				player;
+
+	*result = *to;
+	for( player = 0; player < to->numPlayers; player++ ) {
+		result->positions[player] = from->positions[player] + ( to->positions[player] - from->positions[player] ) * alpha;
+	}
+
+	moved.dx = to->ball.position.x - from->ball.position.x;
+	moved.dy = to->ball.position.y - from->ball.position.y;
+	reach = fmaxf( VectorNorm2D( from->ball.direction ), VectorNorm2D( to->ball.direction ) ) * ( to->time - from->time ) / 1000.0f + DEFAULT_BALL_RADIUS;
+	if( VectorNorm2D( moved ) > reach ) {
+		result->ball = from->ball;
+		return;
+	}
+	result->ball.position.x = from->ball.position.x + moved.dx * alpha;
+	result->ball.position.y = from->ball.position.y + moved.dy * alpha;
+	result->ball.direction.dx = from->ball.direction.dx + ( to->ball.direction.dx - from->ball.direction.dx ) * alpha;
+	result->ball.direction.dy = from->ball.direction.dy + ( to->ball.direction.dy - from->ball.direction.dy ) * alpha;
+}
@@ -0,0 +1,40 @@
+#ifndef _INTERPOLATION_H
+#define _INTERPOLATION_H
+
+#include <stdint.h>
+#include "Snapshot.h"
+
+#define JITTER_BUFFER_LENGTH 16
+#define MIN_INTERPOLATION_DELAY 0.0f		// In milliseconds
+#define MAX_INTERPOLATION_DELAY 250.0f		// In milliseconds
+#define JITTER_DELAY_FACTOR 3.0f			// Milliseconds of delay per millisecond of measured jitter
+
+/*
+==========================================================
+
+The snapshots most recently received from the server,
+ordered by their server time. The client renders the ball
+and the other paddles at "now minus delay", interpolated
+between the two snapshots around that point in time. The
+delay adapts to the measured jitter, so that usually a newer
+snapshot has already arrived when it is needed. All times
+are in milliseconds.
+
+==========================================================
+*/
+struct JitterBuffer {
+	struct Snapshot	snapshots[JITTER_BUFFER_LENGTH];	// Ring buffer, the oldest one at first
+	int				first;
+	int				count;
+	uint32_t		lastReceiveTime;	// SDL_GetTicks() when the newest snapshot arrived
+	double			clockOffset;		// Local time minus server time of the fastest snapshots
+	float			interval;			// Average server time between two snapshots
+	float			jitter;				// Interarrival jitter as in RFC 3550
+	float			delay;				// How far behind the newest snapshot we render
+};
+
+void	ResetJitterBuffer( struct JitterBuffer *buffer );
+void	PushSnapshot( struct JitterBuffer *buffer, const struct Snapshot *snapshot, uint32_t receiveTime );
+int		SampleJitterBuffer( const struct JitterBuffer *buffer, uint32_t now, struct Snapshot *result );
+
+#endif
@@ -0,0 +1,352 @@
+#include "Link.h"
+#include "Random.h"
+#include "Debug/Debug.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <SDL2/SDL.h>
+
+// VARIABLES
+
+struct LinkConditions	linkOutgoingConditions = { .seed = DEFAULT_LINK_SEED };	// Set with --netsim-out
+struct LinkConditions	linkIncomingConditions = { .seed = DEFAULT_LINK_SEED };	// Set with --netsim-in
+
+// FUNCTIONS
+
+static void		OpenLinkDirection( struct LinkDirection *direction, const struct LinkConditions *conditions, uint64_t seed );
+static void		CloseLinkDirection( struct LinkDirection *direction, const char *name );
+static float	LinkRandom( struct LinkDirection *direction );
+static void		HoldBack( struct LinkDirection *direction, const UDPpacket *packet, uint32_t now );
+static void		InsertPacket( struct LinkDirection *direction, const UDPpacket *packet, uint32_t due );
+static int		IsDue( const struct LinkDirection *direction, uint32_t now );
+static struct LinkPacket *	NextPacket( struct LinkDirection *direction );
+
+/*
+====================
+ParseLinkConditions
+
+Reads link conditions from a comma separated list of settings, e.g.
+"latency=80,jitter=20,loss=0.02,reorder=0.01,duplicate=0.01,bandwidth=16000,seed=7".
+Settings that are left out are zero, only the seed defaults to DEFAULT_LINK_SEED.
+Returns -1 and leaves conditions alone if the list is invalid.
+====================
+*/
+int ParseLinkConditions( const char *value, struct LinkConditions *conditions ) {
+	struct LinkConditions	parsed = { .seed = DEFAULT_LINK_SEED };
+	char					name[16];
+	double					number;
+	int						consumed;
+
+	while( *value ) {
+		if( sscanf( value, "%15[a-z]=%lf%n", name, &number, &consumed ) != 2 || number < 0.0 ) {
+			return -1;
+		}
+		if( !strcmp( name, "latency" ) ) {
+			parsed.latency = ( unsigned int )number;
+		} else if( !strcmp( name, "jitter" ) ) {
+			parsed.jitter = ( unsigned int )number;
+		} else if( !strcmp( name, "loss" ) && number <= 1.0 ) {
+			parsed.loss = ( float )number;
+		} else if( !strcmp( name, "reorder" ) && number <= 1.0 ) {
+			parsed.reorder = ( float )number;
+		} else if( !strcmp( name, "duplicate" ) && number <= 1.0 ) {
+			parsed.duplicate = ( float )number;
+		} else if( !strcmp( name, "bandwidth" ) ) {
+			parsed.bandwidth = ( unsigned int )number;
+		} else if( !strcmp( name, "seed" ) ) {
+			parsed.seed = ( uint32_t )number;
+		} else {
+			return -1;
+		}
+
+		value += consumed;
+		if( *value == ',' ) {
+			value++;
+		} else if( *value ) {
+			return -1;
+		}
+	}
+
+	*conditions = parsed;
+	return 0;
+}
+
+/*
+====================
+OpenLink
+
+Sets up both directions of a link with the conditions given on the command line.
+The salt makes links that are opened with the same seed, e.g. one per match, differ.
+====================
+*/
+void OpenLink( struct Link *link, uint32_t salt ) {
+	OpenLinkDirection( &link->outgoing, &linkOutgoingConditions, ( ( uint64_t )salt << 32 ) ^ linkOutgoingConditions.seed );
+	OpenLinkDirection( &link->incoming, &linkIncomingConditions, ( ( uint64_t )salt << 32 ) ^ linkIncomingConditions.seed ^ 0x5bd1e995u );
+}
+
+/*
+====================
+CloseLink
+
+Drops the datagrams that are still held back and reports what the link did.
+====================
+*/
+void CloseLink( struct Link *link ) {
+	CloseLinkDirection( &link->outgoing, "outgoing" );
+	CloseLinkDirection( &link->incoming, "incoming" );
+}
+
+/*
+====================
+OpenLinkDirection
+
+Resets one direction. It only gets a queue if its conditions aren't perfect.
+====================
+*/
+static void OpenLinkDirection( struct LinkDirection *direction, const struct LinkConditions *conditions, uint64_t seed ) {
+	int slot;
+
+	CloseLinkDirection( direction, NULL );
+	memset( direction, 0, sizeof( *direction ) );
+	direction->conditions = *conditions;
+	direction->seed = seed;
+	if( !conditions->latency && !conditions->jitter && conditions->loss == 0.0f && conditions->reorder == 0.0f
+		&& conditions->duplicate == 0.0f && !conditions->bandwidth ) {
+		return;
+	}
+
+	direction->slots = malloc( LINK_QUEUE_LENGTH * sizeof( struct LinkPacket ) );
+	DebugAssert( direction->slots );
+	for( slot = 0; slot < LINK_QUEUE_LENGTH; slot++ ) {
+		direction->free[slot] = ( uint8_t )slot;
+	}
+	direction->numFree = direction->slots ? LINK_QUEUE_LENGTH : 0;
+	direction->lastDue = SDL_GetTicks();
+	direction->busyUntil = SDL_GetTicks();
+}
+
+/*
+====================
+CloseLinkDirection
+
+Frees the queue of one direction. Prints its statistics unless name is NULL.
+====================
+*/
+static void CloseLinkDirection( struct LinkDirection *direction, const char *name ) {
+	if( !direction->slots ) {
+		return;
+	}
+	if( name ) {
+		DebugPrintF( "Emulated %s link: %u passed, %u lost, %u reordered, %u duplicated, %u overflowed, %d still queued.", name,
+			direction->stats.passed, direction->stats.lost, direction->stats.reordered, direction->stats.duplicated, direction->stats.overflowed, direction->length );
+	}
+	free( direction->slots );
+	direction->slots = NULL;
+	direction->length = 0;
+	direction->numFree = 0;
+}
+
+/*
+====================
+LinkRandom
+
+Returns the next number between 0 and 1 of the direction.
+====================
+*/
+static float LinkRandom( struct LinkDirection *direction ) {
+	return GetRandomFloat( direction->seed, direction->numDraws++ );
+}
+
+/*
+====================
+HoldBack
+
+Decides the fate of a datagram that enters one direction of the link: it is lost,
+or queued until it is due, maybe twice.
+====================
+*/
+static void HoldBack( struct LinkDirection *direction, const UDPpacket *packet, uint32_t now ) {
+	const struct LinkConditions *	conditions = &direction->conditions;
+	double							start;
+	uint32_t						due;
+
+	if( packet->len > LINK_PACKET_LENGTH || direction->numFree == 0 ) {
+		direction->stats.overflowed++;
+		return;
+	}
+	if( LinkRandom( direction ) < conditions->loss ) {
+		direction->stats.lost++;
+		return;
+	}
+
+	// The datagram can't leave before everything in front of it has.
+	due = now + conditions->latency;
+	if( conditions->bandwidth ) {
+		start = direction->busyUntil > now ? direction->busyUntil : now;
+		direction->busyUntil = start + packet->len * 1000.0 / conditions->bandwidth;
+		due += ( uint32_t )( direction->busyUntil - now );
+	}
+
+	if( LinkRandom( direction ) < conditions->reorder ) {
+		direction->stats.reordered++;
+	} else {
+		due += ( uint32_t )( LinkRandom( direction ) * conditions->jitter );
+		if( ( int32_t )( due - direction->lastDue ) < 0 ) {
+			due = direction->lastDue;
+		}
+		direction->lastDue = due;
+	}
+
+	InsertPacket( direction, packet, due );
+	if( LinkRandom( direction ) < conditions->duplicate && direction->numFree > 0 ) {
+		direction->stats.duplicated++;
+		InsertPacket( direction, packet, due );
+	}
+}
+
+/*
+====================
+InsertPacket
+
+Copies a datagram into a free slot and sorts it in behind all datagrams that aren't due later.
+====================
+*/
+static void InsertPacket( struct LinkDirection *direction, const UDPpacket *packet, uint32_t due ) {
+	uint8_t				slot = direction->free[--direction->numFree];
+	struct LinkPacket *	held = &direction->slots[slot];
+	int					index;
+
+	held->address = packet->address;
+	held->channel = packet->channel;
+	held->length = packet->len;
+	memcpy( held->data, packet->data, packet->len );
+
+	for( index = direction->length; index > 0 && ( int32_t )( direction->due[index - 1] - due ) > 0; index-- ) {
+		direction->due[index] = direction->due[index - 1];
+		direction->order[index] = direction->order[index - 1];
+	}
+	direction->due[index] = due;
+	direction->order[index] = slot;
+	direction->length++;
+}
+
+/*
+====================
+IsDue
+
+Determines whether the next datagram of a direction may pass now.
+====================
+*/
+static int IsDue( const struct LinkDirection *direction, uint32_t now ) {
+	return direction->length > 0 && ( int32_t )( now - direction->due[0] ) >= 0;
+}
+
+/*
+====================
+NextPacket
+
+Takes the next datagram out of the queue. Its slot stays valid until the next datagram is held back.
+====================
+*/
+static struct LinkPacket *NextPacket( struct LinkDirection *direction ) {
+	uint8_t slot = direction->order[0];
+
+	direction->length--;
+	memmove( &direction->due[0], &direction->due[1], direction->length * sizeof( direction->due[0] ) );
+	memmove( &direction->order[0], &direction->order[1], direction->length * sizeof( direction->order[0] ) );
+	direction->free[direction->numFree++] = slot;
+	direction->stats.passed++;
+	return &direction->slots[slot];
+}
+
+/*
+====================
+LinkSend
+
+Sends a datagram through the link, like SendDatagramPacket would. A held
+back datagram counts as sent. Also sends what has become due in the meantime.
+====================
+*/
+int LinkSend( struct Link *link, datagramSocket_t socket, UDPpacket *packet ) {
+	if( !link->outgoing.slots ) {
+		return SendDatagramPacket( socket, packet );
+	}
+
+	HoldBack( &link->outgoing, packet, SDL_GetTicks() );
+	FlushLink( link, socket );
+	return 1;
+}
+
+/*
+====================
+LinkReceive
+
+Receives the next datagram through the link, like ReceiveDatagramPacket. Everything that
+waits on the socket enters the link first, then the next datagram that is due, if
+any, is copied into packet.
+====================
+*/
+int LinkReceive( struct Link *link, datagramSocket_t socket, UDPpacket *packet ) {
+	struct LinkPacket *	held;
+	uint32_t			now = SDL_GetTicks();
+	int					result;
+
+	FlushLink( link, socket );
+	if( !link->incoming.slots ) {
+		return ReceiveDatagramPacket( socket, packet );
+	}
+
+	while( ( result = ReceiveDatagramPacket( socket, packet ) ) > 0 ) {
+		HoldBack( &link->incoming, packet, now );
+	}
+	if( result < 0 ) {
+		return result;
+	}
+	if( !IsDue( &link->incoming, now ) ) {
+		return 0;
+	}
+
+	held = NextPacket( &link->incoming );
+	DebugAssert( held->length <= packet->maxlen );
+	memcpy( packet->data, held->data, held->length );
+	packet->len = held->length;
+	packet->address = held->address;
+	packet->channel = held->channel;
+	return 1;
+}
+
+/*
+====================
+FlushLink
+
+Sends all outgoing datagrams that are due.
+====================
+*/
+void FlushLink( struct Link *link, datagramSocket_t socket ) {
+	struct LinkPacket *	held;
+	UDPpacket			packet;
+	uint32_t			now = SDL_GetTicks();
+
+	while( IsDue( &link->outgoing, now ) ) {
+		held = NextPacket( &link->outgoing );
+		memset( &packet, 0, sizeof( packet ) );
+		packet.channel = -1;
+		packet.data = held->data;
+		packet.len = held->length;
+		packet.maxlen = LINK_PACKET_LENGTH;
+		packet.address = held->address;
+		SendDatagramPacket( socket, &packet );
+	}
+}
+
+/*
+====================
+IsLinkPending
+
+Determines whether the link holds back any datagrams, so it has to be flushed and
+read even if the socket has nothing new.
+====================
+*/
+int IsLinkPending( const struct Link *link ) {
+	return link->outgoing.length > 0 || link->incoming.length > 0;
+}
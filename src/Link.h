@@ -0,0 +1,107 @@
+#ifndef _LINK_H
+#define _LINK_H
+
+#include <stdint.h>
+#include <SDL2/SDL_net.h>
+#include "Socket.h"
+
+#define LINK_QUEUE_LENGTH 256		// Datagrams one direction holds back at most, more are dropped like by a full router queue
+#define LINK_PACKET_LENGTH 512		// The longest datagram the link can hold back
+#define DEFAULT_LINK_SEED 1
+
+/*
+==========================================================
+
+How bad the emulated link between this program and its peers
+is in one direction. All zero is a perfect link, which costs
+nothing. See ParseLinkConditions for the text form.
+
+==========================================================
+*/
+struct LinkConditions {
+	unsigned int	latency;		// Milliseconds every datagram is delayed
+	unsigned int	jitter;			// Up to this many milliseconds are added to the latency at random
+	float			loss;			// Probability that a datagram is dropped
+	float			reorder;		// Probability that a datagram skips the queue and arrives after the latency alone
+	float			duplicate;		// Probability that a datagram arrives twice
+	unsigned int	bandwidth;		// Bytes per second, 0 for no limit
+	uint32_t		seed;			// Seeds the random decisions, so that a run can be repeated
+};
+
+/*
+==========================================================
+
+What the emulated link did to the datagrams in one direction.
+
+==========================================================
+*/
+struct LinkStats {
+	unsigned int	passed;			// Datagrams that were let through, maybe late
+	unsigned int	lost;
+	unsigned int	reordered;
+	unsigned int	duplicated;
+	unsigned int	overflowed;		// Dropped because the queue was full, e.g. above the bandwidth
+};
+
+/*
+==========================================================
+
+A datagram that is held back until it is due.
+
+==========================================================
+*/
+struct LinkPacket {
+	IPaddress	address;		// Where it goes to (outgoing) or comes from (incoming)
+	int			channel;
+	int			length;
+	uint8_t		data[LINK_PACKET_LENGTH];
+};
+
+/*
+==========================================================
+
+One direction of the emulated link. The datagrams wait in
+slots, and order lists the slots sorted by the time they are
+due, so that only small entries move around on insertion.
+
+==========================================================
+*/
+struct LinkDirection {
+	struct LinkConditions	conditions;
+	struct LinkPacket *		slots;			// LINK_QUEUE_LENGTH datagrams, NULL while the direction is perfect
+	uint32_t				due[LINK_QUEUE_LENGTH];		// SDL_GetTicks() when the datagram in order[i] is due
+	uint8_t					order[LINK_QUEUE_LENGTH];	// Indices into slots, the next datagram first
+	uint8_t					free[LINK_QUEUE_LENGTH];	// Stack of unused slots
+	int						length;			// Datagrams held back
+	int						numFree;
+	uint64_t				seed;			// Keys the random numbers of the direction, see Random.h
+	uint64_t				numDraws;		// Random numbers drawn so far
+	uint32_t				lastDue;		// Datagrams don't overtake each other unless they are reordered
+	double					busyUntil;		// When everything sent so far has passed the bandwidth limit, in milliseconds
+	struct LinkStats		stats;
+};
+
+/*
+==========================================================
+
+An emulated link below a UDP socket. Outgoing datagrams are
+held back before they are sent, incoming ones after they are
+received. This lets two programs on one machine play as if
+they were far apart.
+
+==========================================================
+*/
+struct Link {
+	struct LinkDirection	outgoing;
+	struct LinkDirection	incoming;
+};
+
+int		ParseLinkConditions( const char *value, struct LinkConditions *conditions );
+void	OpenLink( struct Link *link, uint32_t salt );
+void	CloseLink( struct Link *link );
+int		LinkSend( struct Link *link, datagramSocket_t socket, UDPpacket *packet );
+int		LinkReceive( struct Link *link, datagramSocket_t socket, UDPpacket *packet );
+void	FlushLink( struct Link *link, datagramSocket_t socket );
+int		IsLinkPending( const struct Link *link );
+
+#endif
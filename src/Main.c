@@ -2,6 +2,11 @@
 #include "Menu.h"
 #include "Main.h"
 #include "Game.h"
+#include "Server.h"
+#include "Benchmark.h"
+#include "Relay.h"
+#include "Replay.h"
+#include "Batch.h"
 #include "Debug/Debug.h"
 
 /*
@@ -21,6 +26,27 @@ int main( int argc, char *argv[] ) {
 		return result;
 	}
 
+	// A dedicated server skips the menu and hosts one match after the other.
+	if( IsDedicated() ) {
+		mode = PS_DEDICATED;
+	}
+	if( IsBenchmark() ) {
+		mode = PS_BENCHMARK;
+	}
+	// Spectators and relays watch a match instead of playing.
+	if( IsSpectator() ) {
+		mode = PS_SPECTATE;
+	}
+	if( IsRelay() ) {
+		mode = PS_RELAY;
+	}
+	if( IsReplay() ) {
+		mode = PS_REPLAY;
+	}
+	if( IsBatch() ) {
+		mode = PS_BATCH;
+	}
+
 	// Control loop
 	while( mode != PS_QUIT ) {
 		switch( mode ) {
@@ -31,6 +57,24 @@ int main( int argc, char *argv[] ) {
 				// Go to game loop...
 				mode = RunGame();
 				break;
+			case PS_DEDICATED:
+				mode = RunDedicatedServer();
+				break;
+			case PS_BENCHMARK:
+				mode = RunBenchmark();
+				break;
+			case PS_SPECTATE:
+				mode = RunSpectator();
+				break;
+			case PS_RELAY:
+				mode = RunRelay();
+				break;
+			case PS_REPLAY:
+				mode = RunReplay();
+				break;
+			case PS_BATCH:
+				mode = RunBatch();
+				break;
 			default:
 				// What is this? Someone broke our mode value. Print something and exit.
 				DebugPrintF( "There exists no handler for mode = %d! Quitting.", ( int )mode );
@@ -11,7 +11,13 @@ An enumeration that describes the state of the program in the switch statement o
 enum ProgramState {
 	PS_QUIT,
 	PS_MENU,
-	PS_GAME
+	PS_GAME,
+	PS_DEDICATED,
+	PS_BENCHMARK,
+	PS_SPECTATE,
+	PS_RELAY,
+	PS_REPLAY,
+	PS_BATCH
 };
 
 #define ASSET_FOLDER "Assets/"
@@ -63,6 +63,7 @@ static void			InitializeMenuElements( Button_t *tabOrder , SDL_Renderer *rendere
 static void			TextInput( const char *description, char *text );
 static int			EventCheckMainMenu( int *marked, enum MenuState *menuState );
 static int			EventCheckLobby( int *marked, enum MenuState *menuState );
+static int			CountLobbyPlayers( void );
 static int			EventCheck( int *marked , enum MenuState *menuState );
 static int			RenderMainMenu( Button_t *tabOrder, int *marked, SDL_Renderer *renderer, SDL_Window *sdlWindow, enum MenuState *menuState );
 static int			RenderLobby( Button_t *tabOrder , int *marked , SDL_Renderer *renderer , SDL_Window *sdlWindow , enum MenuState *menuState );
@@ -425,6 +426,21 @@ static int EventCheckMainMenu( int *marked, enum MenuState *menuState ) {
 	return PS_MENU;
 }
 
+/*
+====================
+CountLobbyPlayers
+
+Returns how many players are in the lobby right now.
+====================
+*/
+static int CountLobbyPlayers( void ) {
+	char *	playerNames[MAX_PLAYERS];
+	int		numPlayers = 0;
+
+	GetPlayerList( playerNames, &numPlayers );
+	return numPlayers;
+}
+
 /*
 ====================
 EventCheckLobby
@@ -450,6 +466,10 @@ static int EventCheckLobby( int *marked, enum MenuState *menuState ) {
 						if( !( *menuState == MS_HOST_GAME ) ) {
 							break;
 						}
+						// There is no arena for a single player.
+						if( CountLobbyPlayers() < 2 ) {
+							break;
+						}
 						return PS_GAME;
 					default:
 						break;
@@ -584,15 +604,18 @@ Renders all the buttons
 */
 static int RenderLobby( Button_t *tabOrder, int *marked, SDL_Renderer *renderer, SDL_Window *sdlWindow, enum MenuState *menuState ) {
 	int			w, h, i, n, wt, ht;
-	char *		playerNames[6];
+	char *		playerNames[MAX_PLAYERS];
 	SDL_Color	white = {255, 255, 255};
 	SDL_Rect	startRect;
 	SDL_Rect	frameRect;
 	SDL_Rect	backgroundRect;
 	SDL_Rect	Player_rect;
 
-	// Calls the network component to go through the lobby code.
-	ProcessLobby();
+	// Calls the network component to go through the lobby code. Without a connection there is no lobby to show.
+	if( ProcessLobby() == -1 ) {
+		*menuState = MS_MAIN_MENU;
+		return 0;
+	}
 
 	// Get the current window size and set the rectangles for the images accordingly.
 	SDL_GetWindowSize( sdlWindow, &w, &h );
@@ -630,8 +653,8 @@ static int RenderLobby( Button_t *tabOrder, int *marked, SDL_Renderer *renderer,
 		// Get text size for scaling and set the player rectangle accordingly.
         TTF_SizeText( sans , playerNames[i] , &wt , &ht );
 
-		// The constant 0.1125 was found out by experimentation.
-		Player_rect.h = frameRect.h * 0.1125f;
+		// The constant 0.1125 was found out by experimentation. More than six names get squeezed into the same space.
+		Player_rect.h = frameRect.h * fminf( 0.1125f, 0.675f / n );
 
 		// The width of the player name rectangle is the minimum of
 		//   a) What SDL_ttf says should be right for proper scaling
@@ -0,0 +1,308 @@
+#include <math.h>
+#include "Motion.h"
+
+/* The game and simulated matches move paddles and balls with these, so both follow the
+ * same rules. Nothing in here uses SDL or globals and randomness comes from the caller,
+ * so it runs on any thread. */
+
+#define DEGREES_TO_RADIANS( x ) ( ( x ) * M_PI / 180.0f )
+
+// VARIABLES
+
+static const struct PhysicsParameters defaultPhysics = DEFAULT_PHYSICS_PARAMETERS;
+
+// FUNCTIONS
+
+static struct Vector2D	AddVectors2D( struct Vector2D vector1, struct Vector2D vector2 );
+static struct Vector2D	DeltaVector2D( struct Point2D point1, struct Point2D point2 );
+static float			ScalarProduct2D( struct Vector2D vector1, struct Vector2D vector2 );
+static struct Vector2D	RotateVector2D( struct Vector2D vector, float angle );
+static struct Vector2D	VectorFromPolar2D( float angle, float norm );
+static struct Vector2D	GetReflectionVector( struct Vector2D wallNormal, struct Vector2D objectMovement, float degrees );
+static int				FindImpact( const struct PhysicsParameters *parameters, const struct Ball *ball, const struct ArenaGeometry *arena, float maxSeconds, float *impactSeconds );
+
+/*
+====================
+GetDefaultPhysicsParameters
+
+Returns the parameters the game plays with.
+====================
+*/
+const struct PhysicsParameters *GetDefaultPhysicsParameters( void ) {
+	return &defaultPhysics;
+}
+
+/*
+====================
+ScaleVector2D
+
+Given a vector and a scalar, scales the vector by the scalar.
+====================
+*/
+struct Vector2D ScaleVector2D( struct Vector2D vector, float scaling ) {
+	vector.dx *= scaling;
+	vector.dy *= scaling;
+	return vector;
+}
+
+/*
+====================
+AddVectorToPoint2D
+
+Given a 2D point and vector, adds the dx component of the vector to the point's
+x component, and the vector's dy component to the point's y component.
+====================
+*/
+struct Point2D AddVectorToPoint2D( struct Point2D point, struct Vector2D vector ) {
+	point.x += vector.dx;
+	point.y += vector.dy;
+	return point;
+}
+
+/*
+====================
+AddVectors2D
+
+Returns the result of vector addition of its two arguments.
+====================
+*/
+static struct Vector2D AddVectors2D( struct Vector2D vector1, struct Vector2D vector2 ) {
+	vector1.dx += vector2.dx;
+	vector1.dy += vector2.dy;
+	return vector1;
+}
+
+/*
+====================
+DeltaVector2D
+
+Given two points, returns the vector that leads to point2 when added to point1.
+====================
+*/
+static struct Vector2D DeltaVector2D( struct Point2D point1, struct Point2D point2 ) {
+	struct Vector2D result;
+	result.dx = point2.x - point1.x;
+	result.dy = point2.y - point1.y;
+	return result;
+}
+
+/*
+====================
+VectorNorm2D
+
+Calculates the euclidean norm of a 2-dimensional vector and returns it.
+====================
+*/
+float VectorNorm2D( struct Vector2D vector ) {
+	return sqrt( ScalarProduct2D( vector, vector ) );
+}
+
+/*
+====================
+ScalarProduct2D
+
+Returns the scalar product of vector1 and vector2.
+====================
+*/
+static float ScalarProduct2D( struct Vector2D vector1, struct Vector2D vector2 ) {
+	return vector1.dx * vector2.dx + vector1.dy * vector2.dy;
+}
+
+/*
+====================
+RotateVector2D
+
+Rotates a vector by the given angle.
+====================
+*/
+static struct Vector2D RotateVector2D( struct Vector2D vector, float angle ) {
+	struct Vector2D result;
+	result.dx = vector.dx * cos( angle ) - vector.dy * sin( angle );
+	result.dy = vector.dx * sin( angle ) + vector.dy * cos( angle );
+	return result;
+}
+
+/*
+====================
+VectorFromPolar2D
+
+Given the polar form of a vector, returns a vector in coordinate form.
+====================
+*/
+static struct Vector2D VectorFromPolar2D( float angle, float norm ) {
+	struct Vector2D result;
+	result.dx = norm * cos( angle );
+	result.dy = norm * sin( angle );
+	return result;
+}
+
+/*
+====================
+GetReflectionVector
+
+Gets a reflection vector for the object which bounces off a wall with the given unit normal,
+turned by the given degrees.
+====================
+*/
+static struct Vector2D GetReflectionVector( struct Vector2D wallNormal, struct Vector2D objectMovement, float degrees ) {
+	struct Vector2D reflection = AddVectors2D( objectMovement, ScaleVector2D( wallNormal, -2.0f * ScalarProduct2D( objectMovement, wallNormal ) ) );
+
+	if( degrees != 0.0f ) {
+		return RotateVector2D( reflection, ( float )DEGREES_TO_RADIANS( degrees ) );
+	}
+	return reflection;
+}
+
+/*
+====================
+MovePaddle
+
+Accelerates a paddle according to the input (1 for clockwise, -1 for counterclockwise,
+0 for none) and displaces it. Clients predict their own paddle with this and the server
+replays their input with it, so it must only depend on its arguments.
+====================
+*/
+void MovePaddle( const struct PhysicsParameters *parameters, struct Player *player, int input, float deltaSeconds ) {
+	float maxPosition = 1.0f - parameters->paddleSize;
+
+	// Accelerate in the direction of the input.
+	player->speed += input * parameters->paddleAcceleration * deltaSeconds;
+	if( player->speed > parameters->paddleMaxSpeed ) {
+		player->speed = parameters->paddleMaxSpeed;
+	}
+	if( player->speed < -parameters->paddleMaxSpeed ) {
+		player->speed = -parameters->paddleMaxSpeed;
+	}
+
+	player->position += player->speed * deltaSeconds;
+	// Some braking
+	player->speed -= ( player->speed / parameters->paddleMaxSpeed ) * parameters->paddleBraking * deltaSeconds;
+	// Check for borders!
+	if( player->position > maxPosition ) {
+		player->position = maxPosition;
+		player->speed *= -0.5f;
+	}
+	if( player->position < PADDLE_MIN_POS ) {
+		player->position = PADDLE_MIN_POS;
+		player->speed *= -0.5f;
+	}
+}
+
+/*
+====================
+FindImpact
+
+Sweeps the ball along its direction for up to maxSeconds and finds the first segment of
+the arena it touches, i.e. where the distance of its center to the segment's line shrinks
+to the radius. A ball that is already too close to a line and moves towards it touches it
+right away. Writes the time until the impact into impactSeconds and returns the index of
+the segment. Returns -1 and writes maxSeconds if the ball touches nothing in time.
+====================
+*/
+static int FindImpact( const struct PhysicsParameters *parameters, const struct Ball *ball, const struct ArenaGeometry *arena, float maxSeconds, float *impactSeconds ) {
+	const struct ArenaSegment *	segment;
+	float						distance;
+	float						approach;
+	float						seconds;
+	int							impact = -1;
+	int							i;
+
+	*impactSeconds = maxSeconds;
+	for( i = 0; i < arena->numSegments; i++ ) {
+		segment = &arena->segments[i];
+		approach = ScalarProduct2D( ball->direction, segment->normal );
+		if( approach >= 0.0f ) {
+			continue;
+		}
+		distance = ball->position.x * segment->normal.dx + ball->position.y * segment->normal.dy - segment->offset - parameters->ballRadius;
+		seconds = distance > 0.0f ? -distance / approach : 0.0f;
+		if( seconds <= maxSeconds && ( impact == -1 || seconds < *impactSeconds ) ) {
+			impact = i;
+			*impactSeconds = seconds;
+		}
+	}
+	return impact;
+}
+
+/*
+====================
+MoveBall
+
+Moves a ball in an arena whose paddles are where players says for deltaSeconds, and tells
+the handlers about hits and misses. The ball is swept against every segment of the arena,
+so it can't tunnel through anything, no matter how long the tick is. It may bounce up to
+MAX_BOUNCES times per tick. After a miss the ball stops until the next tick.
+====================
+*/
+void MoveBall( const struct PhysicsParameters *parameters, const struct ArenaGeometry *arena, const struct Player *players, struct Ball *ball, float deltaSeconds, const struct BallHandlers *handlers ) {
+	const struct ArenaSegment *	segment;
+	struct Vector2D				reflection;
+	float						remaining = deltaSeconds;
+	float						impactSeconds;
+	float						projection;
+	float						paddle;
+	int							line;
+	int							bounce;
+
+	for( bounce = 0; bounce < MAX_BOUNCES; bounce++ ) {
+		line = FindImpact( parameters, ball, arena, remaining, &impactSeconds );
+		if( line == -1 ) {
+			// Normal displacement.
+			ball->position = AddVectorToPoint2D( ball->position, ScaleVector2D( ball->direction, remaining ) );
+			return;
+		}
+		ball->position = AddVectorToPoint2D( ball->position, ScaleVector2D( ball->direction, impactSeconds ) );
+		remaining -= impactSeconds;
+		segment = &arena->segments[line];
+
+		// Walls just reflect the ball.
+		if( line >= arena->numPlayers ) {
+			ball->direction = GetReflectionVector( segment->normal, ball->direction, 0.0f );
+			if( handlers->wall ) {
+				handlers->wall( handlers->data );
+			}
+			continue;
+		}
+
+		// Check if the paddle hits the ball! The projection is 0 at the start of the segment and 1 at its end.
+		projection = ScalarProduct2D( DeltaVector2D( segment->start, ball->position ), segment->direction ) * segment->inverseLength;
+		paddle = players[line].position;
+		if( projection < paddle - parameters->paddleTolerance || projection > paddle + parameters->paddleSize + parameters->paddleTolerance ) {
+			handlers->miss( handlers->data, line );
+			return;
+		}
+
+		// The random deflection must not send the ball back out of the arena.
+		reflection = GetReflectionVector( segment->normal, ball->direction, parameters->deflectionDegrees * ( 2.0f * handlers->random( handlers->data ) - 1.0f ) );
+		if( ScalarProduct2D( reflection, segment->normal ) <= 0.0f ) {
+			reflection = GetReflectionVector( segment->normal, ball->direction, 0.0f );
+		}
+		ball->direction = reflection;
+		handlers->hit( handlers->data, line, ( projection - paddle + parameters->paddleTolerance ) / ( parameters->paddleSize + 2.0f * parameters->paddleTolerance ) );
+	}
+}
+
+/*
+====================
+ServeBall
+
+Puts a ball into the center of the arena and assigns it a new movement vector.
+====================
+*/
+void ServeBall( const struct PhysicsParameters *parameters, const struct ArenaGeometry *arena, struct Ball *ball, const struct BallHandlers *handlers ) {
+	float degrees;
+	float side;
+
+	// Reset ball position
+	ball->position = arena->center;
+
+	// New random movement vector, towards one of the two players if there are only two.
+	// The draws must happen in the same order everywhere, so they get a statement each.
+	if( arena->numPlayers == 2 ) {
+		side = handlers->random( handlers->data ) < 0.5f ? 0.0f : 180.0f;
+		degrees = side + 90.0f * handlers->random( handlers->data ) - 45.0f;
+	} else {
+		degrees = 360.0f * handlers->random( handlers->data );
+	}
+	ball->direction = VectorFromPolar2D( DEGREES_TO_RADIANS( degrees ), parameters->ballSpeed );
+}
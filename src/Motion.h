@@ -0,0 +1,80 @@
+#ifndef _MOTION_H
+#define _MOTION_H
+
+#include "Game.h"
+#include "Arena.h"
+
+#define PADDLE_SIZE 0.1f
+#define DEFAULT_BALL_RADIUS 0.05f
+#define PADDLE_MAX_POS ( 1.0f - PADDLE_SIZE )
+#define PADDLE_MIN_POS ( 0.0f )
+#define DEFAULT_BALL_SPEED 1.0f		// DISTANCE PER SECOND
+#define PADDLE_MAX_SPEED 1.5f		// DISTANCE PER SECOND
+#define PADDLE_TOLERANCE ( DEFAULT_BALL_RADIUS / 2.0f )
+#define PADDLE_ACCELERATION 4.0f	// DISTANCE PER SECOND SQUARED
+#define PADDLE_BRAKING 2.0f			// SHARE OF THE MAXIMUM SPEED LOST PER SECOND
+#define BALL_DEFLECTION_DEGREES 20	// HOW FAR A PADDLE TURNS THE BALL OFF A CLEAN REFLECTION AT MOST
+#define MAX_BOUNCES 8				// Times the ball may bounce within one tick, in case it gets stuck in a corner
+
+// The parameters the game plays with, for static initializers. GetDefaultPhysicsParameters returns them as well.
+#define DEFAULT_PHYSICS_PARAMETERS {				\
+	.ballSpeed = DEFAULT_BALL_SPEED,				\
+	.ballRadius = DEFAULT_BALL_RADIUS,				\
+	.paddleSize = PADDLE_SIZE,						\
+	.paddleTolerance = PADDLE_TOLERANCE,			\
+	.paddleAcceleration = PADDLE_ACCELERATION,		\
+	.paddleMaxSpeed = PADDLE_MAX_SPEED,				\
+	.paddleBraking = PADDLE_BRAKING,				\
+	.deflectionDegrees = BALL_DEFLECTION_DEGREES	\
+}
+
+/*
+==========================================================
+
+How paddles and balls move. The game always moves them with
+GetDefaultPhysicsParameters, simulated matches with whatever
+they are tuned to.
+
+==========================================================
+*/
+struct PhysicsParameters {
+	float	ballSpeed;				// Distance per second
+	float	ballRadius;
+	float	paddleSize;				// Part of a player's segment the paddle covers
+	float	paddleTolerance;		// How far beside the paddle a ball still counts as hit
+	float	paddleAcceleration;		// Distance per second squared
+	float	paddleMaxSpeed;			// Distance per second
+	float	paddleBraking;			// Share of the maximum speed the paddle loses per second
+	float	deflectionDegrees;		// A paddle turns the ball up to this far off a clean reflection
+};
+
+/*
+==========================================================
+
+What MoveBall and ServeBall leave to whoever moves the ball.
+Every handler gets data. random returns the next random
+number between 0 and 1. hit is called after a paddle turned
+the ball around, with where on the paddle it was hit, from 0
+at the start of its tolerance to 1 at the end of it. miss is
+called when a ball got past a paddle and has to serve it
+again. wall may be NULL.
+
+==========================================================
+*/
+struct BallHandlers {
+	float	( *random )( void *data );
+	void	( *hit )( void *data, int player, float spot );
+	void	( *miss )( void *data, int player );
+	void	( *wall )( void *data );
+	void *	data;
+};
+
+const struct PhysicsParameters *	GetDefaultPhysicsParameters( void );
+void								MovePaddle( const struct PhysicsParameters *parameters, struct Player *player, int input, float deltaSeconds );
+void								MoveBall( const struct PhysicsParameters *parameters, const struct ArenaGeometry *arena, const struct Player *players, struct Ball *ball, float deltaSeconds, const struct BallHandlers *handlers );
+void								ServeBall( const struct PhysicsParameters *parameters, const struct ArenaGeometry *arena, struct Ball *ball, const struct BallHandlers *handlers );
+struct Vector2D						ScaleVector2D( struct Vector2D vector, float scalar );
+struct Point2D						AddVectorToPoint2D( struct Point2D point, struct Vector2D vector );
+float								VectorNorm2D( struct Vector2D vector );
+
+#endif
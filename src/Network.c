@@ -1,32 +1,132 @@
 #include "Network.h"
 #include "Physics.h"
+#include "Snapshot.h"
+#include "Interpolation.h"
+#include "PacketBuffer.h"
+#include "Reactor.h"
+#include "Socket.h"
+#include "Link.h"
+#include "BitStream.h"
+#include "Feed.h"
 #include "Debug/Debug.h"
 #include <SDL2/SDL_net.h>
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 
 // DEFINITIONS
 
 #define ERROR_TCP_SOCKET_CREATION_FAILED -1
+#define ERROR_UDP_SOCKET_CREATION_FAILED -2
 #define PLAYER_NAME "fabian"
 #define MAX_PLAYER_NAME_LENGTH 40
+#define RECV_BUFFER_SIZE 4096
+#define PACKET_HEADER_LENGTH 8
+#define DATAGRAM_HEADER_LENGTH 12
+#define MAX_DATAGRAM_LENGTH 512
+#define MAX_COMMAND_RTT 1000			// Milliseconds of round trip time up to which a client can replay every command the server hasn't applied
+#define MAX_PENDING_COMMANDS ( MAX_TICK_RATE * MAX_COMMAND_RTT / 1000 )	// Input commands a client remembers until the server acknowledges them, one per tick
+#define MAX_COMMANDS_PER_DATAGRAM 8		// Unacknowledged input commands sent again in every datagram
+#define MAX_COMMAND_SECONDS 0.1f		// The longest frame a single input command may cover
+#define MAX_COMMAND_BUDGET 0.25f		// How many seconds of input a client may be ahead of the server
+#define CORRECTION_DECAY 10.0f			// Decay rate of the on-screen paddle correction per second
+#define BACKLOG_SMOOTHING 16.0f			// Inverse weight of a new sample in the average snapshot backlog
+#define HANDSHAKE_TIMEOUT 5000			// Milliseconds a client has to send its first datagram after the game started
+#define SILENCE_TIMEOUT 10000			// Milliseconds without a datagram after which a client is dropped
+#define FEED_KEYFRAME_INTERVAL 60		// Snapshots between two keyframes of the spectator feed
 
 // TYPES
 
 /*
 ==========================================================
 
+The paddle input of a client for one frame, see MovePaddle.
+
+==========================================================
+*/
+struct InputCommand {
+	uint32_t	sequence;
+	uint32_t	time;			// SDL_GetTicks() on the client when it applied the input
+	int			input;
+	float		deltaSeconds;
+};
+
+/*
+==========================================================
+
+A ring buffer which keeps the bytes received on a TCP socket until they form
+complete packets. Partial packets stay in here across calls.
+
+==========================================================
+*/
+struct RecvBuffer {
+	char	bytes[RECV_BUFFER_SIZE];
+	int		start;		// Index of the first unread byte
+	int		length;		// Amount of unread bytes
+};
+
+/*
+==========================================================
+
+Where the connection of a client is in its handshake with the server.
+When the game starts, the server waits for the first datagram of each
+client until a deadline, without blocking the game. Clients that don't
+make it, or fall silent later, are dropped. Dropped clients keep their
+seat, so the indices of the other players stay the same, but their
+paddle doesn't move anymore.
+
+==========================================================
+*/
+enum ConnectionState {
+	CS_LOBBY,			// Connected on the control socket, the game hasn't started
+	CS_AWAITING_DATA,	// The game has started, the data address is unknown yet
+	CS_IN_GAME,			// The client's datagrams arrive
+	CS_DROPPED			// Timed out or lost, the control socket is closed
+};
+
+/*
+==========================================================
+
+The measurements behind the ConnectionStats of one peer.
+The byte and datagram counters cover the current window.
+
+==========================================================
+*/
+struct Telemetry {
+	struct ConnectionStats	stats;
+	int						hasRtt;			// A boolean value which is 0 until the first pong arrived
+	unsigned int			nextPing;		// SDL_GetTicks() when the next ping is due
+	unsigned int			windowStart;	// SDL_GetTicks() when the current window began
+	unsigned int			bytesSent;
+	unsigned int			bytesReceived;
+	unsigned int			datagrams;		// The peer's datagrams that arrived in order
+	uint32_t				firstSequence;	// The newest sequence number of the peer when the window began
+};
+
+/*
+==========================================================
+
 A struct which saves information about a player in the network context.
-The socket is NULL for every player unless isServer is true.
+The socket is NO_STREAM_SOCKET for every player unless isServer is true.
 
 ==========================================================
 */
 struct NetworkClientInfo {
 	char *				alias;
-	TCPsocket			socket;
-	SDLNet_SocketSet	socketSet;
-	TCPsocket			dataSocket;
-	SDLNet_SocketSet	dataSocketSet;
+	streamSocket_t		socket;
+	IPaddress			address;			// Where socket is connected from
+	struct RecvBuffer	recvBuffer;			// Pending bytes from socket
+	IPaddress			dataAddress;		// Where the client's datagrams come from
+	enum ConnectionState	connectionState;
+	unsigned int		deadline;			// SDL_GetTicks() until which the client has to send a datagram
+	uint32_t			lastDataSequence;	// Sequence number of the newest datagram received from the client
+	uint32_t			dataSequence;		// Sequence number of the last datagram sent to the client
+	struct SnapshotHistory	snapshotHistory;	// Snapshots recently sent to the client
+	uint32_t			ackedSnapshot;		// The newest snapshot the client has acknowledged, 0 if none
+	uint32_t			lastCommand;		// Sequence number of the last input command applied
+	float				commandBudget;		// Seconds of input the client may still send
+	int					isSimulated;		// A seat that only receives snapshots, see AddSimulatedClient
+	struct Telemetry	telemetry;			// How the connection to the client is doing
 };
 
 /*
@@ -39,9 +139,31 @@ A packet on the active socket looks like this:
 	Len		4		The length of the whole packet in bytes
 	Args	Len-8	The arguments, depending on the packet
 					type.
-A packet on the data socket only contains either a serialized
-GameState (when sent by the server) or a serialized paddle
-position float (when sent by a client).
+The data socket is a UDP socket, every datagram on it looks like this:
+	Name	Length	Description
+	PID		4		The type of packet
+	Len		4		The length of the whole datagram in bytes
+	Seq		4		Sequence number, increases with every datagram
+					to the same peer
+	Args	Len-12	The arguments, depending on the packet
+					type.
+It carries either an encoded snapshot of the GameState geometry
+(PID_STATE_GEOMETRY +acked_command+paddle_speed+snapshot, sent by
+the server, see EncodeSnapshot) or a client's input commands
+(PID_INPUT_COMMANDS, sent by a client, see ClientSendStateGeometry).
+The server encodes every snapshot as a delta against the newest
+snapshot the client has acknowledged. It is the authority over all
+paddles: clients predict their own paddle and replay the commands
+the server hasn't acknowledged yet on top of every snapshot. Everything else is
+shown slightly in the past, interpolated between the snapshots around that time,
+see struct JitterBuffer. Datagrams that are older than the newest one received
+are stale and get dropped.
+Spectators send a single PID_SPECTATE on the active socket and
+then only listen. They get the joins and the start of the game
+like a player in the lobby, but in game the snapshots come on
+the active socket as well: PID_FEED_KEYFRAME carries the scores
+and a full snapshot, PID_FEED_SNAPSHOT a snapshot encoded against
+the one before it, which never gets lost on a stream.
 
 ==========================================================
 */
@@ -52,7 +174,15 @@ enum PacketId {
 	PID_MY_NAME,	// Tells the server the client's name
 	PID_START_GAME,	// Starts the game (+data_port)
 	PID_BALL_HIT,	// Registers a ball hit (+player_id)
-	PID_SCORE		// New score (+player_id+score)
+	PID_SCORE,		// New score (+player_id+score)
+	PID_STATE_GEOMETRY,		// Data socket: GameState geometry (+acked_command+paddle_speed+encoded snapshot)
+	PID_INPUT_COMMANDS,		// Data socket: a client's input commands (+player_id+acked_snapshot+commands)
+	PID_DATA_HELLO,			// Data socket: announces a client's address (+player_id)
+	PID_PING,		// In game, both ways: asks for a pong (+sender_time)
+	PID_PONG,		// In game, both ways: answers a ping (+sender_time of the ping)
+	PID_SPECTATE,			// A spectator asks to watch a match (+match)
+	PID_FEED_SNAPSHOT,		// To spectators: snapshot against the previous one (+encoded snapshot)
+	PID_FEED_KEYFRAME		// To spectators: everything late viewers need (+last_hit+scores+encoded full snapshot)
 };
 
 /*
@@ -67,50 +197,113 @@ union IntFloat {
 	float	f;
 };
 
+/*
+==========================================================
+
+Everything the network component knows about one match. A
+program that plays has a single one, a dedicated server has
+one per match. Every thread works on the context it selected
+with SelectNetworkContext, so matches on different threads
+never share any state.
+
+==========================================================
+*/
+struct NetworkContext {
+	int						isServer;			// A boolean value which is 1 if this component is a server and 0 if it is a client.
+	int						isConnected;		// A boolean value which indicates whether the component is currently connected.
+
+	streamSocket_t			activeSocket;		// The current socket for state & meta information, the listening socket on the server
+	IPaddress				serverAddress;		// Where the activeSocket of a client is connected to
+	struct RecvBuffer		activeRecvBuffer;	// Pending bytes from activeSocket
+	struct Reactor			reactor;			// All sockets of the server
+	datagramSocket_t		dataSocket;			// The current socket for exchange of in-game information
+	UDPpacket *				dataPacket;			// Datagram buffer for the data socket
+	struct Link				link;				// Emulated network conditions below the data socket, see --netsim-out
+	IPaddress				serverDataAddress;	// Where the client sends its datagrams to
+	uint32_t				dataSequence;		// Sequence number of the last datagram sent to the server
+	uint32_t				lastDataSequence;	// Sequence number of the newest datagram received from the server
+	uint32_t				snapshotSequence;	// Sequence number of the last snapshot taken (server) or decoded (client)
+	struct SnapshotHistory	snapshotHistory;	// Snapshots recently received from the server
+	struct JitterBuffer		jitterBuffer;		// Snapshots the client interpolates between
+	struct SnapshotStats	snapshotStats;		// What happened to the snapshots the client received
+	struct Telemetry		serverTelemetry;	// How the client's connection to the server is doing
+	struct InputCommand		pendingCommands[MAX_PENDING_COMMANDS];	// Input commands of this client, indexed by sequence number
+	uint32_t				commandSequence;	// Sequence number of the last input command recorded
+	uint32_t				sentCommand;		// The last input command sent to the server at least once
+	uint32_t				ackedCommand;		// The last input command the server has applied
+	unsigned int			lastUpdateTime;		// SDL_GetTicks() of the last in-game update
+	int						tickRate;			// How often per second ProcessInGame gets called on the server
+	int						snapshotRate;		// How many snapshots per second the server sends
+	int						snapshotCredit;		// Adds up snapshotRate every tick, a snapshot is due when it reaches tickRate
+
+	struct NetworkClientInfo	clients[MAX_PLAYERS];
+	int						numClients;			// The amount of filled in elements of the clients array
+	int						thisClient;			// The index of this client in the clients array
+
+	int						isSpectator;		// A boolean value which is 1 if this client only watches, see ConnectSpectator
+	struct SpectatorFeed *	feed;				// Where the server publishes the match for spectators, NULL if nobody may watch
+	int						isFeedLive;			// A boolean value which is 1 while a game is published to the feed
+	struct Snapshot			feedSnapshot;		// The last snapshot published to the feed
+	int						feedCountdown;		// Snapshots until the next keyframe
+	char					feedPreamble[FEED_PREAMBLE_SIZE];	// Joins a relay has collected for its next preamble
+	int						feedPreambleLength;
+};
+
 // VARIABLES
 
-static int						isServer = 0;			// A boolean value which is 1 if this component is a server and 0 if it is a client.
-static int						isConnected = 0;		// A boolean value which indicates whether the component is currently connected.
 static int						isInitialized = 0;		// A boolean value indicating initialization state.
 int								clientGameStarted = 0;	// Is 1 only if the network component is in client mode and the server has started the game
+static enum SnapshotConsumption	snapshotConsumption = SC_LATEST;	// What a client does with a backlog of snapshots
 
-static TCPsocket				activeSocket = NULL;	// The current socket for state & meta information
-static SDLNet_SocketSet			activeSocketSet = NULL;	// The associated socket set for asio
-static TCPsocket				dataSocket = NULL;		// The current socket for exchange of in-game information
-static SDLNet_SocketSet			dataSocketSet = NULL;	// The associated socket set for asio
-
-static struct NetworkClientInfo clients[6];				// 6 players maximum, eh?!
-static int						numClients = 0;			// The amount of filled in elements of the clients array
-static int						thisClient = -1;		// The index of this client in the clients array
+static struct NetworkContext	defaultContext = { .activeSocket = NO_STREAM_SOCKET, .dataSocket = NO_DATAGRAM_SOCKET, .thisClient = -1, .tickRate = DEFAULT_TICK_RATE, .snapshotRate = DEFAULT_SNAPSHOT_RATE };
+static _Thread_local struct NetworkContext *network = &defaultContext;	// The context of the match this thread works on
 
 // FUNCTIONS
 
-static int	ConnectLocalServer( TCPsocket *socket, uint16_t localPort );
-static int	ConnectRemoteServer( TCPsocket *socket, SDLNet_SocketSet *socketSet, const char *remoteAddress, uint16_t remotePort );
-static int	ConnectRemoteServerIp( TCPsocket *socket, SDLNet_SocketSet *socketSet, IPaddress *remoteAddress );
-static int	NonBlockingRecv( TCPsocket socket, SDLNet_SocketSet set, char *data, int maxlen );
+static int	ConnectLocalServer( streamSocket_t *socket, uint16_t localPort );
+static int	ConnectRemoteServer( streamSocket_t *socket, const char *remoteAddress, uint16_t remotePort );
+static int	ConnectRemoteServerIp( streamSocket_t *socket, IPaddress *remoteAddress );
+static int	NonBlockingRecv( streamSocket_t socket, struct RecvBuffer *buffer, char *data, int maxlen );
+static int	FillRecvBuffer( streamSocket_t socket, struct RecvBuffer *buffer );
+static int	PopPacket( struct RecvBuffer *buffer, char *data, int maxlen );
+static int	PopPackets( struct RecvBuffer *buffer, char *data, int maxlen );
+static int	OpenDataSocket( uint16_t localPort );
+static void	CloseDataSocket( void );
+static int	SendDatagram( const IPaddress *address, uint32_t *sequence, int packetId, const char *args, int argsLength );
+static int	SendDatagramWithPayload( const IPaddress *address, uint32_t *sequence, int packetId, const char *args, int argsLength, const struct PacketBuffer *payload );
+static int	ReceiveDatagram( const char **args, int *argsLength, uint32_t *sequence );
+static int	IsNewerSequence( uint32_t sequence, uint32_t lastSequence );
+static void	ResetTelemetry( struct Telemetry *telemetry, uint32_t sequence );
+static void	SendTelemetryPacket( streamSocket_t socket, struct Telemetry *telemetry, int packetId, uint32_t time );
+static void	HandlePong( struct Telemetry *telemetry, uint32_t time );
+static void	UpdateTelemetry( struct Telemetry *telemetry, streamSocket_t socket, uint32_t sequence, int player );
+static void	PublishToSpectators( const void *data, int length, int isKeyframe );
 
 static int	AddPlayer( struct NetworkClientInfo client );
 static void	RemovePlayer( int playerId );
 
-static void SerializeGameStateGeometry( const struct GameState *state, char **buffer, int *bufferLength );
-static void DeserializeGameStateGeometry( struct GameState *state, const char *buffer, int bufferLength );
-
 // SERVER-ONLY FUNCTIONS
 
 static int	BroadcastPacketToClients( const void *data, int length );
-static void	IssueAllJoins( TCPsocket socket );
+static void	IssueAllJoins( streamSocket_t socket );
 static int	ServerAcceptClients( void );
+static int	ServerPollSockets( struct GameState *state, unsigned int timeout );
 static int	ServerProcessLobbyIncomingPackets( int client, char *bytes, int numBytes );
 static void	ServerHandleClientQuit( int playerId );
 static void	ServerHandleClientMyName( int playerId, char *name );
 static int	ServerProcessLobby( void );
-static int	AcceptAllDataClients( void );
+static void	ServerCheckDeadlines( void );
+static void	ServerDropClient( int client, const char *reason );
+static int	ServerHandleLostClient( int client, const char *reason );
+static int	RegisterDataAddress( const char *args, int argsLength );
+static void	ServerPublishPreamble( void );
+static void	ServerPublishSnapshot( const struct GameState *state, const struct Snapshot *snapshot );
 static void ServerUpdateClientGeometry( struct GameState *state );
 static void ServerSendGameStateGeometry( const struct GameState *state );
 static void ServerInGameSendHit( int player );
 static void ServerInGameSendScore( const struct GameState *state, int player );
 static void ServerInGameSendQuit( void );
+static void	ServerApplyInputCommands( struct GameState *state, int player, const char *args, int argsLength );
 static int	ServerProcessInGameIncomingPackets( void );
 static int	ServerProcessInGame( struct GameState *state );
 
@@ -120,9 +313,14 @@ static int	ClientProcessLobby( void );
 static int	ClientProcessLobbyIncomingPackets( char *bytes, int numBytes );
 static void	ClientHandleClientJoin( int playerId, char *name );
 static void	ClientHandleServerYourId( int newId );
-static void	ClientHandleServerStartGame( void );
+static void	ClientHandleServerStartGame( uint16_t udpPort );
 static void ClientSendStateGeometry( const struct GameState *state );
 static void ClientUpdateStateGeometry( struct GameState *state );
+static int	ClientApplySnapshot( struct GameState *state, const char *args, int argsLength, uint32_t sequence, uint32_t *acked, float *position, float *speed );
+static void	ClientApplyFeedSnapshot( struct GameState *state, const char *bytes, int numBytes );
+static void	ClientInterpolateStateGeometry( struct GameState *state, unsigned int now );
+static void	ClientRecordInput( int input, float deltaSeconds );
+static void	ClientReconcile( struct Player *player, uint32_t acked, float position, float speed );
 static int	ClientUpdateStateInformation( struct GameState *state );
 static int	ClientProcessInGameIncomingPackets( struct GameState *state, char *bytes, int numBytes );
 static int	ClientProcessInGame( struct GameState *state );
@@ -152,8 +350,15 @@ int InitializeNetwork( void ) {
 	}
 
 	// Set clients to zero.
-	memset( clients, 0, sizeof( struct NetworkClientInfo ) * 6 );
-	numClients = 0;
+	memset( network->clients, 0, sizeof( struct NetworkClientInfo ) * MAX_PLAYERS );
+	network->numClients = 0;
+
+	// Clients send their input to the server.
+	AtRegisterInput( &ClientRecordInput );
+	// Register the broadcast functions with the physics component so hits and misses get sent to the other clients.
+	AtRegisterHit( &ServerInGameSendHit );
+	AtRegisterPoint( &ServerInGameSendScore );
+	AtRegisterQuit( &ServerInGameSendQuit );
 
 	// Set isInitialized to value representing true.
 	isInitialized = 1;
@@ -176,6 +381,58 @@ void CloseNetwork( void ) {
 	SDLNet_Quit();
 }
 
+/*
+====================
+CreateNetworkContext
+
+Allocates the network context for another match. Select it with
+SelectNetworkContext before calling Connect on the thread that runs the match.
+====================
+*/
+struct NetworkContext *CreateNetworkContext( void ) {
+	struct NetworkContext *context = calloc( 1, sizeof( struct NetworkContext ) );
+
+	DebugAssert( context );
+	if( !context ) {
+		return NULL;
+	}
+	context->activeSocket = NO_STREAM_SOCKET;
+	context->dataSocket = NO_DATAGRAM_SOCKET;
+	context->thisClient = -1;
+	context->tickRate = DEFAULT_TICK_RATE;
+	context->snapshotRate = DEFAULT_SNAPSHOT_RATE;
+
+	return context;
+}
+
+/*
+====================
+DestroyNetworkContext
+
+Frees a context made by CreateNetworkContext. It has to be disconnected already.
+====================
+*/
+void DestroyNetworkContext( struct NetworkContext *context ) {
+	if( !context ) {
+		return;
+	}
+	DebugAssert( !context->isConnected );
+	DebugAssert( context != network );
+	free( context );
+}
+
+/*
+====================
+SelectNetworkContext
+
+Makes all following network calls of this thread work on the given context,
+or on the one of the program if context is NULL.
+====================
+*/
+void SelectNetworkContext( struct NetworkContext *context ) {
+	network = context ? context : &defaultContext;
+}
+
 /*
 ====================
 Connect
@@ -197,24 +454,31 @@ int Connect( int server, const char *remoteAddress, uint16_t port ) {
 		return -1;
 	}
 
-	isServer = server;
+	network->isServer = server;
 	// Branch for server/client.
 	if( server ) {
-		if( !ConnectLocalServer( &activeSocket, port ) ) {
+		if( !ConnectLocalServer( &network->activeSocket, port ) ) {
+			// From now on, the reactor tells us which sockets have something for us.
+			if( InitializeReactor( &network->reactor ) || AddReactorSocket( &network->reactor, REACTOR_SOCKET( network->activeSocket ) ) ) {
+				DebugPrintF( "Could not set up the reactor." );
+			}
+			// A dedicated server doesn't play itself.
+			if( IsDedicated() ) {
+				return 0;
+			}
 			struct NetworkClientInfo clientInfo;
+			memset( &clientInfo, 0, sizeof( clientInfo ) );
 			clientInfo.alias = malloc( MAX_PLAYER_NAME_LENGTH );
 			GetUserName( clientInfo.alias );
-			clientInfo.socket = NULL;
-			clientInfo.socketSet = NULL;
-			clientInfo.dataSocket = NULL;
-			clientInfo.dataSocketSet = NULL;
+			clientInfo.socket = NO_STREAM_SOCKET;
 			AddPlayer( clientInfo );
 			return 0;
 		} else {
 			return -1;
 		}
 	} else {
-		return ConnectRemoteServer( &activeSocket, &activeSocketSet, remoteAddress, port );
+		memset( &network->activeRecvBuffer, 0, sizeof( network->activeRecvBuffer ) );
+		return ConnectRemoteServer( &network->activeSocket, remoteAddress, port );
 	}
 }
 
@@ -225,23 +489,15 @@ ConnectLocalServer
 Creates a server to listen for incoming connections.
 ====================
 */
-static int ConnectLocalServer( TCPsocket *socket, uint16_t localPort ) {
+static int ConnectLocalServer( streamSocket_t *socket, uint16_t localPort ) {
 	// Create a listening TCP socket on localPort
-	IPaddress	ip;
-	TCPsocket	listener;
-	int			result;
+	streamSocket_t listener = OpenStreamListener( localPort );
 
-	result = SDLNet_ResolveHost( &ip, NULL, localPort );
-	if( result ) {
-		return result;
-	}
-
-	listener = SDLNet_TCP_Open( &ip );
-	if( !listener ) {
+	if( listener == NO_STREAM_SOCKET ) {
 		return ERROR_TCP_SOCKET_CREATION_FAILED;
 	}
 
-	isConnected = 1;
+	network->isConnected = 1;
 	*socket = listener;
 
 	return 0;
@@ -254,7 +510,7 @@ ConnectRemoteServer
 Creates a socket that communicates with a remote server.
 ====================
 */
-static int ConnectRemoteServer( TCPsocket *socket, SDLNet_SocketSet *socketSet, const char *remoteAddress, uint16_t remotePort ) {
+static int ConnectRemoteServer( streamSocket_t *socket, const char *remoteAddress, uint16_t remotePort ) {
 	IPaddress	ip;
 	int			result;
 
@@ -264,7 +520,7 @@ static int ConnectRemoteServer( TCPsocket *socket, SDLNet_SocketSet *socketSet,
 		return result;
 	}
 
-	return ConnectRemoteServerIp( socket, socketSet, &ip );
+	return ConnectRemoteServerIp( socket, &ip );
 }
 
 /*
@@ -274,23 +530,128 @@ ConnectRemoteServerIp
 Connects to a remote server using an IPaddress pointer.
 ====================
 */
-static int ConnectRemoteServerIp( TCPsocket *socket, SDLNet_SocketSet *socketSet, IPaddress *remoteAddress ) {
-	TCPsocket	client;
+static int ConnectRemoteServerIp( streamSocket_t *socket, IPaddress *remoteAddress ) {
+	streamSocket_t client = ConnectStream( remoteAddress );
 
-	client = SDLNet_TCP_Open( remoteAddress );
-	if( !client ) {
+	if( client == NO_STREAM_SOCKET ) {
 		return ERROR_TCP_SOCKET_CREATION_FAILED;
 	}
 
-	isConnected = 1;
+	network->isConnected = 1;
+	network->serverAddress = *remoteAddress;
 	*socket = client;
 
-	*socketSet = SDLNet_AllocSocketSet( 1 );
-	SDLNet_TCP_AddSocket( *socketSet, client );
+	return 0;
+}
+
+/*
+====================
+ConnectSpectator
+
+Connects to the spectator port of a server or a relay as a client that watches the
+given match. Lobby and game go on like for a player, except that this client has no
+paddle and never sends anything else.
+====================
+*/
+int ConnectSpectator( const char *remoteAddress, uint16_t port, int match ) {
+	char packet[SPECTATE_REQUEST_LENGTH];
+
+	if( Connect( 0, remoteAddress, port ) ) {
+		return -1;
+	}
+	network->isSpectator = 1;
 
+	SDLNet_Write32( ( int )PID_SPECTATE,	&packet[0] );
+	SDLNet_Write32( sizeof( packet ),		&packet[4] );
+	SDLNet_Write32( match,					&packet[8] );
+	if( SendStream( network->activeSocket, packet, sizeof( packet ) ) ) {
+		Disconnect();
+		return -1;
+	}
 	return 0;
 }
 
+/*
+====================
+ReadSpectateRequest
+
+Parses the SPECTATE_REQUEST_LENGTH bytes a spectator sends first. Returns the match
+it wants to watch, or -1 if the bytes aren't a PID_SPECTATE.
+====================
+*/
+int ReadSpectateRequest( const char *bytes, int length ) {
+	int match;
+
+	if( length < SPECTATE_REQUEST_LENGTH || SDLNet_Read32( &bytes[0] ) != PID_SPECTATE || SDLNet_Read32( &bytes[4] ) != SPECTATE_REQUEST_LENGTH ) {
+		return -1;
+	}
+	match = ( int )SDLNet_Read32( &bytes[8] );
+	return match >= 0 ? match : -1;
+}
+
+/*
+====================
+SetSpectatorFeed
+
+Makes the server publish every game of the selected context to feed, or to nobody
+if feed is NULL. The feed has to outlive the context.
+====================
+*/
+void SetSpectatorFeed( struct SpectatorFeed *feed ) {
+	network->feed = feed;
+	network->isFeedLive = 0;
+}
+
+/*
+====================
+ForwardSpectatorStream
+
+For use by relays, which are connected with ConnectSpectator. Publishes everything
+that arrived from upstream to feed without decoding it. The joins are held back
+until the game starts, then they become the preamble of the feed together with the
+start. Returns -1 when the connection is lost.
+====================
+*/
+int ForwardSpectatorStream( struct SpectatorFeed *feed ) {
+	char	bytes[RECV_BUFFER_SIZE];
+	int		numBytes;
+
+	if( !network->isConnected || !network->isSpectator ) {
+		return -1;
+	}
+	if( FillRecvBuffer( network->activeSocket, &network->activeRecvBuffer ) == -1 ) {
+		return -1;
+	}
+
+	while( ( numBytes = PopPacket( &network->activeRecvBuffer, bytes, sizeof( bytes ) ) ) > 0 ) {
+		switch( SDLNet_Read32( &bytes[0] ) ) {
+			case PID_JOIN:
+			case PID_START_GAME:
+				if( network->feedPreambleLength + numBytes > FEED_PREAMBLE_SIZE ) {
+					DebugPrintF( "Dropping a packet that doesn't fit into the preamble." );
+					break;
+				}
+				memcpy( &network->feedPreamble[network->feedPreambleLength], bytes, numBytes );
+				network->feedPreambleLength += numBytes;
+				if( SDLNet_Read32( &bytes[0] ) == PID_START_GAME ) {
+					SetFeedPreamble( feed, network->feedPreamble, network->feedPreambleLength );
+					network->feedPreambleLength = 0;
+				}
+				break;
+			case PID_QUIT:
+				// Late viewers wait for the next game instead of watching this one end.
+				PublishFeed( feed, bytes, numBytes, 0 );
+				SetFeedPreamble( feed, NULL, 0 );
+				break;
+			default:
+				PublishFeed( feed, bytes, numBytes, SDLNet_Read32( &bytes[0] ) == PID_FEED_KEYFRAME );
+				break;
+		}
+	}
+
+	return numBytes;
+}
+
 /*
 ====================
 Disconnect
@@ -299,15 +660,29 @@ Disconnects the network component's sockets.
 ====================
 */
 void Disconnect( void ) {
-	if( activeSocket ) {
-		SDLNet_TCP_Close( activeSocket );
+	int client;
+
+	if( network->isServer ) {
+		CloseReactor( &network->reactor );
 	}
-	if( isServer ) {
+	CloseStream( network->activeSocket );
+	network->activeSocket = NO_STREAM_SOCKET;
+	if( network->isServer ) {
 		ServerInGameSendQuit();
+		for( client = 0; client < network->numClients; client++ ) {
+			CloseStream( network->clients[client].socket );
+		}
+	}
+	if( !network->isServer && clientGameStarted ) {
+		DebugPrintF( "Snapshots: %u received, %u skipped, %u stale, %u undecodable, backlog %.2f on average and %d at most.",
+			network->snapshotStats.received, network->snapshotStats.skipped, network->snapshotStats.stale, network->snapshotStats.undecodable, network->snapshotStats.averageBacklog, network->snapshotStats.maxBacklog );
 	}
-	isConnected = 0;
-	memset( clients, 0, sizeof( struct NetworkClientInfo ) * 6 );
-	numClients = 0;
+	CloseDataSocket();
+	network->isConnected = 0;
+	network->isSpectator = 0;
+	network->feedPreambleLength = 0;
+	memset( network->clients, 0, sizeof( struct NetworkClientInfo ) * MAX_PLAYERS );
+	network->numClients = 0;
 }
 
 /*
@@ -321,11 +696,11 @@ int ProcessLobby( void ) {
 	if( !isInitialized ) {
 		return -1;
 	}
-	if( !isConnected ) {
+	if( !network->isConnected ) {
 		return -1;
 	}
 
-	if( isServer ) {
+	if( network->isServer ) {
 		return ServerProcessLobby();
 	} else {
 		return ClientProcessLobby();
@@ -343,11 +718,11 @@ int ProcessInGame( struct GameState *state ) {
 	if( !isInitialized ) {
 		return -1;
 	}
-	if( !isConnected ) {
+	if( !network->isConnected ) {
 		return -1;
 	}
 
-	if( isServer ) {
+	if( network->isServer ) {
 		return ServerProcessInGame( state );
 	} else {
 		return ClientProcessInGame( state );
@@ -358,163 +733,595 @@ int ProcessInGame( struct GameState *state ) {
 ====================
 NonBlockingRecv
 
-Receives from the socket in a non-blocking fashion.
+Receives from the socket in a non-blocking fashion. Everything that is readable
+gets drained into the ring buffer in bulk, then as many complete packets as fit
+are copied to data. Returns the amount of bytes written to data, which is always
+a whole number of packets, or -1 if the socket failed or the stream is corrupt.
 ====================
 */
-static int NonBlockingRecv( TCPsocket socket, SDLNet_SocketSet set, char *data, int maxlen ) {
-	int bPosition = 0;
-	while( SDLNet_CheckSockets( set, 0 ) > 0 && bPosition < maxlen ) {
-		if( SDLNet_SocketReady( socket ) ) {
-			if( SDLNet_TCP_Recv( socket, &data[bPosition++], 1 ) == -1 ) {
-				return -1;
-			}
-		}
+static int NonBlockingRecv( streamSocket_t socket, struct RecvBuffer *buffer, char *data, int maxlen ) {
+	if( FillRecvBuffer( socket, buffer ) == -1 ) {
+		return -1;
 	}
-	return bPosition;
+
+	return PopPackets( buffer, data, maxlen );
 }
 
 /*
 ====================
-ServerAcceptClients
+PopPackets
 
-Accepts new clients on the activeSocket.
+Copies as many complete packets out of the ring buffer as fit into maxlen bytes.
+Returns the amount of bytes written to data or -1 if the stream is corrupt.
 ====================
 */
-static int ServerAcceptClients( void ) {
-	// Accept new clients!
-	TCPsocket newClient = NULL;
-	newClient = SDLNet_TCP_Accept( activeSocket );
+static int PopPackets( struct RecvBuffer *buffer, char *data, int maxlen ) {
+	int bPosition = 0;
+	int packetLength;
 
-	if( newClient ) {
-		DebugPrintF( "A new client has connected." );
-		struct NetworkClientInfo clientInfo;
-		clientInfo.alias = NULL;
-		clientInfo.socketSet = SDLNet_AllocSocketSet( 1 );
-		clientInfo.socket = newClient;
-		clientInfo.dataSocket = NULL;
-		clientInfo.dataSocketSet = NULL;
-		SDLNet_TCP_AddSocket( clientInfo.socketSet, newClient );
-		// Tell client about the rest of the world.
-		IssueAllJoins( newClient );
-		int newId = AddPlayer( clientInfo );
-		int packet[3];
-		SDLNet_Write32( ( int )PID_YOUR_ID,	&packet[0] );
-		SDLNet_Write32( 12,					&packet[1] );
-		SDLNet_Write32( newId,				&packet[2] );
-		SDLNet_TCP_Send( clients[newId].socket, packet, sizeof( packet ) );
+	while( ( packetLength = PopPacket( buffer, &data[bPosition], maxlen - bPosition ) ) > 0 ) {
+		bPosition += packetLength;
 	}
-	return 0;
+	// A packet that only doesn't fit behind the ones we have is the first one of the next call.
+	if( packetLength == -1 && bPosition == 0 ) {
+		return -1;
+	}
+	return bPosition;
 }
 
 /*
 ====================
-ServerProcessLobbyIncomingPackets
+FillRecvBuffer
 
-Given a client ID and a packet buffer, reads all the packets and takes action according to their contents.
+Reads everything that is currently readable on the socket into the free space of
+the ring buffer, using as few receive calls as possible. Returns the amount of bytes
+received or -1 if the connection failed.
 ====================
 */
-static int ServerProcessLobbyIncomingPackets( int client, char *bytes, int numBytes ) {
-	int bReadPosition = 0;
-	int endOfStream = 0;
-	int stringLength;
-	char *name;
+static int FillRecvBuffer( streamSocket_t socket, struct RecvBuffer *buffer ) {
+	int received = 0;
+	int end;
+	int freeSpace;
+	int result;
 
-	while( !endOfStream ) {
-		switch( SDLNet_Read32( &bytes[bReadPosition] ) ) {
-			case PID_QUIT:
-				// Handle the quit
-				ServerHandleClientQuit( client );
-				break;
-			case PID_MY_NAME:
-				// Determine length of name and call handler with the length.
-				stringLength = SDLNet_Read32( &bytes[bReadPosition + 4] ) - 8;
-				name = malloc( stringLength + 1 );
-				strncpy( name, &bytes[bReadPosition + 8], stringLength );
-				name[stringLength] = '\0';
-				DebugPrintF( "Client #%d is now called %s.", client, name );
-				ServerHandleClientMyName( client, name );
-				//return 10;
-				break;
+	while( buffer->length < RECV_BUFFER_SIZE ) {
+		// Only receive into the contiguous free area, the rest follows in the next iteration.
+		end = ( buffer->start + buffer->length ) % RECV_BUFFER_SIZE;
+		freeSpace = RECV_BUFFER_SIZE - buffer->length;
+		if( end + freeSpace > RECV_BUFFER_SIZE ) {
+			freeSpace = RECV_BUFFER_SIZE - end;
 		}
-		bReadPosition += SDLNet_Read32( &bytes[bReadPosition + 4] );
-		if( bReadPosition >= numBytes ) {
-			endOfStream = 1;
+
+		result = ReceiveNonBlocking( socket, &buffer->bytes[end], freeSpace );
+		if( result == -1 ) {
+			return -1;
+		}
+		if( result == 0 ) {
+			break;
 		}
+		buffer->length += result;
+		received += result;
 	}
 
-	return 0;
+	return received;
 }
 
 /*
 ====================
-ServerProcessLobby
+PopPacket
 
-Accepts incoming connections, receives information packets from clients and
-informs all clients about the new client.
+Copies the first packet out of the ring buffer if it has been received completely.
+Returns its length, 0 if it is still incomplete or -1 if the header announces a
+length that can never be valid or that doesn't fit into maxlen bytes. Such a packet
+would block the stream forever, so the caller has to drop the connection.
 ====================
 */
-static int ServerProcessLobby( void ) {
-	ServerAcceptClients();
+static int PopPacket( struct RecvBuffer *buffer, char *data, int maxlen ) {
+	char	header[PACKET_HEADER_LENGTH];
+	int		packetLength;
+	int		firstPart;
+	int		n;
+
+	if( buffer->length < PACKET_HEADER_LENGTH ) {
+		return 0;
+	}
 
-	// Process other clients' packets!
-	int numBytes;
-	char bytes[1024];
-	int client;
+	// The header may wrap around the end of the ring.
+	for( n = 0; n < PACKET_HEADER_LENGTH; n++ ) {
+		header[n] = buffer->bytes[( buffer->start + n ) % RECV_BUFFER_SIZE];
+	}
+	packetLength = SDLNet_Read32( &header[4] );
+	if( packetLength < PACKET_HEADER_LENGTH || packetLength > RECV_BUFFER_SIZE ) {
+		DebugPrintF( "Dropping stream with invalid packet length %d.", packetLength );
+		return -1;
+	}
+	if( packetLength > maxlen ) {
+		return -1;
+	}
+	if( packetLength > buffer->length ) {
+		return 0;
+	}
 
-	// Go through the clients
-	for( client = 0; client < numClients; client++ ) {
-		// If there is a socket (so, not this client)
-		if( !clients[client].socket ) {
-			continue;
-		}
-		// while there is something to read from, process the packets.
-		while( 1 ) {
-			numBytes = NonBlockingRecv( clients[client].socket, clients[client].socketSet, bytes, sizeof( bytes ) );
-			if( numBytes <= 0 ) {
-				break;
-			}
-			DebugPrintF( "Received %d bytes.", numBytes );
-			ServerProcessLobbyIncomingPackets( client, bytes, numBytes );
-		}
+	// Copy the packet in at most two pieces.
+	firstPart = RECV_BUFFER_SIZE - buffer->start;
+	if( firstPart > packetLength ) {
+		firstPart = packetLength;
 	}
+	memcpy( data, &buffer->bytes[buffer->start], firstPart );
+	memcpy( &data[firstPart], buffer->bytes, packetLength - firstPart );
 
-	return 0;
+	buffer->start = ( buffer->start + packetLength ) % RECV_BUFFER_SIZE;
+	buffer->length -= packetLength;
+	return packetLength;
 }
 
 /*
 ====================
-ServerHandleClientQuit
+OpenDataSocket
 
-Handles when a client quits the game.
+Opens the UDP data socket on the given port (0 for any port) together with the
+datagram buffer and resets the sequence numbers.
 ====================
 */
-static void ServerHandleClientQuit( int playerId ) {
-	// Remove the player from the list and ask all other clients to do the same.
-	RemovePlayer( playerId );
-	int packet[3];
-	SDLNet_Write32( ( int )PID_QUIT,	&packet[0] );
-	SDLNet_Write32( 12,					&packet[1] );
-	SDLNet_Write32( playerId,			&packet[2] );
-	BroadcastPacketToClients( packet, sizeof( packet ) );
+static int OpenDataSocket( uint16_t localPort ) {
+	CloseDataSocket();
+
+	network->dataSocket = OpenDatagramSocket( localPort );
+	DebugAssert( network->dataSocket != NO_DATAGRAM_SOCKET );
+	if( network->dataSocket == NO_DATAGRAM_SOCKET ) {
+		return ERROR_UDP_SOCKET_CREATION_FAILED;
+	}
+	network->dataPacket = SDLNet_AllocPacket( MAX_DATAGRAM_LENGTH );
+	OpenLink( &network->link, localPort );
+	network->dataSequence = 0;
+	network->lastDataSequence = 0;
+	network->snapshotSequence = 0;
+	memset( &network->snapshotHistory, 0, sizeof( network->snapshotHistory ) );
+	network->commandSequence = 0;
+	network->sentCommand = 0;
+	network->ackedCommand = 0;
+	network->lastUpdateTime = SDL_GetTicks();
+
+	return 0;
 }
 
 /*
 ====================
-ServerHandleClientMyName
+CloseDataSocket
 
-Handles when a client announces a new name. Adds the name to the client list and
-broadcasts the packet to all other clients.
+Closes the UDP data socket if it is open.
 ====================
 */
-static void ServerHandleClientMyName( int playerId, char *name ) {
-	clients[playerId].alias = name;
-	char *packet = malloc( 12 + strlen( name ) );
-	SDLNet_Write32( ( int )PID_JOIN,		&packet[0] );
-	SDLNet_Write32( 12 + strlen( name ),	&packet[4] );
-	SDLNet_Write32( playerId,				&packet[8] );
-	strncpy( &packet[12], name, strlen( name ) );
-	BroadcastPacketToClients( packet, 12 + strlen( name ) );
-	free( packet );
+static void CloseDataSocket( void ) {
+	if( network->dataSocket != NO_DATAGRAM_SOCKET ) {
+		RemoveReactorSocket( &network->reactor, REACTOR_SOCKET( network->dataSocket ) );
+		CloseDatagramSocket( network->dataSocket );
+		network->dataSocket = NO_DATAGRAM_SOCKET;
+		CloseLink( &network->link );
+	}
+	if( network->dataPacket ) {
+		SDLNet_FreePacket( network->dataPacket );
+		network->dataPacket = NULL;
+	}
+}
+
+/*
+====================
+SendDatagram
+
+Sends a datagram with the given arguments to address. sequence counts the datagrams
+sent to that peer, so that it sees no gaps unless datagrams get lost.
+====================
+*/
+static int SendDatagram( const IPaddress *address, uint32_t *sequence, int packetId, const char *args, int argsLength ) {
+	return SendDatagramWithPayload( address, sequence, packetId, args, argsLength, NULL );
+}
+
+/*
+====================
+SendDatagramWithPayload
+
+Like SendDatagram, but the arguments are followed by the bytes of a shared packet buffer, which may be NULL.
+====================
+*/
+static int SendDatagramWithPayload( const IPaddress *address, uint32_t *sequence, int packetId, const char *args, int argsLength, const struct PacketBuffer *payload ) {
+	int payloadLength = payload ? payload->length : 0;
+	int length = DATAGRAM_HEADER_LENGTH + argsLength + payloadLength;
+
+	DebugAssert( length <= MAX_DATAGRAM_LENGTH );
+	if( network->dataSocket == NO_DATAGRAM_SOCKET || length > MAX_DATAGRAM_LENGTH ) {
+		return -1;
+	}
+
+	SDLNet_Write32( packetId,			&network->dataPacket->data[0] );
+	SDLNet_Write32( length,				&network->dataPacket->data[4] );
+	SDLNet_Write32( ++*sequence,		&network->dataPacket->data[8] );
+	memcpy( &network->dataPacket->data[DATAGRAM_HEADER_LENGTH], args, argsLength );
+	if( payload ) {
+		memcpy( &network->dataPacket->data[DATAGRAM_HEADER_LENGTH + argsLength], payload->bytes, payloadLength );
+	}
+	network->dataPacket->len = length;
+	network->dataPacket->address = *address;
+
+	return LinkSend( &network->link, network->dataSocket, network->dataPacket ) ? 0 : -1;
+}
+
+/*
+====================
+ReceiveDatagram
+
+Receives the next datagram from the data socket without blocking. On success,
+returns its packet ID and points args at its arguments. The sender's address
+stays available in dataPacket. Returns -1 if nothing valid is left to read.
+====================
+*/
+static int ReceiveDatagram( const char **args, int *argsLength, uint32_t *sequence ) {
+	int length;
+
+	while( network->dataSocket != NO_DATAGRAM_SOCKET && LinkReceive( &network->link, network->dataSocket, network->dataPacket ) > 0 ) {
+		// Skip anything that doesn't even hold its own header.
+		length = network->dataPacket->len;
+		if( length < DATAGRAM_HEADER_LENGTH || ( int )SDLNet_Read32( &network->dataPacket->data[4] ) != length ) {
+			continue;
+		}
+
+		*sequence = SDLNet_Read32( &network->dataPacket->data[8] );
+		*args = ( const char * )&network->dataPacket->data[DATAGRAM_HEADER_LENGTH];
+		*argsLength = length - DATAGRAM_HEADER_LENGTH;
+		return SDLNet_Read32( &network->dataPacket->data[0] );
+	}
+
+	return -1;
+}
+
+/*
+====================
+IsNewerSequence
+
+Returns 1 if sequence has been sent after lastSequence, also when the counter wraps around.
+====================
+*/
+static int IsNewerSequence( uint32_t sequence, uint32_t lastSequence ) {
+	return ( int32_t )( sequence - lastSequence ) > 0;
+}
+
+/*
+====================
+ResetTelemetry
+
+Forgets all measurements of a peer, e.g. when a new game starts. sequence is the
+newest sequence number received from the peer so far.
+====================
+*/
+static void ResetTelemetry( struct Telemetry *telemetry, uint32_t sequence ) {
+	unsigned int now = SDL_GetTicks();
+
+	memset( telemetry, 0, sizeof( *telemetry ) );
+	telemetry->stats.sendQueue = -1;
+	telemetry->nextPing = now;
+	telemetry->windowStart = now;
+	telemetry->firstSequence = sequence;
+}
+
+/*
+====================
+SendTelemetryPacket
+
+Sends a PID_PING or PID_PONG with the given time on the control socket.
+====================
+*/
+static void SendTelemetryPacket( streamSocket_t socket, struct Telemetry *telemetry, int packetId, uint32_t time ) {
+	char packet[12];
+
+	SDLNet_Write32( packetId,			&packet[0] );
+	SDLNet_Write32( sizeof( packet ),	&packet[4] );
+	SDLNet_Write32( time,				&packet[8] );
+	SendStream( socket, packet, sizeof( packet ) );
+	telemetry->bytesSent += sizeof( packet );
+}
+
+/*
+====================
+HandlePong
+
+Takes the round trip time of a ping into the smoothed averages, like TCP does (RFC 6298).
+====================
+*/
+static void HandlePong( struct Telemetry *telemetry, uint32_t time ) {
+	float sample = ( float )( int32_t )( SDL_GetTicks() - time );
+
+	if( sample < 0.0f ) {
+		return;
+	}
+	if( !telemetry->hasRtt ) {
+		telemetry->stats.rtt = sample;
+		telemetry->stats.jitter = sample / 2.0f;
+		telemetry->hasRtt = 1;
+		return;
+	}
+	telemetry->stats.jitter += ( fabsf( telemetry->stats.rtt - sample ) - telemetry->stats.jitter ) / 4.0f;
+	telemetry->stats.rtt += ( sample - telemetry->stats.rtt ) / 8.0f;
+}
+
+/*
+====================
+UpdateTelemetry
+
+Sends a ping to the peer when one is due and closes the current window when it is
+over. sequence is the newest sequence number received from the peer, player its
+index or -1 for the server.
+====================
+*/
+static void UpdateTelemetry( struct Telemetry *telemetry, streamSocket_t socket, uint32_t sequence, int player ) {
+	unsigned int	now = SDL_GetTicks();
+	unsigned int	elapsed = now - telemetry->windowStart;
+	uint32_t		expected = sequence - telemetry->firstSequence;
+
+	if( ( int )( now - telemetry->nextPing ) >= 0 ) {
+		SendTelemetryPacket( socket, telemetry, PID_PING, now );
+		telemetry->nextPing = now + PING_INTERVAL;
+	}
+	if( elapsed < TELEMETRY_WINDOW ) {
+		return;
+	}
+
+	telemetry->stats.sendRate = telemetry->bytesSent * 1000.0f / elapsed;
+	telemetry->stats.receiveRate = telemetry->bytesReceived * 1000.0f / elapsed;
+	telemetry->stats.loss = expected && telemetry->datagrams < expected ? 1.0f - ( float )telemetry->datagrams / expected : 0.0f;
+	telemetry->stats.sendQueue = GetSendQueueLength( socket );
+	if( player >= 0 ) {
+		DebugPrintF( "Client #%d: rtt %.1f ms, jitter %.1f ms, loss %.1f%%, %.0f B/s out, %.0f B/s in, %d bytes queued.", player,
+			telemetry->stats.rtt, telemetry->stats.jitter, telemetry->stats.loss * 100.0f, telemetry->stats.sendRate, telemetry->stats.receiveRate, telemetry->stats.sendQueue );
+	} else {
+		DebugPrintF( "Server: rtt %.1f ms, jitter %.1f ms, loss %.1f%%, %.0f B/s out, %.0f B/s in, %d bytes queued.",
+			telemetry->stats.rtt, telemetry->stats.jitter, telemetry->stats.loss * 100.0f, telemetry->stats.sendRate, telemetry->stats.receiveRate, telemetry->stats.sendQueue );
+	}
+
+	telemetry->windowStart = now;
+	telemetry->bytesSent = 0;
+	telemetry->bytesReceived = 0;
+	telemetry->datagrams = 0;
+	telemetry->firstSequence = sequence;
+}
+
+/*
+====================
+PublishToSpectators
+
+Appends complete packets to the feed of the match if a game is published there.
+====================
+*/
+static void PublishToSpectators( const void *data, int length, int isKeyframe ) {
+	if( network->feed && network->isFeedLive ) {
+		PublishFeed( network->feed, data, length, isKeyframe );
+	}
+}
+
+/*
+====================
+ServerAcceptClients
+
+Accepts new clients on the activeSocket.
+====================
+*/
+static int ServerAcceptClients( void ) {
+	// Accept new clients!
+	IPaddress		address;
+	streamSocket_t	newClient = AcceptStream( network->activeSocket, &address );
+
+	if( newClient != NO_STREAM_SOCKET ) {
+		DebugPrintF( "A new client has connected." );
+		struct NetworkClientInfo clientInfo;
+		memset( &clientInfo, 0, sizeof( clientInfo ) );
+		clientInfo.alias = NULL;
+		clientInfo.socket = newClient;
+		clientInfo.address = address;
+		AddReactorSocket( &network->reactor, REACTOR_SOCKET( newClient ) );
+		// Tell client about the rest of the world.
+		IssueAllJoins( newClient );
+		int newId = AddPlayer( clientInfo );
+		int packet[3];
+		SDLNet_Write32( ( int )PID_YOUR_ID,	&packet[0] );
+		SDLNet_Write32( 12,					&packet[1] );
+		SDLNet_Write32( newId,				&packet[2] );
+		SendStream( network->clients[newId].socket, packet, sizeof( packet ) );
+	}
+	return 0;
+}
+
+/*
+====================
+ServerPollSockets
+
+Waits up to timeout milliseconds for sockets to become readable and hands the readable
+ones to their handlers: new connections get accepted, datagrams get applied to state and
+control sockets are read into their client's receive buffer. Control sockets whose
+receive buffer is full aren't waited on until it has room again. Returns the amount of
+readable sockets.
+====================
+*/
+static int ServerPollSockets( struct GameState *state, unsigned int timeout ) {
+	reactorSocket_t			ready[REACTOR_MAX_SOCKETS];
+	int						numReady;
+	int						index;
+	int						client;
+
+	// A full receive buffer can't take what is readable, so that socket would wake us up over and over.
+	for( client = 0; client < network->numClients; client++ ) {
+		if( network->clients[client].socket != NO_STREAM_SOCKET ) {
+			WatchReactorSocket( &network->reactor, REACTOR_SOCKET( network->clients[client].socket ), network->clients[client].recvBuffer.length < RECV_BUFFER_SIZE );
+		}
+	}
+
+	numReady = WaitReactor( &network->reactor, timeout, ready, REACTOR_MAX_SOCKETS );
+	for( index = 0; index < numReady; index++ ) {
+		if( ready[index] == REACTOR_SOCKET( network->activeSocket ) ) {
+			ServerAcceptClients();
+			continue;
+		}
+		if( ready[index] == REACTOR_SOCKET( network->dataSocket ) ) {
+			if( state ) {
+				ServerUpdateClientGeometry( state );
+			}
+			continue;
+		}
+
+		for( client = 0; client < network->numClients; client++ ) {
+			if( network->clients[client].socket != NO_STREAM_SOCKET && ready[index] == REACTOR_SOCKET( network->clients[client].socket ) ) {
+				break;
+			}
+		}
+		if( client == network->numClients ) {
+			continue;
+		}
+		// A closed connection stays readable forever, so we stop listening to it.
+		if( FillRecvBuffer( network->clients[client].socket, &network->clients[client].recvBuffer ) == -1 ) {
+			ServerHandleLostClient( client, "lost its connection" );
+		}
+	}
+
+	return numReady;
+}
+
+/*
+====================
+WaitForNetwork
+
+For use by the server only, blocks for timeout milliseconds and handles
+everything that arrives in the meantime as soon as it arrives.
+====================
+*/
+void WaitForNetwork( struct GameState *state, unsigned int timeout ) {
+	unsigned int	deadline = SDL_GetTicks() + timeout;
+	unsigned int	now;
+
+	if( !network->isServer || !network->isConnected ) {
+		SDL_Delay( timeout );
+		return;
+	}
+
+	while( ( int )( deadline - ( now = SDL_GetTicks() ) ) > 0 ) {
+		if( ServerPollSockets( state, deadline - now ) == -1 ) {
+			SDL_Delay( deadline - now );
+			return;
+		}
+	}
+}
+
+/*
+====================
+ServerProcessLobbyIncomingPackets
+
+Given a client ID and a packet buffer, reads all the packets and takes action according to their contents.
+====================
+*/
+static int ServerProcessLobbyIncomingPackets( int client, char *bytes, int numBytes ) {
+	int bReadPosition = 0;
+	int endOfStream = 0;
+	int stringLength;
+	char *name;
+
+	while( !endOfStream ) {
+		switch( SDLNet_Read32( &bytes[bReadPosition] ) ) {
+			case PID_QUIT:
+				// Handle the quit
+				ServerHandleClientQuit( client );
+				break;
+			case PID_MY_NAME:
+				// Determine length of name and call handler with the length.
+				stringLength = SDLNet_Read32( &bytes[bReadPosition + 4] ) - 8;
+				name = malloc( stringLength + 1 );
+				strncpy( name, &bytes[bReadPosition + 8], stringLength );
+				name[stringLength] = '\0';
+				DebugPrintF( "Client #%d is now called %s.", client, name );
+				ServerHandleClientMyName( client, name );
+				//return 10;
+				break;
+		}
+		bReadPosition += SDLNet_Read32( &bytes[bReadPosition + 4] );
+		if( bReadPosition >= numBytes ) {
+			endOfStream = 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+====================
+ServerProcessLobby
+
+Accepts incoming connections, receives information packets from clients and
+informs all clients about the new client.
+====================
+*/
+static int ServerProcessLobby( void ) {
+	// Accept new clients and receive from those which sent something.
+	ServerPollSockets( NULL, 0 );
+
+	// Process other clients' packets!
+	int numBytes;
+	char bytes[1024];
+	int client;
+
+	// Go through the clients
+	for( client = 0; client < network->numClients; client++ ) {
+		// If there is a socket (so, not this client)
+		if( network->clients[client].socket == NO_STREAM_SOCKET ) {
+			continue;
+		}
+		// while there is something left in the receive buffer, process the packets.
+		while( 1 ) {
+			numBytes = PopPackets( &network->clients[client].recvBuffer, bytes, sizeof( bytes ) );
+			if( numBytes == -1 && ServerHandleLostClient( client, "sent a packet we can't read" ) ) {
+				// The next client moved into this slot.
+				client--;
+			}
+			if( numBytes <= 0 ) {
+				break;
+			}
+			DebugPrintF( "Received %d bytes.", numBytes );
+			ServerProcessLobbyIncomingPackets( client, bytes, numBytes );
+		}
+	}
+
+	return 0;
+}
+
+/*
+====================
+ServerHandleClientQuit
+
+Handles when a client quits the game.
+====================
+*/
+static void ServerHandleClientQuit( int playerId ) {
+	// Remove the player from the list and ask all other clients to do the same.
+	RemovePlayer( playerId );
+	int packet[3];
+	SDLNet_Write32( ( int )PID_QUIT,	&packet[0] );
+	SDLNet_Write32( 12,					&packet[1] );
+	SDLNet_Write32( playerId,			&packet[2] );
+	BroadcastPacketToClients( packet, sizeof( packet ) );
+}
+
+/*
+====================
+ServerHandleClientMyName
+
+Handles when a client announces a new name. Adds the name to the client list and
+broadcasts the packet to all other clients.
+====================
+*/
+static void ServerHandleClientMyName( int playerId, char *name ) {
+	network->clients[playerId].alias = name;
+	char *packet = malloc( 12 + strlen( name ) );
+	SDLNet_Write32( ( int )PID_JOIN,		&packet[0] );
+	SDLNet_Write32( 12 + strlen( name ),	&packet[4] );
+	SDLNet_Write32( playerId,				&packet[8] );
+	strncpy( &packet[12], name, strlen( name ) );
+	BroadcastPacketToClients( packet, 12 + strlen( name ) );
+	free( packet );
 }
 
 /*
@@ -524,23 +1331,23 @@ IssueAllJoins
 Sends all joins from the beginning of the client list to a specified TCP socket.
 ====================
 */
-void IssueAllJoins( TCPsocket socket ) {
+void IssueAllJoins( streamSocket_t socket ) {
 	int client;
 	char *packet;
-	for( client = 0; client < numClients; client++ ) {
+	for( client = 0; client < network->numClients; client++ ) {
 		int packetSize = 12;
 		packet = malloc( packetSize );
-		if( clients[client].alias ) {
+		if( network->clients[client].alias ) {
 			free( packet );
-			packetSize += strlen( clients[client].alias );
+			packetSize += strlen( network->clients[client].alias );
 			packet = malloc( packetSize );
-			strncpy( &packet[12], clients[client].alias, packetSize - 12 );
+			strncpy( &packet[12], network->clients[client].alias, packetSize - 12 );
 		}
 		SDLNet_Write32( ( int )PID_JOIN,	&packet[0] );
 		SDLNet_Write32( packetSize,			&packet[4] );
 		SDLNet_Write32( client,				&packet[8] );
 
-		SDLNet_TCP_Send( socket, packet, packetSize );
+		SendStream( socket, packet, packetSize );
 
 		free( packet );
 	}
@@ -556,9 +1363,10 @@ Takes a packet and broadcasts it to all connected clients (server only)
 static int BroadcastPacketToClients( const void *data, int length ) {
 	int client;
 	DebugPrintF( "Broadcasting a %d packet.", SDLNet_Read32( data ) );
-	for( client = 0; client < numClients; client++ ) {
-		if( clients[client].socket ) {
-			SDLNet_TCP_Send( clients[client].socket, data, length );
+	for( client = 0; client < network->numClients; client++ ) {
+		if( network->clients[client].socket != NO_STREAM_SOCKET ) {
+			SendStream( network->clients[client].socket, data, length );
+			network->clients[client].telemetry.bytesSent += length;
 		}
 	}
 	return 0;
@@ -597,8 +1405,8 @@ static int ClientProcessLobbyIncomingPackets( char *bytes, int numBytes ) {
 				ClientHandleServerYourId( newId );
 				break;
 			case PID_START_GAME:
-				DebugPrintF( "The game starts now on port." );
-				ClientHandleServerStartGame();
+				DebugPrintF( "The game starts now on port %d.", SDLNet_Read32( &bytes[bReadPosition + 8] ) );
+				ClientHandleServerStartGame( SDLNet_Read32( &bytes[bReadPosition + 8] ) );
 				return GAME_START;
 				break;
 		}
@@ -623,12 +1431,22 @@ static int ClientProcessLobby( void ) {
 	char	bytes[1024];
 	int		numBytes;
 
-	while( 1 ) {
-		numBytes = NonBlockingRecv( activeSocket, activeSocketSet, bytes, sizeof( bytes ) );
-		if( numBytes <= 0 ) {
+	if( FillRecvBuffer( network->activeSocket, &network->activeRecvBuffer ) == -1 ) {
+		DebugPrintF( "Lost the connection to the server." );
+		Disconnect();
+		return -1;
+	}
+
+	// Go packet by packet, everything after the start of the game has to stay in the buffer.
+	while( ( numBytes = PopPacket( &network->activeRecvBuffer, bytes, sizeof( bytes ) ) ) > 0 ) {
+		if( ClientProcessLobbyIncomingPackets( bytes, numBytes ) == GAME_START ) {
 			break;
 		}
-		ClientProcessLobbyIncomingPackets( bytes, numBytes );
+	}
+	if( numBytes == -1 ) {
+		DebugPrintF( "The server sent a packet we can't read." );
+		Disconnect();
+		return -1;
 	}
 
 	return 0;
@@ -642,10 +1460,14 @@ Handles when another client joins the game
 ====================
 */
 static void ClientHandleClientJoin( int playerId, char *name ) {
-	if( numClients <= playerId ) {
-		numClients = playerId + 1;
+	if( playerId < 0 || playerId >= MAX_PLAYERS ) {
+		DebugPrintF( "Ignoring player ID %d, which is out of range.", playerId );
+		return;
+	}
+	if( network->numClients <= playerId ) {
+		network->numClients = playerId + 1;
 	}
-	clients[playerId].alias = name;
+	network->clients[playerId].alias = name;
 }
 
 /*
@@ -656,7 +1478,7 @@ Handles when a server tells this client its ID.
 ====================
 */
 static void ClientHandleServerYourId( int newId ) {
-	thisClient = newId;
+	network->thisClient = newId;
 	char *packet;
 	char *alias = malloc( MAX_PLAYER_NAME_LENGTH );
 	GetUserName( alias );
@@ -664,7 +1486,9 @@ static void ClientHandleServerYourId( int newId ) {
 	SDLNet_Write32( ( int )PID_MY_NAME,		&packet[0] );
 	SDLNet_Write32( 8 + strlen( alias ),	&packet[4] );
 	strncpy( packet + 8, alias, strlen( alias ) );
-	SDLNet_TCP_Send( activeSocket, packet, 8 + strlen( alias ) );
+	SendStream( network->activeSocket, packet, 8 + strlen( alias ) );
+	free( packet );
+	free( alias );
 	DebugPrintF( "I gave the server my name." );
 }
 
@@ -672,19 +1496,33 @@ static void ClientHandleServerYourId( int newId ) {
 ====================
 ClientHandleServerStartGame
 
-Handles when the server starts the game.
+Handles when the server starts the game. Opens the data socket and announces its
+address to the server.
 ====================
 */
-static void ClientHandleServerStartGame() {
-	IPaddress *address = SDLNet_TCP_GetPeerAddress( activeSocket );
-	DebugAssert( address );
+static void ClientHandleServerStartGame( uint16_t udpPort ) {
+	ResetJitterBuffer( &network->jitterBuffer );
+	memset( &network->snapshotStats, 0, sizeof( network->snapshotStats ) );
+	ResetTelemetry( &network->serverTelemetry, 0 );
+
+	// Spectators get their snapshots on the active socket, see PID_FEED_SNAPSHOT.
+	if( network->isSpectator ) {
+		network->snapshotSequence = 0;
+		memset( &network->snapshotHistory, 0, sizeof( network->snapshotHistory ) );
+		network->lastUpdateTime = SDL_GetTicks();
+		clientGameStarted = 1;
+		return;
+	}
 
-	SDLNet_Write16( NETWORK_STANDARD_DATA_PORT, &address->port );
-	ConnectRemoteServerIp( &dataSocket, &dataSocketSet, address );
+	network->serverDataAddress = network->serverAddress;
+	SDLNet_Write16( udpPort, &network->serverDataAddress.port );
+	if( OpenDataSocket( 0 ) ) {
+		return;
+	}
 
 	char number[4];
-	SDLNet_Write32( thisClient, number );
-	SDLNet_TCP_Send( dataSocket, number, 4 );
+	SDLNet_Write32( network->thisClient, number );
+	SendDatagram( &network->serverDataAddress, &network->dataSequence, PID_DATA_HELLO, number, sizeof( number ) );
 
 	clientGameStarted = 1;
 }
@@ -697,84 +1535,173 @@ Adds a NetworkClientInfo to the clients array.
 ====================
 */
 static int AddPlayer( struct NetworkClientInfo client ) {
-	int newIndex = numClients;
-	if( numClients == 6 ) {
+	int newIndex = network->numClients;
+	if( network->numClients == MAX_PLAYERS ) {
 		return -1;
 	}
 
-	DebugPrintF( "Adding Player %s.", client.alias );
+	DebugPrintF( "Adding Player %s.", client.alias );
+
+	if( network->numClients == -1 ) {
+		network->numClients = 0;
+	}
+	network->clients[network->numClients++] = client;
+	return newIndex;
+}
+
+/*
+====================
+RemovePlayer
+
+Removes a player from the clients array.
+====================
+*/
+static void RemovePlayer( int playerId ) {
+	int n;
+	if( network->clients[playerId].socket != NO_STREAM_SOCKET ) {
+		RemoveReactorSocket( &network->reactor, REACTOR_SOCKET( network->clients[playerId].socket ) );
+		CloseStream( network->clients[playerId].socket );
+	}
+	for( n = playerId; n < network->numClients - 1; n++ ) {
+		network->clients[n] = network->clients[n + 1];
+	}
+	network->numClients--;
+}
+
+/*
+====================
+GetPlayerList
+
+Returns a list of player names into players.
+====================
+*/
+int GetPlayerList( playerInfo_t *players, int *numPlayers ) {
+	*numPlayers = network->numClients;
+	if( !players ) {
+		return -1;
+	}
+
+	int client;
+	for( client = 0; client < network->numClients; client++ ) {
+		players[client] = network->clients[client].alias;
+	}
+	return 0;
+}
+
+/*
+====================
+ServerCheckDeadlines
+
+Drops every client that hasn't sent a datagram in time, see enum ConnectionState.
+====================
+*/
+static void ServerCheckDeadlines( void ) {
+	unsigned int	now = SDL_GetTicks();
+	int				client;
+
+	for( client = 0; client < network->numClients; client++ ) {
+		if( network->clients[client].connectionState != CS_AWAITING_DATA && network->clients[client].connectionState != CS_IN_GAME ) {
+			continue;
+		}
+		if( network->clients[client].isSimulated ) {
+			continue;
+		}
+		if( ( int )( now - network->clients[client].deadline ) >= 0 ) {
+			ServerDropClient( client, network->clients[client].connectionState == CS_AWAITING_DATA ? "never connected its data socket" : "fell silent" );
+		}
+	}
+}
+
+/*
+====================
+ServerDropClient
+
+Closes the control socket of an in-game client and stops listening to it. The client keeps its seat.
+====================
+*/
+static void ServerDropClient( int client, const char *reason ) {
+	DebugPrintF( "Dropping client #%d, it %s.", client, reason );
 
-	if( numClients == -1 ) {
-		numClients = 0;
+	if( network->clients[client].socket != NO_STREAM_SOCKET ) {
+		RemoveReactorSocket( &network->reactor, REACTOR_SOCKET( network->clients[client].socket ) );
+		CloseStream( network->clients[client].socket );
+		network->clients[client].socket = NO_STREAM_SOCKET;
 	}
-	clients[numClients++] = client;
-	return newIndex;
+	network->clients[client].connectionState = CS_DROPPED;
 }
 
 /*
 ====================
-RemovePlayer
+ServerHandleLostClient
 
-Removes a player from the clients array.
+Gives up on a client whose control connection can't go on. A client in the lobby quits,
+later ones are dropped so that the game keeps its players. Returns 1 if the client was
+removed from the clients array and 0 otherwise.
 ====================
 */
-static void RemovePlayer( int playerId ) {
-	int n;
-	for( n = playerId; n < numClients - 1; n++ ) {
-		clients[n] = clients[n + 1];
+static int ServerHandleLostClient( int client, const char *reason ) {
+	if( network->clients[client].connectionState != CS_LOBBY ) {
+		ServerDropClient( client, reason );
+		return 0;
 	}
-	numClients--;
+
+	DebugPrintF( "Client #%d %s, it leaves the lobby.", client, reason );
+	ServerHandleClientQuit( client );
+	return 1;
 }
 
 /*
 ====================
-GetPlayerList
+RegisterDataAddress
 
-Returns a list of player names into players.
+Given the arguments of a datagram that starts with a player ID, remembers the address
+the datagram came from as that player's data address if it is not yet known.
+Returns the player ID if a new address was registered, -1 otherwise.
 ====================
 */
-int GetPlayerList( playerInfo_t *players, int *numPlayers ) {
-	*numPlayers = numClients;
-	if( !players ) {
+static int RegisterDataAddress( const char *args, int argsLength ) {
+	int clientNumber;
+
+	if( argsLength < 4 ) {
+		return -1;
+	}
+	clientNumber = SDLNet_Read32( &args[0] );
+	if( clientNumber < 0 || clientNumber >= network->numClients || network->clients[clientNumber].socket == NO_STREAM_SOCKET || network->clients[clientNumber].connectionState != CS_AWAITING_DATA ) {
 		return -1;
 	}
 
-	int client;
-	for( client = 0; client < numClients; client++ ) {
-		players[client] = clients[client].alias;
+	// Only believe datagrams that come from the same host as the client's TCP connection.
+	if( network->clients[clientNumber].address.host != network->dataPacket->address.host ) {
+		return -1;
 	}
-	return 0;
+
+	network->clients[clientNumber].dataAddress = network->dataPacket->address;
+	network->clients[clientNumber].connectionState = CS_IN_GAME;
+	network->clients[clientNumber].deadline = SDL_GetTicks() + SILENCE_TIMEOUT;
+	network->clients[clientNumber].lastDataSequence = 0;
+	network->clients[clientNumber].dataSequence = 0;
+	network->clients[clientNumber].ackedSnapshot = 0;
+	network->clients[clientNumber].lastCommand = 0;
+	network->clients[clientNumber].commandBudget = 0.0f;
+	memset( &network->clients[clientNumber].snapshotHistory, 0, sizeof( struct SnapshotHistory ) );
+	return clientNumber;
 }
 
 /*
 ====================
-AcceptAllDataClients
+SetNetworkRates
 
-Accepts all clients for the data port now. Waits until we have all clients.
+Tells the server how often per second ProcessInGame is called and how many snapshots per
+second it should send. The snapshot rate can't be higher than the tick rate.
 ====================
 */
-static int AcceptAllDataClients( void ) {
-	int			dataClients = 1;
-	char		nBuffer[4];
-	int			clientNumber;
-
-	while( dataClients < numClients ) {
-		TCPsocket newClient = NULL;
-		newClient = SDLNet_TCP_Accept( dataSocket );
-
-		if( newClient ) {
-			SDLNet_TCP_Recv( newClient, nBuffer, 4 );
-			clientNumber = SDLNet_Read32( nBuffer );
-
-			clients[clientNumber].dataSocketSet = SDLNet_AllocSocketSet( 1 );
-			clients[clientNumber].dataSocket = newClient;
-			DebugPrintF( "Client %d has connected the data socket.", clientNumber );
-			SDLNet_TCP_AddSocket( clients[clientNumber].dataSocketSet, newClient );
-			dataClients++;
-		}
-	}
+void SetNetworkRates( int newTickRate, int newSnapshotRate ) {
+	DebugAssert( newTickRate > 0 && newSnapshotRate > 0 );
 
-	return 0;
+	network->tickRate = newTickRate;
+	network->snapshotRate = newSnapshotRate < newTickRate ? newSnapshotRate : newTickRate;
+	// Send the first snapshot right away.
+	network->snapshotCredit = network->tickRate - network->snapshotRate;
 }
 
 /*
@@ -785,11 +1712,18 @@ For use by the server only, broadcasts the packet that starts the game.
 ====================
 */
 int NetworkStartGame( uint16_t udpPort ) {
-	if( !isServer ) {
+	int client;
+
+	if( !network->isServer ) {
 		return -1;
 	}
 	// Prepare data socket
-	ConnectLocalServer( &dataSocket, NETWORK_STANDARD_DATA_PORT );
+	if( OpenDataSocket( udpPort ) ) {
+		return -1;
+	}
+	AddReactorSocket( &network->reactor, REACTOR_SOCKET( network->dataSocket ) );
+	// Nobody can join a running game.
+	RemoveReactorSocket( &network->reactor, REACTOR_SOCKET( network->activeSocket ) );
 
 	// Broadcast connection info
 	char packet[12];
@@ -797,129 +1731,213 @@ int NetworkStartGame( uint16_t udpPort ) {
 	SDLNet_Write32( sizeof( packet ),		&packet[4] );
 	SDLNet_Write32( udpPort,				&packet[8] );
 	BroadcastPacketToClients( packet, 12 );
+	ServerPublishPreamble();
 
-	// Register the broadcast functions with the physics component so hits and misses get sent to the other clients.
-	AtRegisterHit( &ServerInGameSendHit );
-	AtRegisterPoint( &ServerInGameSendScore );
-	AtRegisterQuit( &ServerInGameSendQuit );
-
-	AcceptAllDataClients();
+	// The clients now have to connect their data sockets, while the game goes on.
+	for( client = 0; client < network->numClients; client++ ) {
+		if( network->clients[client].socket == NO_STREAM_SOCKET ) {
+			continue;
+		}
+		network->clients[client].connectionState = CS_AWAITING_DATA;
+		network->clients[client].deadline = SDL_GetTicks() + HANDSHAKE_TIMEOUT;
+		ResetTelemetry( &network->clients[client].telemetry, 0 );
+	}
 
 	return 0;
 }
 
 /*
 ====================
-DeserializeGameStateGeometry
+ServerPublishPreamble
 
-Given a buffer containing a serialized GameState, writes the information from the buffer to the state.
+Starts publishing a new game to the feed. Its preamble holds what a player would
+have learned in the lobby: a join for every player and the start of the game.
 ====================
 */
-static void DeserializeGameStateGeometry( struct GameState *state, const char *buffer, int bufferLength ) {
-	DebugAssert( state );
-
-	// This is some really nice code. Need this in order to not break aliasing rules. Hell yeah.
-	union IntFloat *modifier;
-
-	// Read the ball position
-	modifier = ( union IntFloat * )&state->ball.position.x;
-	modifier->i = SDLNet_Read32( &buffer[0] );
-	modifier = ( union IntFloat * )&state->ball.position.y;
-	modifier->i = SDLNet_Read32( &buffer[4] );
-
-	// Read the ball direction
-	modifier = ( union IntFloat * )&state->ball.direction.dx;
-	modifier->i = SDLNet_Read32( &buffer[8] );
-	modifier = ( union IntFloat * )&state->ball.direction.dy;
-	modifier->i = SDLNet_Read32( &buffer[12] );
+static void ServerPublishPreamble( void ) {
+	char	preamble[FEED_PREAMBLE_SIZE];
+	int		length = 0;
+	int		nameLength;
+	int		client;
 
-	// Read the players' paddle positions.
-	int numPlayers = ( bufferLength - 16 ) / 4;
-	int player;
-	for( player = 0; player < numPlayers; player++ ) {
-		modifier = ( union IntFloat * )&state->players[player].position;
-		modifier->i = SDLNet_Read32( &buffer[16 + 4 * player] );
+	if( !network->feed ) {
+		return;
 	}
 
-	return;
+	for( client = 0; client < network->numClients; client++ ) {
+		nameLength = network->clients[client].alias ? strlen( network->clients[client].alias ) : 0;
+		if( nameLength > MAX_PLAYER_NAME_LENGTH ) {
+			nameLength = MAX_PLAYER_NAME_LENGTH;
+		}
+		SDLNet_Write32( ( int )PID_JOIN,	&preamble[length] );
+		SDLNet_Write32( 12 + nameLength,	&preamble[length + 4] );
+		SDLNet_Write32( client,				&preamble[length + 8] );
+		memcpy( &preamble[length + 12], network->clients[client].alias, nameLength );
+		length += 12 + nameLength;
+	}
+	// Spectators don't open a data socket, so they need no port.
+	SDLNet_Write32( ( int )PID_START_GAME,	&preamble[length] );
+	SDLNet_Write32( 12,						&preamble[length + 4] );
+	SDLNet_Write32( 0,						&preamble[length + 8] );
+	length += 12;
+
+	SetFeedPreamble( network->feed, preamble, length );
+	network->isFeedLive = 1;
+	network->feedCountdown = 0;
 }
 
 /*
 ====================
-SerializeGameStateGeometry
+ServerPublishSnapshot
 
-Given a GameState, serializes it and writes the result into the buffer.
+Encodes a snapshot once for all spectators of the match, no matter how many there
+are, and publishes it to the feed. Every FEED_KEYFRAME_INTERVAL snapshots it is a
+keyframe, where viewers can start watching.
 ====================
 */
-static void SerializeGameStateGeometry( const struct GameState *state, char **buffer, int *bufferLength ) {
-	DebugAssert( buffer );
-
-	union IntFloat *modifier;
-
-	// Calculate the needed buffer length.
-	int neededLength = 16 + 4 * state->numPlayers;
+static void ServerPublishSnapshot( const struct GameState *state, const struct Snapshot *snapshot ) {
+	char	packet[12 + 4 * MAX_PLAYERS + MAX_SNAPSHOT_LENGTH];
+	int		isKeyframe = network->feedCountdown <= 0;
+	int		length;
+	int		encodedLength;
+	int		player;
 
-	// Pointer null checks.
-	if( bufferLength ) {
-		*bufferLength = neededLength;
-	}
-	if( !buffer ) {
+	if( !network->feed || !network->isFeedLive ) {
 		return;
 	}
 
-	// Allocate the buffer.
-	*buffer = malloc( neededLength );
-
-	// Write the ball position.
-	modifier = ( union IntFloat * )&state->ball.position.x;
-	SDLNet_Write32( modifier->i,	&( *buffer )[0] );
-	modifier = ( union IntFloat * )&state->ball.position.y;
-	SDLNet_Write32( modifier->i,	&( *buffer )[4] );
-
-	// Write the ball direction.
-	modifier = ( union IntFloat * )&state->ball.direction.dx;
-	SDLNet_Write32( modifier->i,	&( *buffer )[8] );
-	modifier = ( union IntFloat * )&state->ball.direction.dy;
-	SDLNet_Write32( modifier->i,	&( *buffer )[12] );
-
-	// Write the players' paddle positions.
-	int player;
-	for( player = 0; player < state->numPlayers; player++ ) {
-		modifier = ( union IntFloat * )&state->players[player].position;
-		SDLNet_Write32( modifier->i, &( *buffer )[16 + 4 * player ] );
+	if( isKeyframe ) {
+		network->feedCountdown = FEED_KEYFRAME_INTERVAL;
+		SDLNet_Write32( ( int )PID_FEED_KEYFRAME,	&packet[0] );
+		SDLNet_Write32( state->lastHit,				&packet[8] );
+		for( player = 0; player < state->numPlayers; player++ ) {
+			SDLNet_Write32( state->players[player].score, &packet[12 + 4 * player] );
+		}
+		length = 12 + 4 * state->numPlayers;
+		encodedLength = EncodeSnapshot( snapshot, NULL, &packet[length], MAX_SNAPSHOT_LENGTH );
+	} else {
+		SDLNet_Write32( ( int )PID_FEED_SNAPSHOT,	&packet[0] );
+		length = 8;
+		encodedLength = EncodeSnapshot( snapshot, &network->feedSnapshot, &packet[length], MAX_SNAPSHOT_LENGTH );
+	}
+	// The viewers keep the last snapshot they got, so the next one is still encoded against it.
+	if( encodedLength == -1 ) {
+		DebugPrintF( "Skipping a snapshot that doesn't fit into a feed packet." );
+		return;
 	}
+	length += encodedLength;
+	SDLNet_Write32( length, &packet[4] );
+	network->feedCountdown--;
+	network->feedSnapshot = *snapshot;
 
-	return;
+	PublishFeed( network->feed, packet, length, isKeyframe );
 }
 
 /*
 ====================
 ServerUpdateClientGeometry
 
-Checks all clients' data sockets for new information and applies it in the state variable passed.
+Reads all pending datagrams from the data socket and applies the clients' input commands in the state variable passed.
 ====================
 */
 static void ServerUpdateClientGeometry( struct GameState *state ) {
-	int				readPosition;
 	int				player;
-	char			bytes[1024];
-	int				numBytes;
-	union IntFloat *modifier;
+	const char *	args;
+	int				argsLength;
+	uint32_t		sequence;
+	int				packetId;
 
-	for( player = 1 /* 0 is always host */; player < state->numPlayers; player++ ) {
-		// Receive and check length
-		if( !clients[player].dataSocketSet ) {
+	while( ( packetId = ReceiveDatagram( &args, &argsLength, &sequence ) ) != -1 ) {
+		if( packetId != PID_INPUT_COMMANDS && packetId != PID_DATA_HELLO ) {
 			continue;
 		}
-		numBytes = NonBlockingRecv( clients[player].dataSocket, clients[player].dataSocketSet, bytes, sizeof( bytes ) );
-		if( numBytes <= 0 ) {
+		RegisterDataAddress( args, argsLength );
+
+		// Check that the datagram really comes from that player and is not stale.
+		player = argsLength >= 4 ? ( int )SDLNet_Read32( &args[0] ) : -1;
+		if( player < 0 || player >= state->numPlayers || network->clients[player].connectionState != CS_IN_GAME ) {
+			continue;
+		}
+		if( network->clients[player].dataAddress.host != network->dataPacket->address.host || network->clients[player].dataAddress.port != network->dataPacket->address.port ) {
+			continue;
+		}
+		network->clients[player].telemetry.bytesReceived += network->dataPacket->len;
+		if( !IsNewerSequence( sequence, network->clients[player].lastDataSequence ) ) {
 			continue;
 		}
+		network->clients[player].telemetry.datagrams++;
+		network->clients[player].lastDataSequence = sequence;
+		network->clients[player].deadline = SDL_GetTicks() + SILENCE_TIMEOUT;
 
 		// Read information
-		readPosition = numBytes - 4;
-		modifier = ( union IntFloat * )&state->players[player].position;
-		modifier->i = SDLNet_Read32( &bytes[readPosition] );
+		if( packetId == PID_INPUT_COMMANDS ) {
+			ServerApplyInputCommands( state, player, args, argsLength );
+		}
+	}
+}
+
+/*
+====================
+ServerApplyInputCommands
+
+Moves a client's paddle according to the input commands in a PID_INPUT_COMMANDS datagram
+that haven't been applied yet. The client can't move faster than the physics allow, and
+it can't send more seconds of input than have passed on the server.
+====================
+*/
+static void ServerApplyInputCommands( struct GameState *state, int player, const char *args, int argsLength ) {
+	struct BitReader	reader;
+	struct InputCommand	command;
+	union IntFloat		deltaSeconds;
+	uint32_t			acked;
+	int					numCommands;
+	int					n;
+
+	InitBitReader( &reader, args, argsLength );
+	ReadBits( &reader, 32 );	// The player ID, already checked.
+	acked = ReadBits( &reader, 32 );
+	numCommands = ReadBits( &reader, 4 );
+	if( reader.overflow ) {
+		return;
+	}
+
+	// The acknowledged snapshot becomes the baseline for the next ones we send.
+	if( acked && IsNewerSequence( acked, network->clients[player].ackedSnapshot ) && !IsNewerSequence( acked, network->snapshotSequence ) ) {
+		network->clients[player].ackedSnapshot = acked;
+	}
+
+	// The commands are sorted from old to new, we may have seen some of them already.
+	for( n = 0; n < numCommands; n++ ) {
+		command.sequence = ReadBits( &reader, 32 );
+		command.time = ReadBits( &reader, 32 );
+		command.input = ( int )ReadBits( &reader, 2 ) - 1;
+		deltaSeconds.i = ReadBits( &reader, 32 );
+		if( reader.overflow ) {
+			return;
+		}
+		if( !IsNewerSequence( command.sequence, network->clients[player].lastCommand ) ) {
+			continue;
+		}
+
+		command.deltaSeconds = deltaSeconds.f;
+		if( !( command.deltaSeconds > 0.0f ) ) {
+			command.deltaSeconds = 0.0f;
+		}
+		if( command.deltaSeconds > MAX_COMMAND_SECONDS ) {
+			command.deltaSeconds = MAX_COMMAND_SECONDS;
+		}
+		if( command.deltaSeconds > network->clients[player].commandBudget ) {
+			command.deltaSeconds = network->clients[player].commandBudget;
+		}
+		if( command.input < -1 || command.input > 1 ) {
+			command.input = 0;
+		}
+
+		network->clients[player].commandBudget -= command.deltaSeconds;
+		network->clients[player].lastCommand = command.sequence;
+		if( command.deltaSeconds > 0.0f ) {
+			MovePaddle( GetDefaultPhysicsParameters(), &state->players[player], command.input, command.deltaSeconds );
+		}
 	}
 }
 
@@ -927,19 +1945,60 @@ static void ServerUpdateClientGeometry( struct GameState *state ) {
 ====================
 ServerSendGameStateGeometry
 
-Sends a packet containing the game state geometry to all clients.
+Takes a snapshot of the game state geometry and sends it to all clients, each
+encoded against the last snapshot that client has acknowledged. Clients that
+acknowledged the same snapshot share one encoded packet. Every client
+also learns which of its input commands have been applied and how fast its
+paddle moves, so it can replay the rest on top.
 ====================
 */
 static void ServerSendGameStateGeometry( const struct GameState *state ) {
-	char *	bytes;
-	int		numBytes;
-	int		client;
+	struct PacketBuffer		encoded[MAX_PLAYERS];			// Encoded snapshot per distinct baseline
+	uint32_t				encodedBaseline[MAX_PLAYERS];	// Sequence of that baseline, 0 for none
+	int						numEncoded = 0;
+	int						index;
+	char					prefix[8];
+	int						client;
+	struct Snapshot			snapshot;
+	const struct Snapshot *	baseline;
+	union IntFloat			speed;
+
+	CaptureSnapshot( &snapshot, state, ++network->snapshotSequence, SDL_GetTicks() );
+	ServerPublishSnapshot( state, &snapshot );
+	for( client = 0; client < network->numClients; client++ ) {
+		if( network->clients[client].connectionState != CS_IN_GAME ) {
+			continue;
+		}
+
+		// Fall back to a full snapshot if the acknowledged one is too old for both histories.
+		baseline = NULL;
+		if( snapshot.sequence - network->clients[client].ackedSnapshot < SNAPSHOT_HISTORY_LENGTH ) {
+			baseline = FindSnapshot( &network->clients[client].snapshotHistory, network->clients[client].ackedSnapshot );
+		}
+
+		// Encode the snapshot only once for every baseline.
+		for( index = 0; index < numEncoded; index++ ) {
+			if( encodedBaseline[index] == ( baseline ? baseline->sequence : 0 ) ) {
+				break;
+			}
+		}
+		if( index == numEncoded ) {
+			encoded[index].length = EncodeSnapshot( &snapshot, baseline, encoded[index].bytes, MAX_SNAPSHOT_LENGTH );
+			encodedBaseline[index] = baseline ? baseline->sequence : 0;
+			numEncoded++;
+		}
 
-	for( client = 0; client < numClients; client++ ) {
-		if( clients[client].dataSocket ) {
-			SerializeGameStateGeometry( state, &bytes, &numBytes );
-			SDLNet_TCP_Send( clients[client].dataSocket, bytes, numBytes );
+		if( encoded[index].length == -1 ) {
+			DebugPrintF( "Skipping a snapshot for client #%d that doesn't fit into a datagram.", client );
+			continue;
 		}
+
+		speed.f = state->players[client].speed;
+		SDLNet_Write32( network->clients[client].lastCommand,	&prefix[0] );
+		SDLNet_Write32( speed.i,						&prefix[4] );
+		StoreSnapshot( &network->clients[client].snapshotHistory, &snapshot );
+		SendDatagramWithPayload( &network->clients[client].dataAddress, &network->clients[client].dataSequence, PID_STATE_GEOMETRY, prefix, sizeof( prefix ), &encoded[index] );
+		network->clients[client].telemetry.bytesSent += DATAGRAM_HEADER_LENGTH + sizeof( prefix ) + encoded[index].length;
 	}
 }
 
@@ -951,13 +2010,18 @@ Gets called whenever the ball hits a paddle. Broadcasts a packet for that event.
 ====================
 */
 static void ServerInGameSendHit( int player ) {
-	char	bytes[12];
+	struct PacketBuffer packet;
 
-	SDLNet_Write32( ( int )PID_BALL_HIT,	&bytes[0] );
-	SDLNet_Write32( sizeof( bytes ),		&bytes[4] );
-	SDLNet_Write32( player,					&bytes[8] );
+	if( !network->isServer ) {
+		return;
+	}
+	packet.length = 12;
+	SDLNet_Write32( ( int )PID_BALL_HIT,	&packet.bytes[0] );
+	SDLNet_Write32( packet.length,			&packet.bytes[4] );
+	SDLNet_Write32( player,					&packet.bytes[8] );
 
-	BroadcastPacketToClients( bytes, sizeof( bytes ) );
+	BroadcastPacketToClients( packet.bytes, packet.length );
+	PublishToSpectators( packet.bytes, packet.length, 0 );
 }
 
 /*
@@ -968,19 +2032,21 @@ Gets called whenever the ball misses a paddle. Broadcasts a packet for that even
 ====================
 */
 static void ServerInGameSendScore( const struct GameState *state, int player ) {
-	char *	bytes;
-	int		numBytes;
-	int		client;
+	struct PacketBuffer	packet;
+	int					client;
 
-	numBytes = 8 + 4 * state->numPlayers;
-	bytes = malloc( numBytes );
-	SDLNet_Write32( ( int )PID_SCORE,	&bytes[0] );
-	SDLNet_Write32( numBytes,			&bytes[4] );
+	if( !network->isServer ) {
+		return;
+	}
+	packet.length = 8 + 4 * state->numPlayers;
+	SDLNet_Write32( ( int )PID_SCORE,	&packet.bytes[0] );
+	SDLNet_Write32( packet.length,		&packet.bytes[4] );
 	for( client = 0; client < state->numPlayers; client++ ) {
-		SDLNet_Write32( state->players[client].score, &bytes[8 + 4 * client] );
+		SDLNet_Write32( state->players[client].score, &packet.bytes[8 + 4 * client] );
 	}
 
-	BroadcastPacketToClients( bytes, numBytes );
+	BroadcastPacketToClients( packet.bytes, packet.length );
+	PublishToSpectators( packet.bytes, packet.length, 0 );
 }
 
 /*
@@ -993,10 +2059,20 @@ Gets called whenever the server player decides to quit the game.
 static void ServerInGameSendQuit( void ) {
 	char	bytes[8];
 
+	if( !network->isServer ) {
+		return;
+	}
 	SDLNet_Write32( ( int )PID_QUIT,	&bytes[0] );
 	SDLNet_Write32( 8,					&bytes[4] );
 
 	BroadcastPacketToClients( bytes, 8 );
+
+	// Late viewers wait for the next game instead of watching this one end.
+	if( network->feed && network->isFeedLive ) {
+		PublishFeed( network->feed, bytes, 8, 0 );
+		SetFeedPreamble( network->feed, NULL, 0 );
+		network->isFeedLive = 0;
+	}
 }
 
 /*
@@ -1011,35 +2087,40 @@ static int ServerProcessInGameIncomingPackets( void ) {
 	int numBytes;
 	char bytes[1024];
 	int client;
-	int bReadPosition = 0;
-	int endOfStream = 0;
+	int bReadPosition;
 
 	// Go through the clients
-	for( client = 0; client < numClients; client++ ) {
+	for( client = 0; client < network->numClients; client++ ) {
 		// If there is a socket (so, not this client)
-		if( !clients[client].socket ) {
+		if( network->clients[client].socket == NO_STREAM_SOCKET ) {
 			continue;
 		}
-		// while there is something to read from, process the packets.
+		// while there is something left in the receive buffer, process the packets.
 		while( 1 /* This breaks if nothing has been received. */ ) {
-			numBytes = NonBlockingRecv( clients[client].socket, clients[client].socketSet, bytes, sizeof( bytes ) );
+			numBytes = PopPackets( &network->clients[client].recvBuffer, bytes, sizeof( bytes ) );
+			if( numBytes == -1 ) {
+				ServerDropClient( client, "sent a packet we can't read" );
+			}
 			if( numBytes <= 0 ) {
 				break;
 			}
 			DebugPrintF( "Received %d bytes.", numBytes );
+			network->clients[client].telemetry.bytesReceived += numBytes;
 
 			// Process the packet contents.
-			while( !endOfStream ) {
+			for( bReadPosition = 0; bReadPosition < numBytes; bReadPosition += SDLNet_Read32( &bytes[bReadPosition + 4] ) ) {
 				switch( SDLNet_Read32( &bytes[bReadPosition] ) ) {
 					case PID_QUIT:
 						// Handle the quit
 						ServerInGameSendQuit();
 						return -2;
 						break;
-				}
-				bReadPosition += SDLNet_Read32( &bytes[bReadPosition + 4] );
-				if( bReadPosition >= numBytes ) {
-					endOfStream = 1;
+					case PID_PING:
+						SendTelemetryPacket( network->clients[client].socket, &network->clients[client].telemetry, PID_PONG, SDLNet_Read32( &bytes[bReadPosition + 8] ) );
+						break;
+					case PID_PONG:
+						HandlePong( &network->clients[client].telemetry, SDLNet_Read32( &bytes[bReadPosition + 8] ) );
+						break;
 				}
 			}
 		}
@@ -1051,21 +2132,46 @@ static int ServerProcessInGameIncomingPackets( void ) {
 ====================
 ServerProcessInGame
 
-The in-game server loop.
+The in-game server loop, called once per tick.
 ====================
 */
 static int ServerProcessInGame( struct GameState *state ) {
 	// Null pointer check
-	if( !state || !isInitialized || !isConnected ) {
+	if( !state || !isInitialized || !network->isConnected ) {
 		return -1;
 	}
 
-	int result = 0;
+	int				result = 0;
+	int				client;
+	unsigned int	now = SDL_GetTicks();
 
-	// Update own information from clients (dataSocket)
-	ServerUpdateClientGeometry( state );
-	// Broadcast complete GameState information (dataSocket)
-	ServerSendGameStateGeometry( state );
+	// Clients may send as much input as time has passed, plus some slack for jitter.
+	for( client = 0; client < network->numClients; client++ ) {
+		network->clients[client].commandBudget += ( now - network->lastUpdateTime ) / 1000.0f;
+		if( network->clients[client].commandBudget > MAX_COMMAND_BUDGET ) {
+			network->clients[client].commandBudget = MAX_COMMAND_BUDGET;
+		}
+	}
+	network->lastUpdateTime = now;
+
+	// Update own information from clients (dataSocket, UDP) and receive from their control sockets (TCP)
+	ServerPollSockets( state, 0 );
+	// Datagrams the emulated link held back don't make the data socket readable when they are due.
+	if( IsLinkPending( &network->link ) ) {
+		ServerUpdateClientGeometry( state );
+	}
+	ServerCheckDeadlines();
+	for( client = 0; client < network->numClients; client++ ) {
+		if( network->clients[client].socket != NO_STREAM_SOCKET && network->clients[client].connectionState != CS_DROPPED ) {
+			UpdateTelemetry( &network->clients[client].telemetry, network->clients[client].socket, network->clients[client].lastDataSequence, client );
+		}
+	}
+	// Broadcast complete GameState information (dataSocket, UDP) on snapshotRate out of every tickRate ticks, spread evenly.
+	network->snapshotCredit += network->snapshotRate;
+	if( network->snapshotCredit >= network->tickRate ) {
+		network->snapshotCredit -= network->tickRate;
+		ServerSendGameStateGeometry( state );
+	}
 	// NOTE: The functions which broadcast hits and score lists effectively get called by the physics component. (activeSocket)
 	// Checks for quit messages from clients.
 	result = ServerProcessInGameIncomingPackets();
@@ -1077,57 +2183,266 @@ static int ServerProcessInGame( struct GameState *state ) {
 ====================
 ClientSendStateGeometry
 
-Sends information about the client state on the data socket.
+Sends the input commands the server hasn't acknowledged yet on the data socket and
+acknowledges the newest snapshot received. Every datagram repeats up to
+MAX_COMMANDS_PER_DATAGRAM of them, if more were recorded since the last call, more
+datagrams follow until each command went out at least once. A datagram is packed to
+the bit:
+	Name		Bits	Description
+	Player		32		The ID of this client
+	Acked		32		The newest snapshot received
+	Num			4		Amount of commands that follow
+	Commands	98 each	Sequence number (32), time (32), input + 1 (2) and
+						frame length as float (32), from old to new
 ====================
 */
 static void ClientSendStateGeometry( const struct GameState *state ) {
-	char *			packet;
-	float			position = state->players[thisClient].position;
-	union IntFloat *modifier;
+	char				args[9 + MAX_COMMANDS_PER_DATAGRAM * 13];
+	struct BitWriter	writer;
+	union IntFloat		deltaSeconds;
+	uint32_t			first;
+	uint32_t			last;
+	uint32_t			sequence;
+	int					length;
+
+	do {
+		last = network->commandSequence;
+		if( network->commandSequence - network->sentCommand > MAX_COMMANDS_PER_DATAGRAM ) {
+			last = network->sentCommand + MAX_COMMANDS_PER_DATAGRAM;
+		}
+		// Older commands than these have been sent often enough.
+		first = network->ackedCommand + 1;
+		if( last - network->ackedCommand > MAX_COMMANDS_PER_DATAGRAM ) {
+			first = last - MAX_COMMANDS_PER_DATAGRAM + 1;
+		}
+
+		InitBitWriter( &writer, args, sizeof( args ) );
+		WriteBits( &writer, network->thisClient, 32 );
+		WriteBits( &writer, network->snapshotSequence, 32 );
+		WriteBits( &writer, last + 1 - first, 4 );
+		for( sequence = first; sequence != last + 1; sequence++ ) {
+			struct InputCommand *command = &network->pendingCommands[sequence % MAX_PENDING_COMMANDS];
+			deltaSeconds.f = command->deltaSeconds;
+			WriteBits( &writer, command->sequence, 32 );
+			WriteBits( &writer, command->time, 32 );
+			WriteBits( &writer, command->input + 1, 2 );
+			WriteBits( &writer, deltaSeconds.i, 32 );
+		}
+
+		length = FlushBitWriter( &writer );
+		SendDatagram( &network->serverDataAddress, &network->dataSequence, PID_INPUT_COMMANDS, args, length );
+		network->serverTelemetry.bytesSent += DATAGRAM_HEADER_LENGTH + length;
+		network->sentCommand = last;
+	} while( last != network->commandSequence );
+}
+
+/*
+====================
+ClientRecordInput
+
+Input handler for the physics component. Remembers the input that has just been applied
+to this client's paddle, so it can be sent to the server and replayed after corrections.
+====================
+*/
+static void ClientRecordInput( int input, float deltaSeconds ) {
+	struct InputCommand *command;
+
+	if( network->isServer || network->isSpectator || !clientGameStarted ) {
+		return;
+	}
+
+	network->commandSequence++;
+	command = &network->pendingCommands[network->commandSequence % MAX_PENDING_COMMANDS];
+	command->sequence = network->commandSequence;
+	command->time = SDL_GetTicks();
+	command->input = input;
+	command->deltaSeconds = deltaSeconds;
+}
+
+/*
+====================
+ClientReconcile
+
+Resets this client's paddle to the state the server has sent and replays all input
+commands the server hadn't applied yet. The difference to the previous prediction
+goes into the paddle's correction, so it fades out on screen instead of jumping.
+If the round trip took longer than MAX_COMMAND_RTT, only the commands that are still
+remembered get replayed.
+====================
+*/
+static void ClientReconcile( struct Player *player, uint32_t acked, float position, float speed ) {
+	float		predicted = player->position + player->correction;
+	uint32_t	first = acked + 1;
+	uint32_t	sequence;
+
+	// Acknowledgements older than the last one or of commands we never recorded are no use.
+	if( IsNewerSequence( network->ackedCommand, acked ) || IsNewerSequence( acked, network->commandSequence ) ) {
+		return;
+	}
+	network->ackedCommand = acked;
+	if( network->commandSequence - acked > MAX_PENDING_COMMANDS ) {
+		first = network->commandSequence - MAX_PENDING_COMMANDS + 1;
+	}
 
-	packet = malloc( sizeof( position ) );
-	modifier = ( union IntFloat * )&position;
-	SDLNet_Write32( modifier->i, &packet[0] );
-	SDLNet_TCP_Send( dataSocket, packet, sizeof( position ) );
+	player->position = position;
+	player->speed = speed;
+	for( sequence = first; sequence != network->commandSequence + 1; sequence++ ) {
+		MovePaddle( GetDefaultPhysicsParameters(), player, network->pendingCommands[sequence % MAX_PENDING_COMMANDS].input, network->pendingCommands[sequence % MAX_PENDING_COMMANDS].deltaSeconds );
+	}
+	player->correction = predicted - player->position;
 }
 
 /*
 ====================
 ClientUpdateStateGeometry
 
-Receives information about the client state on the data socket.
+Receives information about the client state on the data socket. Every snapshot that
+is newer than what we have goes into the jitter buffer, so a burst of them still gives
+the interpolation every sample. With SC_LATEST, our own paddle is only reconciled with
+the newest one, so a client that has fallen behind catches up at once.
 ====================
 */
 static void ClientUpdateStateGeometry( struct GameState *state ) {
-	// Try to receive and return if there isn't any new information.
-	char buffer[1024];
-	int length = NonBlockingRecv( dataSocket, dataSocketSet, buffer, sizeof( buffer ) );
-	if( length <= 0 ) {
+	const char *	args;
+	int				argsLength;
+	uint32_t		sequence;
+	int				packetId;
+	uint32_t		newestSequence = network->lastDataSequence;
+	uint32_t		acked = 0;
+	float			position = 0.0f;
+	float			speed = 0.0f;
+	int				numDecoded = 0;
+	int				backlog = 0;
+
+	// Go through the datagrams that arrived since the last call.
+	while( ( packetId = ReceiveDatagram( &args, &argsLength, &sequence ) ) != -1 ) {
+		// Only accept the server's snapshots, and only if they are newer than what we have.
+		if( packetId != PID_STATE_GEOMETRY || argsLength < 8 ) {
+			continue;
+		}
+		if( network->dataPacket->address.host != network->serverDataAddress.host || network->dataPacket->address.port != network->serverDataAddress.port ) {
+			continue;
+		}
+		network->serverTelemetry.bytesReceived += network->dataPacket->len;
+		if( !IsNewerSequence( sequence, newestSequence ) ) {
+			network->snapshotStats.stale++;
+			continue;
+		}
+		network->snapshotStats.received++;
+		network->serverTelemetry.datagrams++;
+		backlog++;
+
+		newestSequence = sequence;
+		if( ClientApplySnapshot( state, args, argsLength, sequence, &acked, &position, &speed ) ) {
+			continue;
+		}
+
+		if( snapshotConsumption == SC_ALL ) {
+			ClientReconcile( &state->players[network->thisClient], acked, position, speed );
+		} else if( numDecoded ) {
+			network->snapshotStats.skipped++;
+		}
+		numDecoded++;
+	}
+
+	if( snapshotConsumption == SC_LATEST && numDecoded ) {
+		ClientReconcile( &state->players[network->thisClient], acked, position, speed );
+	}
+
+	network->snapshotStats.backlog = backlog;
+	if( backlog > network->snapshotStats.maxBacklog ) {
+		network->snapshotStats.maxBacklog = backlog;
+	}
+	network->snapshotStats.averageBacklog += ( backlog - network->snapshotStats.averageBacklog ) / BACKLOG_SMOOTHING;
+}
+
+/*
+====================
+ClientApplySnapshot
+
+Decodes a snapshot datagram from the server, stores it as a baseline and puts it into
+the jitter buffer. Writes what the server says about our own paddle into acked, position
+and speed, for ClientReconcile. Returns -1 if the snapshot can't be decoded.
+====================
+*/
+static int ClientApplySnapshot( struct GameState *state, const char *args, int argsLength, uint32_t sequence, uint32_t *acked, float *position, float *speed ) {
+	struct Snapshot	snapshot;
+	union IntFloat	paddleSpeed;
+
+	// Rebuild the full snapshot from its baseline. If that fails, we wait for the next one.
+	if( DecodeSnapshot( &snapshot, &network->snapshotHistory, state->numPlayers, &args[8], argsLength - 8 ) ) {
+		DebugPrintF( "Dropping undecodable snapshot." );
+		network->snapshotStats.undecodable++;
+		return -1;
+	}
+	network->lastDataSequence = sequence;
+	network->snapshotSequence = snapshot.sequence;
+	StoreSnapshot( &network->snapshotHistory, &snapshot );
+	PushSnapshot( &network->jitterBuffer, &snapshot, SDL_GetTicks() );
+
+	paddleSpeed.i = SDLNet_Read32( &args[4] );
+	*acked = SDLNet_Read32( &args[0] );
+	*position = snapshot.positions[network->thisClient];
+	*speed = paddleSpeed.f;
+	return 0;
+}
+
+/*
+====================
+ClientApplyFeedSnapshot
+
+Decodes a PID_FEED_SNAPSHOT or PID_FEED_KEYFRAME packet for a spectator and puts
+the snapshot into the jitter buffer. A keyframe also brings the scores up to date.
+====================
+*/
+static void ClientApplyFeedSnapshot( struct GameState *state, const char *bytes, int numBytes ) {
+	struct Snapshot	snapshot;
+	int				offset = 8;
+	int				player;
+
+	if( SDLNet_Read32( &bytes[0] ) == PID_FEED_KEYFRAME ) {
+		offset = 12 + 4 * state->numPlayers;
+		if( numBytes < offset ) {
+			return;
+		}
+		state->lastHit = ( int )SDLNet_Read32( &bytes[8] );
+		for( player = 0; player < state->numPlayers; player++ ) {
+			state->players[player].score = SDLNet_Read32( &bytes[12 + 4 * player] );
+		}
+	}
+
+	if( DecodeSnapshot( &snapshot, &network->snapshotHistory, state->numPlayers, &bytes[offset], numBytes - offset ) ) {
+		network->snapshotStats.undecodable++;
 		return;
 	}
+	network->snapshotStats.received++;
+	network->snapshotSequence = snapshot.sequence;
+	StoreSnapshot( &network->snapshotHistory, &snapshot );
+	PushSnapshot( &network->jitterBuffer, &snapshot, SDL_GetTicks() );
+}
 
-	// Prepare for new state data.
-	struct GameState newState;
-	newState.players = malloc( state->numPlayers * sizeof( struct Player ) );
+/*
+====================
+ClientInterpolateStateGeometry
 
-	// Find the last actual GameState in the buffer.
-	int chunkLength = 16 + 4 * state->numPlayers;
-	int lastChunkIndex = 0/*length - chunkLength*/;
+Shows the ball and the other paddles as they were at now minus the interpolation delay.
+====================
+*/
+static void ClientInterpolateStateGeometry( struct GameState *state, unsigned int now ) {
+	struct Snapshot	snapshot;
+	int				player;
 
-	// Deserialize that one
-	DeserializeGameStateGeometry( &newState, &buffer[lastChunkIndex], chunkLength );
+	if( SampleJitterBuffer( &network->jitterBuffer, now, &snapshot ) ) {
+		return;
+	}
 
-	// Copy all the information except for the position of this client (we know it better!)
-	int player;
-	state->ball = newState.ball;
+	// Copy all the information except for the position of this client, which we predict.
+	state->ball = snapshot.ball;
 	for( player = 0; player < state->numPlayers; player++ ) {
-		if( player != thisClient ) {
-			state->players[player].position = newState.players[player].position;
+		if( player != network->thisClient ) {
+			state->players[player].position = snapshot.positions[player];
 		}
 	}
-
-	// And we're done!
-	return;
 }
 
 /*
@@ -1140,6 +2455,7 @@ Given a buffer of packets and its length, acts upon the packet contents (PID_BAL
 static int	ClientProcessInGameIncomingPackets( struct GameState *state, char *bytes, int numBytes ) {
 	int		clientId;
 	int		player;
+	int		score;
 
 	int		bReadPosition = 0;
 	int		endOfStream = 0;
@@ -1148,17 +2464,33 @@ static int	ClientProcessInGameIncomingPackets( struct GameState *state, char *by
 		switch( SDLNet_Read32( &bytes[bReadPosition] ) ) {
 			case PID_BALL_HIT:
 				clientId = SDLNet_Read32( &bytes[bReadPosition + 8] );
-				RegisterHit( clientId );
+				RegisterHit( state, clientId );
 				break;
 			case PID_SCORE:
 				for( player = 0; player < state->numPlayers; player++ ) {
-					state->players[player].score = SDLNet_Read32( &bytes[bReadPosition + 8 + 4 * player] );
+					score = SDLNet_Read32( &bytes[bReadPosition + 8 + 4 * player] );
+					if( score == state->players[player].score ) {
+						continue;
+					}
+					state->players[player].score = score;
 					DebugPrintF( "Player #%d has %d points.", player, state->players[player].score );
+					// We don't run the ball logic ourselves, so this is where we learn about the point.
+					RegisterScore( state, player );
 				}
 				break;
 			case PID_QUIT:
 				// We get a quit message? Okay, let's quit too.
 				return -2;
+			case PID_PING:
+				SendTelemetryPacket( network->activeSocket, &network->serverTelemetry, PID_PONG, SDLNet_Read32( &bytes[bReadPosition + 8] ) );
+				break;
+			case PID_PONG:
+				HandlePong( &network->serverTelemetry, SDLNet_Read32( &bytes[bReadPosition + 8] ) );
+				break;
+			case PID_FEED_SNAPSHOT:
+			case PID_FEED_KEYFRAME:
+				ClientApplyFeedSnapshot( state, &bytes[bReadPosition], SDLNet_Read32( &bytes[bReadPosition + 4] ) );
+				break;
 		}
 		bReadPosition += SDLNet_Read32( &bytes[bReadPosition + 4] );
 		if( bReadPosition >= numBytes ) {
@@ -1183,10 +2515,11 @@ static int ClientUpdateStateInformation( struct GameState *state ) {
 	int		result = 0;
 
 	while( result == 0 ) {
-		numBytes = NonBlockingRecv( activeSocket, activeSocketSet, bytes, sizeof( bytes ) );
+		numBytes = NonBlockingRecv( network->activeSocket, &network->activeRecvBuffer, bytes, sizeof( bytes ) );
 		if( numBytes <= 0 ) {
 			break;
 		}
+		network->serverTelemetry.bytesReceived += numBytes;
 		result = ClientProcessInGameIncomingPackets( state, bytes, numBytes );
 	}
 
@@ -1203,25 +2536,129 @@ The in-game client loop.
 */
 static int ClientProcessInGame( struct GameState *state ) {
 	// Null pointer check
-	if( !state || !isInitialized || !isConnected  ) {
+	if( !state || !isInitialized || !network->isConnected  ) {
 		return -1;
 	}
 
-	int result = 0;
+	int				result = 0;
+	unsigned int	now = SDL_GetTicks();
+
+	// Spectators have no paddle and send nothing, everything arrives on the active socket.
+	if( network->isSpectator ) {
+		result = ClientUpdateStateInformation( state );
+		ClientInterpolateStateGeometry( state, now );
+		return result;
+	}
+
+	// Let the correction of our paddle fade out.
+	state->players[network->thisClient].correction *= expf( -CORRECTION_DECAY * ( now - network->lastUpdateTime ) / 1000.0f );
+	network->lastUpdateTime = now;
 
-	// Send your own paddle's position to the server
+	// Send your own paddle's input to the server
 	ClientSendStateGeometry( state );
 
 	// Receive ball position/direction and other paddle's positions
 	ClientUpdateStateGeometry( state );
+	ClientInterpolateStateGeometry( state, now );
 
 	// Receive ball hits and score lists from the server
 	result = ClientUpdateStateInformation( state );
+	UpdateTelemetry( &network->serverTelemetry, network->activeSocket, network->lastDataSequence, -1 );
 
 	// Returns -2 when we should quit.
 	return result;
 }
 
+/*
+====================
+CountConnectedClients
+
+Returns how many remote clients are still connected, either in the lobby or in the game.
+====================
+*/
+int CountConnectedClients( void ) {
+	int client;
+	int count = 0;
+
+	for( client = 0; client < network->numClients; client++ ) {
+		if( ( network->clients[client].socket != NO_STREAM_SOCKET || network->clients[client].isSimulated ) && network->clients[client].connectionState != CS_DROPPED ) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/*
+====================
+AddSimulatedClient
+
+Gives a seat on the server to a client that doesn't exist, e.g. for benchmarks.
+It is in the game from the start and gets its snapshots sent to dataPort on this
+machine, but it never sends anything itself and is never dropped.
+====================
+*/
+int AddSimulatedClient( uint16_t dataPort ) {
+	struct NetworkClientInfo	clientInfo;
+
+	if( !network->isServer ) {
+		return -1;
+	}
+	memset( &clientInfo, 0, sizeof( clientInfo ) );
+	if( SDLNet_ResolveHost( &clientInfo.dataAddress, "127.0.0.1", dataPort ) ) {
+		return -1;
+	}
+	clientInfo.socket = NO_STREAM_SOCKET;
+	clientInfo.connectionState = CS_IN_GAME;
+	clientInfo.isSimulated = 1;
+	return AddPlayer( clientInfo );
+}
+
+/*
+====================
+SetSnapshotConsumption
+
+Sets how a client consumes a backlog of snapshots, see enum SnapshotConsumption.
+====================
+*/
+void SetSnapshotConsumption( enum SnapshotConsumption consumption ) {
+	snapshotConsumption = consumption;
+}
+
+/*
+====================
+GetSnapshotStats
+
+Copies the statistics about the snapshots received in the current game into stats.
+====================
+*/
+void GetSnapshotStats( struct SnapshotStats *stats ) {
+	*stats = network->snapshotStats;
+}
+
+/*
+====================
+GetConnectionStats
+
+Copies what we know about the connection to a player during the game into stats.
+On a client, this is always the connection to the server. Returns -1 if there is
+no such connection.
+====================
+*/
+int GetConnectionStats( int player, struct ConnectionStats *stats ) {
+	if( !network->isServer ) {
+		if( !clientGameStarted ) {
+			return -1;
+		}
+		*stats = network->serverTelemetry.stats;
+		return 0;
+	}
+	if( player < 0 || player >= network->numClients || network->clients[player].socket == NO_STREAM_SOCKET || network->clients[player].connectionState == CS_LOBBY ) {
+		return -1;
+	}
+	*stats = network->clients[player].telemetry.stats;
+	return 0;
+}
+
 /*
 ====================
 IsServer
@@ -1230,7 +2667,7 @@ Determines whether the component is connected as a server.
 ====================
 */
 int IsServer( void ) {
-	return isServer;
+	return network->isServer;
 }
 
 /*
@@ -1241,6 +2678,6 @@ Returns the index of this client in the GameState player array.
 ====================
 */
 int ThisClient( void ) {
-	return thisClient;
+	return network->thisClient;
 }
 
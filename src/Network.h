@@ -3,11 +3,16 @@
 
 #include <stdint.h>
 #include "Game.h"
+#include "Feed.h"
 
 #define NETWORK_STANDARD_SERVER_PORT ( ( uint16_t )49696 )
 #define STANDARD_UDP_SERVER_PORT ( ( uint16_t )49697 )
+#define SPECTATOR_PORT ( ( uint16_t )( NETWORK_STANDARD_SERVER_PORT - 2 ) )	// Where servers and relays serve the spectators of all their matches
+#define SPECTATE_REQUEST_LENGTH 12
 #define NETWORK_STANDARD_DATA_PORT STANDARD_UDP_SERVER_PORT
 #define GAME_START 20
+#define PING_INTERVAL 1000			// Milliseconds between two pings to the same peer
+#define TELEMETRY_WINDOW 5000		// Milliseconds the rates and the loss are averaged over, also how often they are logged
 
 /*
 ==========================================================
@@ -18,16 +23,97 @@ A type that identifies players in the lobby.
 */
 typedef char *playerInfo_t;
 
+/*
+==========================================================
+
+The sockets, clients and snapshots of one match. Every
+thread works on one context at a time, see
+SelectNetworkContext.
+
+==========================================================
+*/
+struct NetworkContext;
+
+/*
+==========================================================
+
+How a client consumes the snapshots that piled up on its
+data socket since the last frame.
+
+==========================================================
+*/
+enum SnapshotConsumption {
+	SC_LATEST,		// Buffer all of them, reconcile our paddle only with the newest one
+	SC_ALL			// Buffer all of them and reconcile our paddle with every one in order
+};
+
+/*
+==========================================================
+
+Statistics about the snapshots a client has received in
+the current game. The backlog is the amount of snapshots
+that were waiting on the data socket when the client read
+it.
+
+==========================================================
+*/
+struct SnapshotStats {
+	unsigned int	received;		// Snapshots from the server that weren't stale
+	unsigned int	skipped;		// Snapshots our paddle wasn't reconciled with because a newer one was waiting
+	unsigned int	stale;			// Snapshots that arrived after a newer one
+	unsigned int	undecodable;	// Snapshots whose baseline was unknown
+	int				backlog;		// Backlog at the last read
+	int				maxBacklog;		// Largest backlog so far
+	float			averageBacklog;	// Moving average of the backlog over the frames
+};
+
+/*
+==========================================================
+
+What we know about the connection to one peer during a game.
+Pings on the control socket measure the round trip time, the
+sequence numbers of the peer's datagrams the loss. The rates
+and the loss are averages over the last TELEMETRY_WINDOW
+milliseconds.
+
+==========================================================
+*/
+struct ConnectionStats {
+	float	rtt;			// Smoothed round trip time in milliseconds
+	float	jitter;			// Smoothed deviation of the round trip time in milliseconds
+	float	loss;			// Share of the peer's datagrams that didn't arrive, between 0 and 1
+	float	sendRate;		// Bytes per second sent to the peer, on both sockets
+	float	receiveRate;	// Bytes per second received from the peer, on both sockets
+	int		sendQueue;		// Bytes on the control socket the peer hasn't acknowledged, -1 if unknown
+};
+
 int InitializeNetwork( void );
 void CloseNetwork( void );
 
+struct NetworkContext *CreateNetworkContext( void );
+void DestroyNetworkContext( struct NetworkContext *context );
+void SelectNetworkContext( struct NetworkContext *context );
+
 int Connect( int server, const char *remoteAddress, uint16_t port );
+int ConnectSpectator( const char *remoteAddress, uint16_t port, int match );
 void Disconnect( void );
 
 int ProcessLobby( void );
+void SetNetworkRates( int tickRate, int snapshotRate );
 int NetworkStartGame( uint16_t udpPort );
 int ProcessInGame( struct GameState *state );
+void WaitForNetwork( struct GameState *state, unsigned int timeout );
+
+void SetSnapshotConsumption( enum SnapshotConsumption consumption );
+void GetSnapshotStats( struct SnapshotStats *stats );
+int GetConnectionStats( int player, struct ConnectionStats *stats );
 
 int GetLocalIP( const char **string );
 int GetPlayerList( playerInfo_t *players, int *numPlayers );
+int CountConnectedClients( void );
+int AddSimulatedClient( uint16_t dataPort );
+
+int ReadSpectateRequest( const char *bytes, int length );
+void SetSpectatorFeed( struct SpectatorFeed *feed );
+int ForwardSpectatorStream( struct SpectatorFeed *feed );
 #endif
@@ -0,0 +1,29 @@
+#ifndef _PACKET_BUFFER_H
+#define _PACKET_BUFFER_H
+
+#define PACKET_BUFFER_SIZE 512		// Enough for any datagram and any in-game packet on the active socket
+
+/*
+==========================================================
+
+The bytes of a packet that is sent to several peers. It is
+filled in once and then handed to every send, so that a
+broadcast builds or encodes it only once. Every send copies
+it right away, so a buffer on the stack is all it needs.
+
+That is also why it has no reference count: no send holds on
+to it, so there is nothing to share beyond the broadcast and
+nothing to allocate. A snapshot is a delta against what each
+client acknowledged, and only clients with the same baseline
+can share its encoding, see ServerSendGameStateGeometry. So
+snapshots cost one encoding per distinct baseline and tick,
+not one per tick.
+
+==========================================================
+*/
+struct PacketBuffer {
+	char	bytes[PACKET_BUFFER_SIZE];
+	int		length;
+};
+
+#endif
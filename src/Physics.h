@@ -2,13 +2,14 @@
 #define _PHYSICS_H
 
 #include "Game.h"
+#include "Motion.h"
 
-#define PADDLE_SIZE 0.1f
-#define DEFAULT_BALL_RADIUS 0.05f
+struct BallSet;
 
 typedef void ( *registerHitHandler_t )( int player );
 typedef void ( *registerPointHandler_t )( const struct GameState *state, int player );
 typedef void ( *registerQuitHandler_t )( void );
+typedef void ( *registerInputHandler_t )( int input, float deltaSeconds );
 
 /*
 ==========================================================
@@ -25,14 +26,15 @@ struct Line2D {
 int				InitializePhysics( void );
 int				ProcessPhysics( struct GameState *state, float deltaSeconds );
 void			AtRegisterHit( registerHitHandler_t handler );
-void			RegisterHit( int player );
+void			RegisterHit( struct GameState *state, int player );
 void			AtRegisterPoint( registerPointHandler_t handler );
+void			RegisterScore( const struct GameState *state, int player );
 void			AtRegisterQuit( registerQuitHandler_t handler );
-int				LastHit( void );
-struct Line2D	GetPlayerLine( int player, int numPlayers );
-struct Vector2D	ScaleVector2D( struct Vector2D vector, float scalar );
-struct Point2D	AddVectorToPoint2D( struct Point2D point, struct Vector2D vector );
-float			VectorNorm2D( struct Vector2D vector );
+void			AtRegisterInput( registerInputHandler_t handler );
+int				LastHit( const struct GameState *state );
+int				GetPointSegment( struct Point2D point, int numPlayers );
 void			InitializeBall( struct GameState *state );
+int				MultiBallLogic( struct GameState *state, struct BallSet *balls, float deltaSeconds );
+int				CollideBalls( struct BallSet *balls );
 
 #endif
@@ -5,27 +5,60 @@
 #include "Menu.h"
 #include "Debug/Debug.h"
 #include "Audio.h"
+#include "Game.h"
+#include "Server.h"
+#include "Link.h"
+#include "Replay.h"
+#include "Batch.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <time.h>
 #include <signal.h>
+#include <SDL2/SDL.h>
 
 static void DestroyResources( void );
 static int ReadArguments( int argc, char *argv[] );
 
-static int ArgumentHelp( void );
-static int ArgumentFullscreen( void );
-static int ArgumentWindowed( void );
+static int ArgumentHelp( const char *value );
+static int ArgumentFullscreen( const char *value );
+static int ArgumentWindowed( const char *value );
+static int ArgumentAllSnapshots( const char *value );
+static int ArgumentTickRate( const char *value );
+static int ArgumentSnapshotRate( const char *value );
+static int ArgumentFrameRate( const char *value );
+static int ArgumentDedicated( const char *value );
+static int ArgumentPlayers( const char *value );
+static int ArgumentMatches( const char *value );
+static int ArgumentThreads( const char *value );
+static int ArgumentBenchmark( const char *value );
+static int ArgumentNetsimOut( const char *value );
+static int ArgumentNetsimIn( const char *value );
+static int ArgumentSpectate( const char *value );
+static int ArgumentRelay( const char *value );
+static int ArgumentMatch( const char *value );
+static int ArgumentSpectatorPort( const char *value );
+static int ArgumentRecord( const char *value );
+static int ArgumentReplay( const char *value );
+static int ArgumentReplaySpeed( const char *value );
+static int ArgumentReplaySeek( const char *value );
+static int ArgumentSimulate( const char *value );
+static int ArgumentSimulation( const char *value );
+static int ArgumentStats( const char *value );
+static int ArgumentSeed( const char *value );
+static int ReadCount( const char *value, int max, int *count );
+static int ReadAddress( const char *value, const char **address, uint16_t *port );
+static int ReadPort( const char *value, uint16_t *port );
+static int ReadRate( const char *value, int *rate );
 
 /*
 ==========================================================
 
-A function that is used to set a command line option.
+A function that is used to set a command line option. It gets the
+value that follows the option, or NULL if the option takes none.
 
 ==========================================================
 */
-typedef int( *setArgumentFunction_t )( void );
+typedef int( *setArgumentFunction_t )( const char *value );
 
 /*
 ==========================================================
@@ -37,6 +70,7 @@ A couple of a name and the implementation function of a command line option.
 struct ArgumentNameFunctionCouple {
 	const char *			name;
 	setArgumentFunction_t 	function;
+	int						hasValue;	// Is 1 if the option is followed by a value
 };
 
 // The map of names and functions for the command line options parser.
@@ -44,11 +78,64 @@ struct ArgumentNameFunctionCouple {
 static struct ArgumentNameFunctionCouple argumentNameFunctionMap[] = {
 	{ .name = "--help", .function = &ArgumentHelp },
 	{ .name = "--fullscreen", .function = &ArgumentFullscreen },
-	{ .name = "--windowed", .function = &ArgumentWindowed }
+	{ .name = "--windowed", .function = &ArgumentWindowed },
+	{ .name = "--all-snapshots", .function = &ArgumentAllSnapshots },
+	{ .name = "--tickrate", .function = &ArgumentTickRate, .hasValue = 1 },
+	{ .name = "--snaprate", .function = &ArgumentSnapshotRate, .hasValue = 1 },
+	{ .name = "--framerate", .function = &ArgumentFrameRate, .hasValue = 1 },
+	{ .name = "--dedicated", .function = &ArgumentDedicated },
+	{ .name = "--players", .function = &ArgumentPlayers, .hasValue = 1 },
+	{ .name = "--matches", .function = &ArgumentMatches, .hasValue = 1 },
+	{ .name = "--threads", .function = &ArgumentThreads, .hasValue = 1 },
+	{ .name = "--benchmark", .function = &ArgumentBenchmark, .hasValue = 1 },
+	{ .name = "--netsim-out", .function = &ArgumentNetsimOut, .hasValue = 1 },
+	{ .name = "--netsim-in", .function = &ArgumentNetsimIn, .hasValue = 1 },
+	{ .name = "--spectate", .function = &ArgumentSpectate, .hasValue = 1 },
+	{ .name = "--relay", .function = &ArgumentRelay, .hasValue = 1 },
+	{ .name = "--match", .function = &ArgumentMatch, .hasValue = 1 },
+	{ .name = "--spectator-port", .function = &ArgumentSpectatorPort, .hasValue = 1 },
+	{ .name = "--record", .function = &ArgumentRecord, .hasValue = 1 },
+	{ .name = "--replay", .function = &ArgumentReplay, .hasValue = 1 },
+	{ .name = "--replay-speed", .function = &ArgumentReplaySpeed, .hasValue = 1 },
+	{ .name = "--replay-seek", .function = &ArgumentReplaySeek, .hasValue = 1 },
+	{ .name = "--simulate", .function = &ArgumentSimulate, .hasValue = 1 },
+	{ .name = "--simulation", .function = &ArgumentSimulation, .hasValue = 1 },
+	{ .name = "--stats", .function = &ArgumentStats, .hasValue = 1 },
+	{ .name = "--seed", .function = &ArgumentSeed, .hasValue = 1 }
 };
 
 // Imported from Output.
 extern int outputFullscreen;
+// Imported from Game.
+extern int gameTickRate;
+extern int gameSnapshotRate;
+extern int gameFrameRate;
+extern int gameDedicated;
+extern int gameDedicatedPlayers;
+extern uint64_t gameSeed;
+// Imported from Server.
+extern int serverMatches;
+extern int serverThreads;
+// Imported from Benchmark.
+extern const char *benchmarkName;
+// Imported from Link.
+extern struct LinkConditions linkOutgoingConditions;
+extern struct LinkConditions linkIncomingConditions;
+// Imported from Relay.
+extern const char *spectateAddress;
+extern uint16_t spectatePort;
+extern int spectateMatch;
+extern int relayMode;
+extern uint16_t relayPort;
+// Imported from Replay.
+extern const char *replayRecordPath;
+extern const char *replayPlayPath;
+extern float replaySpeed;
+extern float replaySeek;
+// Imported from Batch.
+extern int64_t batchMatches;
+extern const char *batchStatisticsPath;
+extern struct SimulationParameters batchParameters;
 
 /*
 ====================
@@ -68,15 +155,23 @@ int InitializeProgram( int argc, char *argv[] ) {
 	// Initialize debug component.
 	InitializeDebug();
 
-	// Seed the randomizer.
-	srand( time ( NULL ) );
-
 	// Read command line arguments.
 	ReadArguments( argc, argv );
 
+	// A dedicated server needs nothing but the network and the physics.
+	if( gameDedicated ) {
+		SDL_Init( SDL_INIT_TIMER );
+		InitializeNetwork();
+		InitializePhysics();
+		InitializeReplay();
+		DebugPrintF( "Successfully started multipong as a dedicated server." );
+		return 0;
+	}
+
 	InitializeNetwork();
 	InitializeGraphics();
 	InitializePhysics();
+	InitializeReplay();
 	InitializeMenu();
 	InitializeAudio();
 
@@ -106,8 +201,10 @@ Destroys all resources used by the program.
 static void DestroyResources( void ) {
 	// TODO: Call all destructors.
 	Disconnect();
-	CloseDisplay();
-	CloseAudio();
+	if( !gameDedicated ) {
+		CloseDisplay();
+		CloseAudio();
+	}
 	CloseDebug();
 }
 
@@ -116,8 +213,9 @@ static void DestroyResources( void ) {
 ReadArguments
 
 Reads the arguments from the command line.
-	--help		prints a help message
-	--windowed	executes in windowed mode
+	--help				prints a help message
+	--windowed			executes in windowed mode
+	--tickrate <hz>		sets the physics tick rate
 For full list of options, see function pointer list above.
 ====================
 */
@@ -133,12 +231,21 @@ static int ReadArguments( int argc, char *argv[] ) {
 		for( j = 0; j < numImplementedArgs; j++ ) {
 			// If any entry's name matches the option:
 			if( !strcmp( argumentNameFunctionMap[j].name, argv[i] ) ) {
-				// Call the function from the map entry.
-				result = argumentNameFunctionMap[j].function();
+				// Call the function from the map entry, with the next argument if it takes a value.
+				if( !argumentNameFunctionMap[j].hasValue ) {
+					result = argumentNameFunctionMap[j].function( NULL );
+				} else if( i + 1 < argc ) {
+					result = argumentNameFunctionMap[j].function( argv[++i] );
+				} else {
+					printf( "Option %s needs a value.\n", argv[i] );
+					result = -1;
+				}
 				// If it failed, return the failure.
 				if( result ) {
 					return result;
 				}
+				// The value we may have taken must not be read as an option.
+				break;
 			}
 		}
 	}
@@ -154,11 +261,39 @@ Implements behaviour when the program is started with --help.
 Prints a help message.
 ====================
 */
-static int ArgumentHelp( void ) {
+static int ArgumentHelp( const char *value ) {
 	printf( "Welcome to multipong. Your options:\n"
 			"  --help         Prints this message\n"
 			"  --fullscreeen  Executes in full-screen mode\n"
-			"  --windowed     Executes in windowed mode\n" );
+			"  --windowed     Executes in windowed mode\n"
+			"  --all-snapshots  Reconciles our paddle with every snapshot from the server instead of only the newest one\n"
+			"  --tickrate <hz>  Sets the physics steps per second (default %d)\n"
+			"  --snaprate <hz>  Sets the snapshots per second a server sends (default %d)\n"
+			"  --framerate <hz> Sets how many frames per second are drawn at most (default %d)\n"
+			"  --dedicated      Runs a server without graphics, audio or a player of its own\n"
+			"  --players <n>    Sets how many players a dedicated server waits for (default %d)\n"
+			"  --matches <n>    Sets how many matches a dedicated server hosts at once, on consecutive port pairs (default 1)\n"
+			"  --threads <n>    Sets how many worker threads run the matches (default one per processor)\n"
+			"  --benchmark <name>  Runs a benchmark instead of the game, e.g. matches\n"
+			"  --netsim-out <conditions>  Emulates a bad link for the datagrams we send, e.g.\n"
+			"                   latency=80,jitter=20,loss=0.02,reorder=0.01,duplicate=0.01,bandwidth=16000,seed=7\n"
+			"  --netsim-in <conditions>   The same for the datagrams we receive\n"
+			"  --spectate <host[:port]>   Watches a match of a server or relay (default port %d)\n"
+			"  --relay <host[:port]>      Serves a match of a server or relay to spectators, without graphics\n"
+			"  --match <n>      Sets which match to watch or relay, counted from 0 (default 0)\n"
+			"  --spectator-port <port>    Sets where a dedicated server or relay serves spectators (default %d)\n"
+			"  --record <file>  Records the games we host; a dedicated server appends -<port>-<game> to the name\n"
+			"  --replay <file>  Plays a recorded game instead of the menu\n"
+			"  --replay-speed <x>   Plays the replay x times as fast as it was recorded (default 1)\n"
+			"  --replay-seek <seconds>  Starts the replay at that point of the game\n"
+			"  --simulate <n>   Plays n matches of bots as fast as possible on --threads threads, with --players seats\n"
+			"  --simulation <parameters>  Changes the rules of simulated matches, e.g.\n"
+			"                   tickrate=120,speed=1,radius=0.05,paddle=0.1,tolerance=0.025,acceleration=4,\n"
+			"                   maxspeed=1.5,braking=2,deflection=20,points=5,seconds=600\n"
+			"  --stats <file>   Sets where a simulation writes its statistics (default %s)\n"
+			"  --seed <n>       Sets the seed every match we host or simulate is drawn from (default: from the clock,\n"
+			"                   0 for a simulation)\n",
+			DEFAULT_TICK_RATE, DEFAULT_SNAPSHOT_RATE, DEFAULT_FRAME_RATE, DEFAULT_DEDICATED_PLAYERS, SPECTATOR_PORT, SPECTATOR_PORT, BATCH_STATISTICS_FILE );
 	return 0;
 }
 
@@ -169,7 +304,7 @@ ArgumentFullscreen
 Sets the fullscreen execution flag.
 ====================
 */
-static int ArgumentFullscreen( void ) {
+static int ArgumentFullscreen( const char *value ) {
 	outputFullscreen = 1;
 	return 0;
 }
@@ -181,8 +316,421 @@ ArgumentWindowed
 Unsets the fullscreen execution flag.
 ====================
 */
-static int ArgumentWindowed( void ) {
+static int ArgumentWindowed( const char *value ) {
 	outputFullscreen = 0;
 	return 0;
 }
 
+/*
+====================
+ArgumentAllSnapshots
+
+Makes the client reconcile its paddle with every snapshot it receives in order, instead of
+skipping to the newest one. All of them go into the jitter buffer either way.
+====================
+*/
+static int ArgumentAllSnapshots( const char *value ) {
+	SetSnapshotConsumption( SC_ALL );
+	return 0;
+}
+
+/*
+====================
+ArgumentTickRate
+
+Sets the physics tick rate, e.g. 60, 120 or 240.
+====================
+*/
+static int ArgumentTickRate( const char *value ) {
+	return ReadRate( value, &gameTickRate );
+}
+
+/*
+====================
+ArgumentSnapshotRate
+
+Sets the snapshot rate of the server. It is capped at the tick rate.
+====================
+*/
+static int ArgumentSnapshotRate( const char *value ) {
+	return ReadRate( value, &gameSnapshotRate );
+}
+
+/*
+====================
+ArgumentFrameRate
+
+Sets how many frames per second are drawn at most, independently of the tick rate.
+====================
+*/
+static int ArgumentFrameRate( const char *value ) {
+	return ReadRate( value, &gameFrameRate );
+}
+
+/*
+====================
+ArgumentDedicated
+
+Sets the dedicated server flag.
+====================
+*/
+static int ArgumentDedicated( const char *value ) {
+	gameDedicated = 1;
+	return 0;
+}
+
+/*
+====================
+ArgumentPlayers
+
+Sets how many players a dedicated server waits for before it starts a match.
+====================
+*/
+static int ArgumentPlayers( const char *value ) {
+	char *	end;
+	long	parsed = strtol( value, &end, 10 );
+
+	if( *end != '\0' || parsed < 2 || parsed > MAX_PLAYERS ) {
+		printf( "Invalid amount of players: %s. Expected a number between 2 and %d.\n", value, MAX_PLAYERS );
+		return -1;
+	}
+	gameDedicatedPlayers = ( int )parsed;
+	return 0;
+}
+
+/*
+====================
+ArgumentMatches
+
+Sets how many matches a dedicated server hosts at once.
+====================
+*/
+static int ArgumentMatches( const char *value ) {
+	return ReadCount( value, MAX_MATCHES, &serverMatches );
+}
+
+/*
+====================
+ArgumentThreads
+
+Sets how many worker threads a dedicated server runs its matches on.
+====================
+*/
+static int ArgumentThreads( const char *value ) {
+	return ReadCount( value, MAX_MATCHES, &serverThreads );
+}
+
+/*
+====================
+ArgumentBenchmark
+
+Runs the named benchmark instead of the game. Benchmarks need neither graphics nor audio.
+====================
+*/
+static int ArgumentBenchmark( const char *value ) {
+	benchmarkName = value;
+	gameDedicated = 1;
+	return 0;
+}
+
+/*
+====================
+ArgumentNetsimOut
+
+Sets the conditions of the emulated link for outgoing datagrams, see ParseLinkConditions.
+====================
+*/
+static int ArgumentNetsimOut( const char *value ) {
+	if( ParseLinkConditions( value, &linkOutgoingConditions ) ) {
+		printf( "Invalid link conditions: %s.\n", value );
+		return -1;
+	}
+	return 0;
+}
+
+/*
+====================
+ArgumentNetsimIn
+
+Sets the conditions of the emulated link for incoming datagrams, see ParseLinkConditions.
+====================
+*/
+static int ArgumentNetsimIn( const char *value ) {
+	if( ParseLinkConditions( value, &linkIncomingConditions ) ) {
+		printf( "Invalid link conditions: %s.\n", value );
+		return -1;
+	}
+	return 0;
+}
+
+/*
+====================
+ArgumentSpectate
+
+Watches a match of the given server or relay instead of playing.
+====================
+*/
+static int ArgumentSpectate( const char *value ) {
+	return ReadAddress( value, &spectateAddress, &spectatePort );
+}
+
+/*
+====================
+ArgumentRelay
+
+Relays a match of the given server or relay to spectators. A relay needs neither graphics nor audio.
+====================
+*/
+static int ArgumentRelay( const char *value ) {
+	if( ReadAddress( value, &spectateAddress, &spectatePort ) ) {
+		return -1;
+	}
+	relayMode = 1;
+	gameDedicated = 1;
+	return 0;
+}
+
+/*
+====================
+ArgumentMatch
+
+Sets which match of a server to watch or relay.
+====================
+*/
+static int ArgumentMatch( const char *value ) {
+	char *	end;
+	long	parsed = strtol( value, &end, 10 );
+
+	if( *end != '\0' || parsed < 0 || parsed >= MAX_MATCHES ) {
+		printf( "Invalid match: %s. Expected a number between 0 and %d.\n", value, MAX_MATCHES - 1 );
+		return -1;
+	}
+	spectateMatch = ( int )parsed;
+	return 0;
+}
+
+/*
+====================
+ArgumentSpectatorPort
+
+Sets the port on which a dedicated server or relay accepts spectators.
+====================
+*/
+static int ArgumentSpectatorPort( const char *value ) {
+	return ReadPort( value, &relayPort );
+}
+
+/*
+====================
+ArgumentRecord
+
+Records every game this program hosts into the given file.
+====================
+*/
+static int ArgumentRecord( const char *value ) {
+	replayRecordPath = value;
+	return 0;
+}
+
+/*
+====================
+ArgumentReplay
+
+Plays the given replay file instead of showing the menu.
+====================
+*/
+static int ArgumentReplay( const char *value ) {
+	replayPlayPath = value;
+	return 0;
+}
+
+/*
+====================
+ArgumentReplaySpeed
+
+Sets how many times as fast as real time a replay is played.
+====================
+*/
+static int ArgumentReplaySpeed( const char *value ) {
+	char *	end;
+	double	parsed = strtod( value, &end );
+
+	if( *end != '\0' || !( parsed > 0.0 && parsed <= REPLAY_MAX_SPEED ) ) {
+		printf( "Invalid replay speed: %s. Expected a number above 0 and up to %d.\n", value, REPLAY_MAX_SPEED );
+		return -1;
+	}
+	replaySpeed = ( float )parsed;
+	return 0;
+}
+
+/*
+====================
+ArgumentReplaySeek
+
+Sets the time in seconds at which a replay starts.
+====================
+*/
+static int ArgumentReplaySeek( const char *value ) {
+	char *	end;
+	double	parsed = strtod( value, &end );
+
+	if( *end != '\0' || !( parsed >= 0.0 && parsed < 4294967.0 ) ) {
+		printf( "Invalid replay time: %s. Expected a number of seconds.\n", value );
+		return -1;
+	}
+	replaySeek = ( float )parsed;
+	return 0;
+}
+
+/*
+====================
+ArgumentSimulate
+
+Simulates the given amount of matches instead of running the game. A simulation needs
+neither graphics nor audio.
+====================
+*/
+static int ArgumentSimulate( const char *value ) {
+	char *		end;
+	long long	parsed = strtoll( value, &end, 10 );
+
+	if( *end != '\0' || parsed < 1 ) {
+		printf( "Invalid amount of matches: %s. Expected a number above 0.\n", value );
+		return -1;
+	}
+	batchMatches = ( int64_t )parsed;
+	gameDedicated = 1;
+	return 0;
+}
+
+/*
+====================
+ArgumentSimulation
+
+Changes the rules of simulated matches, see ParseSimulationParameters.
+====================
+*/
+static int ArgumentSimulation( const char *value ) {
+	if( ParseSimulationParameters( value, &batchParameters ) ) {
+		printf( "Invalid simulation parameters: %s.\n", value );
+		return -1;
+	}
+	return 0;
+}
+
+/*
+====================
+ArgumentStats
+
+Sets the file a simulation writes its statistics to.
+====================
+*/
+static int ArgumentStats( const char *value ) {
+	batchStatisticsPath = value;
+	return 0;
+}
+
+/*
+====================
+ArgumentSeed
+
+Sets the seed of the matches we host or simulate, so that they can be played again the
+same way.
+====================
+*/
+static int ArgumentSeed( const char *value ) {
+	char *				end;
+	unsigned long long	parsed = strtoull( value, &end, 10 );
+
+	if( *end != '\0' || *value == '-' ) {
+		printf( "Invalid seed: %s. Expected a number.\n", value );
+		return -1;
+	}
+	gameSeed = ( uint64_t )parsed;
+	return 0;
+}
+
+/*
+====================
+ReadCount
+
+Parses a count between 1 and max. Leaves count alone and returns -1 if the value is invalid.
+====================
+*/
+static int ReadCount( const char *value, int max, int *count ) {
+	char *	end;
+	long	parsed = strtol( value, &end, 10 );
+
+	if( *end != '\0' || parsed < 1 || parsed > max ) {
+		printf( "Invalid count: %s. Expected a number between 1 and %d.\n", value, max );
+		return -1;
+	}
+	*count = ( int )parsed;
+	return 0;
+}
+
+/*
+====================
+ReadAddress
+
+Parses a host name with an optional port, e.g. example.com:49694. The port stays
+alone if there is none. Returns -1 if the port is invalid.
+====================
+*/
+static int ReadAddress( const char *value, const char **address, uint16_t *port ) {
+	char *	copy = strdup( value );
+	char *	colon;
+
+	if( !copy ) {
+		return -1;
+	}
+	colon = strrchr( copy, ':' );
+	if( colon ) {
+		*colon = '\0';
+		if( ReadPort( colon + 1, port ) ) {
+			free( copy );
+			return -1;
+		}
+	}
+	// The copy lives as long as the program.
+	*address = copy;
+	return 0;
+}
+
+/*
+====================
+ReadPort
+
+Parses a port number. Leaves port alone and returns -1 if the value is invalid.
+====================
+*/
+static int ReadPort( const char *value, uint16_t *port ) {
+	char *	end;
+	long	parsed = strtol( value, &end, 10 );
+
+	if( *end != '\0' || parsed < 1 || parsed > 65535 ) {
+		printf( "Invalid port: %s.\n", value );
+		return -1;
+	}
+	*port = ( uint16_t )parsed;
+	return 0;
+}
+
+/*
+====================
+ReadRate
+
+Parses a rate in Hertz between 1 and MAX_TICK_RATE. Leaves rate alone and returns -1 if the value is invalid.
+====================
+*/
+static int ReadRate( const char *value, int *rate ) {
+	char *	end;
+	long	parsed = strtol( value, &end, 10 );
+
+	if( *end != '\0' || parsed < 1 || parsed > MAX_TICK_RATE ) {
+		printf( "Invalid rate: %s. Expected a number between 1 and %d.\n", value, MAX_TICK_RATE );
+		return -1;
+	}
+	*rate = ( int )parsed;
+	return 0;
+}
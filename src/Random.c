@@ -0,0 +1,45 @@
+#include "Random.h"
+
+/* A counter-based generator: a number depends on nothing but its key, e.g. the seed of a
+ * match, and its counter, e.g. RANDOM_COUNTER( tick, draw ). There is no state to share
+ * between threads, and any number can be drawn again, in any order. */
+
+// FUNCTIONS
+
+static uint64_t	MixRandom( uint64_t z );
+
+/*
+====================
+MixRandom
+
+The finalizer of SplitMix64, which scrambles every bit of z into every bit of the result.
+====================
+*/
+static uint64_t MixRandom( uint64_t z ) {
+	z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+	z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebull;
+	return z ^ ( z >> 31 );
+}
+
+/*
+====================
+GetRandom
+
+Returns the counter-th number of the SplitMix64 sequence of key. The key is mixed first,
+so that keys that are close together don't give overlapping sequences.
+====================
+*/
+uint64_t GetRandom( uint64_t key, uint64_t counter ) {
+	return MixRandom( MixRandom( key ) + ( counter + 1 ) * 0x9e3779b97f4a7c15ull );
+}
+
+/*
+====================
+GetRandomFloat
+
+Returns the number of GetRandom as a float between 0 and 1, 1 excluded.
+====================
+*/
+float GetRandomFloat( uint64_t key, uint64_t counter ) {
+	return ( GetRandom( key, counter ) >> 40 ) / ( float )( 1 << 24 );
+}
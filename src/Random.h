@@ -0,0 +1,12 @@
+#ifndef _RANDOM_H
+#define _RANDOM_H
+
+#include <stdint.h>
+
+// The counter of the draw-th number drawn in a tick, so that every tick has 2^32 numbers of its own.
+#define RANDOM_COUNTER( tick, draw ) ( ( ( uint64_t )( uint32_t )( tick ) << 32 ) | ( uint32_t )( draw ) )
+
+uint64_t	GetRandom( uint64_t key, uint64_t counter );
+float		GetRandomFloat( uint64_t key, uint64_t counter );
+
+#endif
@@ -0,0 +1,224 @@
+#include "Reactor.h"
+#include "Debug/Debug.h"
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+static int	FindReactorSocket( const struct Reactor *reactor, reactorSocket_t socket );
+
+/*
+====================
+InitializeReactor
+
+Opens an empty reactor, closing it first if it is open. Returns 0 on success and -1 on failure.
+====================
+*/
+int InitializeReactor( struct Reactor *reactor ) {
+	CloseReactor( reactor );
+
+#ifdef __linux__
+	reactor->epollFd = epoll_create1( EPOLL_CLOEXEC );
+	if( reactor->epollFd == -1 ) {
+		DebugPrintF( "epoll_create1 failed: %s", strerror( errno ) );
+		return -1;
+	}
+#else
+	reactor->set = SDLNet_AllocSocketSet( REACTOR_MAX_SOCKETS );
+	if( !reactor->set ) {
+		DebugPrintF( "SDLNet_AllocSocketSet failed: %s", SDLNet_GetError() );
+		return -1;
+	}
+#endif
+	reactor->isOpen = 1;
+	return 0;
+}
+
+/*
+====================
+CloseReactor
+
+Closes the reactor if it is open. The sockets in it stay open.
+====================
+*/
+void CloseReactor( struct Reactor *reactor ) {
+	if( reactor->isOpen ) {
+#ifdef __linux__
+		close( reactor->epollFd );
+#else
+		SDLNet_FreeSocketSet( reactor->set );
+#endif
+	}
+	reactor->isOpen = 0;
+	reactor->numSockets = 0;
+}
+
+/*
+====================
+FindReactorSocket
+
+Returns the index of a socket in the reactor or -1 if it isn't in there.
+====================
+*/
+static int FindReactorSocket( const struct Reactor *reactor, reactorSocket_t socket ) {
+	int index;
+
+	for( index = 0; index < reactor->numSockets; index++ ) {
+		if( reactor->sockets[index] == socket ) {
+			return index;
+		}
+	}
+	return -1;
+}
+
+/*
+====================
+AddReactorSocket
+
+Adds a stream or datagram socket to the reactor and watches it. Returns 0 on success
+and -1 on failure.
+====================
+*/
+int AddReactorSocket( struct Reactor *reactor, reactorSocket_t socket ) {
+	DebugAssert( reactor->numSockets < REACTOR_MAX_SOCKETS );
+	if( !reactor->isOpen || socket == REACTOR_SOCKET( NO_STREAM_SOCKET ) || reactor->numSockets >= REACTOR_MAX_SOCKETS ) {
+		return -1;
+	}
+
+#ifdef __linux__
+	struct epoll_event event;
+	memset( &event, 0, sizeof( event ) );
+	event.events = EPOLLIN;
+	event.data.fd = socket;
+	if( epoll_ctl( reactor->epollFd, EPOLL_CTL_ADD, socket, &event ) == -1 ) {
+		DebugPrintF( "Adding a socket to epoll failed: %s", strerror( errno ) );
+		return -1;
+	}
+#else
+	if( SDLNet_AddSocket( reactor->set, socket ) == -1 ) {
+		DebugPrintF( "Adding a socket to the reactor failed: %s", SDLNet_GetError() );
+		return -1;
+	}
+#endif
+
+	reactor->sockets[reactor->numSockets] = socket;
+	reactor->isWatched[reactor->numSockets] = 1;
+	reactor->numSockets++;
+	return 0;
+}
+
+/*
+====================
+RemoveReactorSocket
+
+Removes a socket from the reactor. Has to be called before the socket is closed.
+====================
+*/
+void RemoveReactorSocket( struct Reactor *reactor, reactorSocket_t socket ) {
+	int index = FindReactorSocket( reactor, socket );
+
+	if( !reactor->isOpen || index == -1 ) {
+		return;
+	}
+#ifdef __linux__
+	epoll_ctl( reactor->epollFd, EPOLL_CTL_DEL, socket, NULL );
+#else
+	if( reactor->isWatched[index] ) {
+		SDLNet_DelSocket( reactor->set, socket );
+	}
+#endif
+	reactor->numSockets--;
+	reactor->sockets[index] = reactor->sockets[reactor->numSockets];
+	reactor->isWatched[index] = reactor->isWatched[reactor->numSockets];
+}
+
+/*
+====================
+WatchReactorSocket
+
+Starts or stops reporting a socket of the reactor as readable. A socket that isn't watched
+stays in the reactor, whatever arrives on it waits in the kernel until it is watched again.
+====================
+*/
+void WatchReactorSocket( struct Reactor *reactor, reactorSocket_t socket, int isWatched ) {
+	int index = FindReactorSocket( reactor, socket );
+
+	if( !reactor->isOpen || index == -1 || reactor->isWatched[index] == !!isWatched ) {
+		return;
+	}
+#ifdef __linux__
+	struct epoll_event event;
+	memset( &event, 0, sizeof( event ) );
+	event.events = isWatched ? EPOLLIN : 0;
+	event.data.fd = socket;
+	if( epoll_ctl( reactor->epollFd, EPOLL_CTL_MOD, socket, &event ) == -1 ) {
+		return;
+	}
+#else
+	if( isWatched ) {
+		if( SDLNet_AddSocket( reactor->set, socket ) == -1 ) {
+			return;
+		}
+	} else {
+		SDLNet_DelSocket( reactor->set, socket );
+	}
+#endif
+	reactor->isWatched[index] = !!isWatched;
+}
+
+/*
+====================
+WaitReactor
+
+Waits up to timeout milliseconds until at least one watched socket in the reactor is
+readable. Writes up to maxReady readable sockets to ready and returns how many there
+are, or -1 on failure.
+====================
+*/
+int WaitReactor( struct Reactor *reactor, unsigned int timeout, reactorSocket_t *ready, int maxReady ) {
+	int numReady = 0;
+	int index;
+
+	if( !reactor->isOpen ) {
+		return -1;
+	}
+
+#ifdef __linux__
+	struct epoll_event events[REACTOR_MAX_SOCKETS];
+
+	if( maxReady > REACTOR_MAX_SOCKETS ) {
+		maxReady = REACTOR_MAX_SOCKETS;
+	}
+	numReady = epoll_wait( reactor->epollFd, events, maxReady, ( int )timeout );
+	if( numReady == -1 ) {
+		// A signal is no error, we just didn't wait as long as we wanted to.
+		return errno == EINTR ? 0 : -1;
+	}
+	for( index = 0; index < numReady; index++ ) {
+		ready[index] = events[index].data.fd;
+	}
+#else
+	int numWatched = 0;
+
+	for( index = 0; index < reactor->numSockets; index++ ) {
+		numWatched += reactor->isWatched[index];
+	}
+	if( numWatched == 0 ) {
+		SDL_Delay( timeout );
+		return 0;
+	}
+	if( SDLNet_CheckSockets( reactor->set, timeout ) <= 0 ) {
+		return 0;
+	}
+	for( index = 0; index < reactor->numSockets && numReady < maxReady; index++ ) {
+		if( reactor->isWatched[index] && SDLNet_SocketReady( reactor->sockets[index] ) ) {
+			ready[numReady++] = reactor->sockets[index];
+		}
+	}
+#endif
+
+	return numReady;
+}
@@ -0,0 +1,62 @@
+#ifndef _REACTOR_H
+#define _REACTOR_H
+
+#include <SDL2/SDL_net.h>
+#include "Game.h"
+#include "Socket.h"
+
+#define REACTOR_MAX_SOCKETS ( MAX_PLAYERS + 2 )	// Every client's control socket, the listening socket and the data socket
+
+/*
+==========================================================
+
+A socket in the reactor, which may be a stream or a datagram
+socket. Convert them with REACTOR_SOCKET.
+
+==========================================================
+*/
+#ifdef __linux__
+typedef int						reactorSocket_t;
+#else
+typedef SDLNet_GenericSocket	reactorSocket_t;
+#endif
+#define REACTOR_SOCKET( socket ) ( ( reactorSocket_t )( socket ) )
+
+/*
+==========================================================
+
+Waits on a set of sockets at once and reports only those
+that are readable, so the server doesn't have to poll every
+socket on every tick. Every match has its own reactor.
+
+On Linux it is an epoll instance, which has no limit on the
+descriptors a process may have open. Everywhere else it falls
+back to a single SDLNet_SocketSet, which costs one select()
+per wait instead of one per socket.
+
+A socket can stay in the reactor without being watched, e.g.
+while there is no room to read what arrives on it. Otherwise
+it would be reported as readable on every wait.
+
+==========================================================
+*/
+struct Reactor {
+	int					isOpen;
+#ifdef __linux__
+	int					epollFd;
+#else
+	SDLNet_SocketSet	set;							// The sockets that are watched
+#endif
+	reactorSocket_t		sockets[REACTOR_MAX_SOCKETS];	// The sockets in the reactor, in no particular order
+	int					isWatched[REACTOR_MAX_SOCKETS];	// A boolean value per socket which is 1 if readability is reported
+	int					numSockets;
+};
+
+int		InitializeReactor( struct Reactor *reactor );
+void	CloseReactor( struct Reactor *reactor );
+int		AddReactorSocket( struct Reactor *reactor, reactorSocket_t socket );
+void	RemoveReactorSocket( struct Reactor *reactor, reactorSocket_t socket );
+void	WatchReactorSocket( struct Reactor *reactor, reactorSocket_t socket, int isWatched );
+int		WaitReactor( struct Reactor *reactor, unsigned int timeout, reactorSocket_t *ready, int maxReady );
+
+#endif
@@ -0,0 +1,261 @@
+#include "Relay.h"
+#include "Main.h"
+#include "Socket.h"
+#include "Debug/Debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+// VARIABLES
+
+const char *	spectateAddress = NULL;			// Set with --spectate or --relay
+uint16_t		spectatePort = SPECTATOR_PORT;	// Set with --spectate or --relay
+int				spectateMatch = 0;				// Set with --match
+int				relayMode = 0;					// Set with --relay
+uint16_t		relayPort = SPECTATOR_PORT;		// Set with --spectator-port
+
+// FUNCTIONS
+
+static void	AcceptViewers( struct Relay *relay );
+static int	ServeViewer( struct Relay *relay, struct Viewer *viewer, char *chunk );
+static void	DropViewer( struct Relay *relay, int index );
+static int	RelayThread( void *data );
+
+/*
+====================
+StartRelay
+
+Opens the spectator port and starts serving the given feeds on a thread of their own.
+Returns 0 on success and -1 on failure.
+====================
+*/
+int StartRelay( struct Relay *relay, uint16_t port, struct SpectatorFeed **feeds, int numFeeds ) {
+	memset( relay, 0, sizeof( *relay ) );
+	relay->listener = OpenStreamListener( port );
+	if( relay->listener == NO_STREAM_SOCKET ) {
+		DebugPrintF( "Could not open port %d for spectators.", port );
+		return -1;
+	}
+
+	relay->feeds = feeds;
+	relay->numFeeds = numFeeds;
+	relay->feedEnds = calloc( numFeeds, sizeof( uint64_t ) );
+	relay->viewers = calloc( RELAY_MAX_VIEWERS, sizeof( struct Viewer ) );
+	SDL_AtomicSet( &relay->stop, 0 );
+	if( relay->feedEnds && relay->viewers ) {
+		relay->thread = SDL_CreateThread( &RelayThread, "Relay", relay );
+	}
+	if( !relay->thread ) {
+		StopRelay( relay );
+		return -1;
+	}
+	return 0;
+}
+
+/*
+====================
+StopRelay
+
+Stops the relay thread and disconnects all viewers. The feeds stay alone.
+====================
+*/
+void StopRelay( struct Relay *relay ) {
+	if( relay->thread ) {
+		SDL_AtomicSet( &relay->stop, 1 );
+		SDL_WaitThread( relay->thread, NULL );
+		relay->thread = NULL;
+	}
+	while( relay->numViewers > 0 ) {
+		DropViewer( relay, relay->numViewers - 1 );
+	}
+	CloseStream( relay->listener );
+	relay->listener = NO_STREAM_SOCKET;
+	free( relay->viewers );
+	relay->viewers = NULL;
+	free( relay->feedEnds );
+	relay->feedEnds = NULL;
+}
+
+/*
+====================
+AcceptViewers
+
+Accepts everybody who is waiting on the spectator port.
+====================
+*/
+static void AcceptViewers( struct Relay *relay ) {
+	struct Viewer *	viewer;
+	streamSocket_t	socket;
+
+	while( ( socket = AcceptStream( relay->listener, NULL ) ) != NO_STREAM_SOCKET ) {
+		if( relay->numViewers == RELAY_MAX_VIEWERS ) {
+			DebugPrintF( "Turning a viewer away, there are %d already.", RELAY_MAX_VIEWERS );
+			CloseStream( socket );
+			continue;
+		}
+		viewer = &relay->viewers[relay->numViewers++];
+		memset( viewer, 0, sizeof( *viewer ) );
+		viewer->socket = socket;
+		viewer->match = -1;
+		viewer->cursor.preambleLength = -1;
+	}
+}
+
+/*
+====================
+ServeViewer
+
+Reads the request of a viewer until it is complete, then sends it as much of its
+feed as its socket takes right now. chunk is a buffer of RELAY_CHUNK bytes.
+Returns -1 if the viewer has to be dropped.
+====================
+*/
+static int ServeViewer( struct Relay *relay, struct Viewer *viewer, char *chunk ) {
+	int length;
+	int sent;
+
+	if( viewer->match < 0 ) {
+		length = ReceiveNonBlocking( viewer->socket, &viewer->request[viewer->requestLength], SPECTATE_REQUEST_LENGTH - viewer->requestLength );
+		if( length == -1 ) {
+			return -1;
+		}
+		viewer->requestLength += length;
+		if( viewer->requestLength < SPECTATE_REQUEST_LENGTH ) {
+			return 0;
+		}
+		viewer->match = ReadSpectateRequest( viewer->request, viewer->requestLength );
+		if( viewer->match < 0 || viewer->match >= relay->numFeeds || !relay->feeds[viewer->match] ) {
+			DebugPrintF( "Dropping a viewer that asked for a match we don't have." );
+			return -1;
+		}
+	}
+
+	if( IsFeedCursorAtEnd( &viewer->cursor, relay->feedEnds[viewer->match] ) ) {
+		return 0;
+	}
+	length = PeekFeed( relay->feeds[viewer->match], &viewer->cursor, chunk, RELAY_CHUNK );
+	if( length == -1 ) {
+		DebugPrintF( "Dropping a viewer of match %d, it fell too far behind.", viewer->match );
+		return -1;
+	}
+	if( length == 0 ) {
+		return 0;
+	}
+	sent = SendNonBlocking( viewer->socket, chunk, length );
+	if( sent == -1 ) {
+		return -1;
+	}
+	AdvanceFeedCursor( &viewer->cursor, sent );
+	return 0;
+}
+
+/*
+====================
+DropViewer
+
+Disconnects a viewer. The last viewer takes its place.
+====================
+*/
+static void DropViewer( struct Relay *relay, int index ) {
+	CloseStream( relay->viewers[index].socket );
+	relay->viewers[index] = relay->viewers[--relay->numViewers];
+}
+
+/*
+====================
+RelayThread
+
+Serves all viewers every RELAY_INTERVAL milliseconds until the relay is stopped.
+====================
+*/
+static int RelayThread( void *data ) {
+	struct Relay *	relay = data;
+	char *			chunk = malloc( RELAY_CHUNK );
+	int				index;
+
+	if( !chunk ) {
+		return -1;
+	}
+	while( !SDL_AtomicGet( &relay->stop ) ) {
+		AcceptViewers( relay );
+
+		// Viewers that are up to date cost no lock, which is most of them most of the time.
+		for( index = 0; index < relay->numFeeds; index++ ) {
+			if( relay->feeds[index] ) {
+				relay->feedEnds[index] = GetFeedEnd( relay->feeds[index] );
+			}
+		}
+		for( index = 0; index < relay->numViewers; ) {
+			if( ServeViewer( relay, &relay->viewers[index], chunk ) == -1 ) {
+				DropViewer( relay, index );
+				continue;
+			}
+			index++;
+		}
+
+		SDL_Delay( RELAY_INTERVAL );
+	}
+
+	free( chunk );
+	return 0;
+}
+
+/*
+====================
+RunRelay
+
+Watches one match of an upstream server or relay and serves it to the spectators
+that connect to relayPort, until the upstream connection is lost. Relays can be
+chained, so a match can have far more viewers than one machine could serve.
+====================
+*/
+enum ProgramState RunRelay( void ) {
+	struct SpectatorFeed **	feeds = calloc( spectateMatch + 1, sizeof( struct SpectatorFeed * ) );
+	struct Relay			relay;
+
+	if( !feeds ) {
+		return PS_QUIT;
+	}
+	feeds[spectateMatch] = CreateSpectatorFeed();
+	if( !feeds[spectateMatch] || ConnectSpectator( spectateAddress, spectatePort, spectateMatch ) ) {
+		DebugPrintF( "Could not watch match %d on %s:%d.", spectateMatch, spectateAddress, spectatePort );
+		DestroySpectatorFeed( feeds[spectateMatch] );
+		free( feeds );
+		return PS_QUIT;
+	}
+
+	if( !StartRelay( &relay, relayPort, feeds, spectateMatch + 1 ) ) {
+		DebugPrintF( "Relaying match %d of %s:%d to port %d.", spectateMatch, spectateAddress, spectatePort, relayPort );
+		while( ForwardSpectatorStream( feeds[spectateMatch] ) != -1 ) {
+			SDL_Delay( RELAY_INTERVAL );
+		}
+		DebugPrintF( "Lost the connection to %s:%d.", spectateAddress, spectatePort );
+		StopRelay( &relay );
+	}
+
+	Disconnect();
+	DestroySpectatorFeed( feeds[spectateMatch] );
+	free( feeds );
+	return PS_QUIT;
+}
+
+/*
+====================
+IsRelay
+
+Determines whether the program relays a match instead of playing.
+====================
+*/
+int IsRelay( void ) {
+	return relayMode;
+}
+
+/*
+====================
+IsSpectator
+
+Determines whether the program watches a match instead of playing.
+====================
+*/
+int IsSpectator( void ) {
+	return spectateAddress != NULL && !relayMode;
+}
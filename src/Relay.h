@@ -0,0 +1,61 @@
+#ifndef _RELAY_H
+#define _RELAY_H
+
+#include <stdint.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_net.h>
+#include "Network.h"
+#include "Feed.h"
+#include "Socket.h"
+
+#define RELAY_MAX_VIEWERS 4096
+#define RELAY_INTERVAL 5		// Milliseconds between two passes over all viewers
+#define RELAY_CHUNK 16384		// Bytes a viewer gets at most in one pass
+
+/*
+==========================================================
+
+A spectator connected to a relay. It first sends which match
+it wants to watch, from then on it only receives.
+
+==========================================================
+*/
+struct Viewer {
+	streamSocket_t		socket;
+	int					match;			// The feed the viewer watches, -1 until its request is complete
+	char				request[SPECTATE_REQUEST_LENGTH];
+	int					requestLength;
+	struct FeedCursor	cursor;
+};
+
+/*
+==========================================================
+
+A thread that serves the feeds of one or more matches to
+their spectators. It does all the work for every viewer, so
+the threads that run the matches only write each snapshot
+to a feed once. Sends never block where streamSocket_t can
+avoid it: a viewer that can't take more now gets the rest in
+a later pass, a viewer that falls behind the whole feed
+buffer is dropped.
+
+==========================================================
+*/
+struct Relay {
+	SDL_Thread *			thread;
+	SDL_atomic_t			stop;
+	streamSocket_t			listener;
+	struct SpectatorFeed **	feeds;			// Indexed by match, NULL for matches that aren't served
+	uint64_t *				feedEnds;		// The end of every feed at the start of the current pass
+	int						numFeeds;
+	struct Viewer *			viewers;		// RELAY_MAX_VIEWERS of them
+	int						numViewers;
+};
+
+int					StartRelay( struct Relay *relay, uint16_t port, struct SpectatorFeed **feeds, int numFeeds );
+void				StopRelay( struct Relay *relay );
+enum ProgramState	RunRelay( void );
+int					IsRelay( void );
+int					IsSpectator( void );
+
+#endif
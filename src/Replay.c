@@ -0,0 +1,751 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include "Replay.h"
+#include "Physics.h"
+#include "Debug/Debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_net.h>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#define REPLAY_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// VARIABLES
+
+const char *	replayRecordPath = NULL;	// Set with --record
+const char *	replayPlayPath = NULL;		// Set with --replay
+float			replaySpeed = 1.0f;			// Set with --replay-speed
+float			replaySeek = 0.0f;			// Set with --replay-seek, in seconds
+
+static _Thread_local struct ReplayWriter *	replay = NULL;	// The writer of the game this thread runs, if it is recorded
+
+// FUNCTIONS
+
+static void		Write64( uint64_t value, char *area );
+static uint64_t	Read64( const char *area );
+static char *	ReserveRecord( struct ReplayWriter *writer, enum ReplayRecordType type, int length );
+static int		GrowReplayWriter( struct ReplayWriter *writer, uint64_t length );
+static void		RecordGeometry( struct ReplayWriter *writer, const struct GameState *state );
+static void		ReplayHit( int player );
+static void		ReplayScore( const struct GameState *state, int player );
+static void		ReplayQuit( void );
+static int		ScanReplay( struct ReplayReader *reader );
+static int		ApplyGeometry( struct ReplayReader *reader, struct GameState *state, const char *args, int length, int isKeyframe );
+
+/*
+====================
+Write64
+
+Writes a 64 bit number in network byte order.
+====================
+*/
+static void Write64( uint64_t value, char *area ) {
+	SDLNet_Write32( ( uint32_t )( value >> 32 ), &area[0] );
+	SDLNet_Write32( ( uint32_t )value, &area[4] );
+}
+
+/*
+====================
+Read64
+
+Reads a 64 bit number in network byte order.
+====================
+*/
+static uint64_t Read64( const char *area ) {
+	return ( ( uint64_t )SDLNet_Read32( &area[0] ) << 32 ) | SDLNet_Read32( &area[4] );
+}
+
+/*
+====================
+InitializeReplay
+
+Registers the event handlers that record hits, points and quits of the game the calling
+thread runs, if it is being recorded.
+====================
+*/
+void InitializeReplay( void ) {
+	AtRegisterHit( &ReplayHit );
+	AtRegisterPoint( &ReplayScore );
+	AtRegisterQuit( &ReplayQuit );
+}
+
+/*
+====================
+OpenReplayWriter
+
+Creates the replay file at path and records the header of a game with the players and the
+seed of state running at tickRate. The first tick recorded is tick 0. Returns 0 on success
+and -1 on failure.
+====================
+*/
+int OpenReplayWriter( struct ReplayWriter *writer, const char *path, const struct GameState *state, int tickRate ) {
+	char *header;
+
+	memset( writer, 0, sizeof( *writer ) );
+	writer->fd = -1;
+#ifdef REPLAY_MMAP
+	writer->fd = open( path, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+	if( writer->fd == -1 ) {
+		DebugPrintF( "Could not create the replay file %s.", path );
+		return -1;
+	}
+#else
+	writer->file = fopen( path, "wb" );
+	if( !writer->file ) {
+		DebugPrintF( "Could not create the replay file %s.", path );
+		return -1;
+	}
+#endif
+	writer->isOpen = 1;
+	writer->numPlayers = state->numPlayers;
+	writer->tickRate = tickRate;
+	if( GrowReplayWriter( writer, REPLAY_HEADER_LENGTH ) ) {
+		CloseReplayWriter( writer );
+		return -1;
+	}
+
+	header = writer->map;
+	SDLNet_Write32( REPLAY_MAGIC, &header[0] );
+	SDLNet_Write32( REPLAY_VERSION, &header[4] );
+	SDLNet_Write32( writer->numPlayers, &header[8] );
+	SDLNet_Write32( writer->tickRate, &header[12] );
+	Write64( 0, &header[16] );
+	SDLNet_Write32( 0, &header[24] );
+	SDLNet_Write32( 0, &header[28] );
+	Write64( state->seed, &header[32] );
+	writer->length = REPLAY_HEADER_LENGTH;
+	return 0;
+}
+
+/*
+====================
+GrowReplayWriter
+
+Makes sure that at least length bytes of the file are mapped, growing it by multiples of
+REPLAY_GROWTH. On Linux the mapping is extended in place or moved by the kernel, without
+tearing down the pages already written. Returns 0 on success and -1 on failure.
+====================
+*/
+static int GrowReplayWriter( struct ReplayWriter *writer, uint64_t length ) {
+	uint64_t	mapLength = writer->mapLength;
+	char *		map;
+
+	if( length <= mapLength ) {
+		return 0;
+	}
+	while( mapLength < length ) {
+		mapLength += REPLAY_GROWTH;
+	}
+
+#ifdef REPLAY_MMAP
+	if( ftruncate( writer->fd, ( off_t )mapLength ) == -1 ) {
+		DebugPrintF( "Could not grow the replay file to %llu bytes.", ( unsigned long long )mapLength );
+		return -1;
+	}
+#ifdef __linux__
+	if( writer->map ) {
+		map = mremap( writer->map, writer->mapLength, mapLength, MREMAP_MAYMOVE );
+		if( map == MAP_FAILED ) {
+			// The old mapping is still there, so the recording so far is intact.
+			DebugPrintF( "Could not remap the replay file." );
+			return -1;
+		}
+		writer->map = map;
+		writer->mapLength = mapLength;
+		return 0;
+	}
+#else
+	if( writer->map ) {
+		munmap( writer->map, writer->mapLength );
+		writer->map = NULL;
+	}
+#endif
+	map = mmap( NULL, mapLength, PROT_READ | PROT_WRITE, MAP_SHARED, writer->fd, 0 );
+	if( map == MAP_FAILED ) {
+		DebugPrintF( "Could not map the replay file." );
+		writer->mapLength = 0;
+		return -1;
+	}
+#else
+	map = realloc( writer->map, mapLength );
+	if( !map ) {
+		return -1;
+	}
+	memset( &map[writer->mapLength], 0, mapLength - writer->mapLength );
+#endif
+	writer->map = map;
+	writer->mapLength = mapLength;
+	return 0;
+}
+
+/*
+====================
+ReserveRecord
+
+Appends a record of the given type with length bytes of arguments for the current tick.
+Returns where the arguments go or NULL if the file can't grow anymore.
+====================
+*/
+static char *ReserveRecord( struct ReplayWriter *writer, enum ReplayRecordType type, int length ) {
+	char *record;
+
+	length += REPLAY_RECORD_HEADER_LENGTH;
+	DebugAssert( length <= 0xffff );
+	if( GrowReplayWriter( writer, writer->length + length ) ) {
+		return NULL;
+	}
+	record = &writer->map[writer->length];
+	SDLNet_Write16( ( uint16_t )type, &record[0] );
+	SDLNet_Write16( ( uint16_t )length, &record[2] );
+	SDLNet_Write32( writer->tick, &record[4] );
+	writer->length += length;
+	return &record[REPLAY_RECORD_HEADER_LENGTH];
+}
+
+/*
+====================
+CloseReplayWriter
+
+Ends the recording, appends the index and shrinks the file to what was recorded.
+====================
+*/
+void CloseReplayWriter( struct ReplayWriter *writer ) {
+	char *	args;
+	int		i;
+
+	if( !writer->isOpen ) {
+		return;
+	}
+	if( writer->map && writer->length >= REPLAY_HEADER_LENGTH ) {
+		if( !writer->hasQuit && ReserveRecord( writer, RR_QUIT, 0 ) ) {
+			writer->hasQuit = 1;
+		}
+		if( !GrowReplayWriter( writer, writer->length + ( uint64_t )writer->numKeyframes * REPLAY_INDEX_ENTRY_LENGTH ) ) {
+			args = &writer->map[writer->length];
+			for( i = 0; i < writer->numKeyframes; i++ ) {
+				SDLNet_Write32( writer->index[i].tick, &args[i * REPLAY_INDEX_ENTRY_LENGTH] );
+				Write64( writer->index[i].offset, &args[i * REPLAY_INDEX_ENTRY_LENGTH + 4] );
+			}
+			Write64( writer->length, &writer->map[16] );
+			SDLNet_Write32( writer->numKeyframes, &writer->map[24] );
+			SDLNet_Write32( writer->tick, &writer->map[28] );
+			writer->length += ( uint64_t )writer->numKeyframes * REPLAY_INDEX_ENTRY_LENGTH;
+		}
+	}
+
+#ifdef REPLAY_MMAP
+	if( writer->map ) {
+		munmap( writer->map, writer->mapLength );
+	}
+	if( ftruncate( writer->fd, ( off_t )writer->length ) == -1 ) {
+		DebugPrintF( "Could not shrink the replay file." );
+	}
+	close( writer->fd );
+#else
+	if( writer->map && fwrite( writer->map, 1, writer->length, writer->file ) != writer->length ) {
+		DebugPrintF( "Could not write the replay file." );
+	}
+	fclose( writer->file );
+	free( writer->map );
+#endif
+	free( writer->index );
+	if( replay == writer ) {
+		replay = NULL;
+	}
+	memset( writer, 0, sizeof( *writer ) );
+	writer->fd = -1;
+}
+
+/*
+====================
+SelectReplayWriter
+
+Makes the event handlers and RecordTick of the calling thread record into writer,
+or nothing if it is NULL.
+====================
+*/
+void SelectReplayWriter( struct ReplayWriter *writer ) {
+	replay = writer && writer->isOpen ? writer : NULL;
+}
+
+/*
+====================
+RecordGeometry
+
+Records the geometry of the current tick. Every REPLAY_KEYFRAME_INTERVAL ticks this is a
+keyframe, which also has the last hit and the scores, otherwise it is a delta against the
+tick before. If the tick before could not be recorded, the tick is recorded in full.
+====================
+*/
+static void RecordGeometry( struct ReplayWriter *writer, const struct GameState *state ) {
+	struct Snapshot	snapshot;
+	char			buffer[MAX_SNAPSHOT_LENGTH];
+	char *			args;
+	int				isKeyframe = writer->tick % REPLAY_KEYFRAME_INTERVAL == 0;
+	int				length;
+	int				player;
+	void *			index;
+
+	// The sequence number 0 isn't used for snapshots.
+	CaptureSnapshot( &snapshot, state, writer->tick + 1, ( uint32_t )( ( uint64_t )writer->tick * 1000 / writer->tickRate ) );
+	// Until a tick made it into the file, the next one can't be a delta against it.
+	writer->hasPrevious = writer->hasPrevious && !isKeyframe;
+	length = EncodeSnapshot( &snapshot, writer->hasPrevious ? &writer->previous : NULL, buffer, MAX_SNAPSHOT_LENGTH );
+	if( length == -1 ) {
+		writer->hasPrevious = 0;
+		return;
+	}
+
+	if( !isKeyframe ) {
+		args = ReserveRecord( writer, RR_TICK, length );
+		if( !args ) {
+			writer->hasPrevious = 0;
+			return;
+		}
+		memcpy( args, buffer, length );
+		writer->previous = snapshot;
+		writer->hasPrevious = 1;
+		return;
+	}
+
+	if( writer->numKeyframes == writer->maxKeyframes ) {
+		index = realloc( writer->index, ( writer->maxKeyframes * 2 + 16 ) * sizeof( struct ReplayKeyframe ) );
+		if( !index ) {
+			return;
+		}
+		writer->index = index;
+		writer->maxKeyframes = writer->maxKeyframes * 2 + 16;
+	}
+	writer->index[writer->numKeyframes].offset = writer->length;
+	args = ReserveRecord( writer, RR_KEYFRAME, 4 + 4 * writer->numPlayers + length );
+	if( !args ) {
+		return;
+	}
+	writer->index[writer->numKeyframes].tick = writer->tick;
+	writer->numKeyframes++;
+	SDLNet_Write32( ( uint32_t )state->lastHit, &args[0] );
+	for( player = 0; player < writer->numPlayers; player++ ) {
+		SDLNet_Write32( state->players[player].score, &args[4 + 4 * player] );
+	}
+	memcpy( &args[4 + 4 * writer->numPlayers], buffer, length );
+	writer->previous = snapshot;
+	writer->hasPrevious = 1;
+}
+
+/*
+====================
+RecordTick
+
+Records the geometry of a tick that was just simulated into the selected writer, if there is one.
+====================
+*/
+void RecordTick( const struct GameState *state ) {
+	if( !replay || replay->hasQuit || state->numPlayers != replay->numPlayers ) {
+		return;
+	}
+	RecordGeometry( replay, state );
+	replay->tick++;
+}
+
+/*
+====================
+ReplayHit
+
+Records that the ball hit a paddle.
+====================
+*/
+static void ReplayHit( int player ) {
+	char *args;
+
+	if( !replay || replay->hasQuit ) {
+		return;
+	}
+	args = ReserveRecord( replay, RR_HIT, 4 );
+	if( args ) {
+		SDLNet_Write32( ( uint32_t )player, args );
+	}
+}
+
+/*
+====================
+ReplayScore
+
+Records the scores after a player got a point.
+====================
+*/
+static void ReplayScore( const struct GameState *state, int player ) {
+	char *	args;
+	int		i;
+
+	if( !replay || replay->hasQuit || state->numPlayers != replay->numPlayers ) {
+		return;
+	}
+	args = ReserveRecord( replay, RR_SCORE, 4 + 4 * state->numPlayers );
+	if( !args ) {
+		return;
+	}
+	SDLNet_Write32( ( uint32_t )player, &args[0] );
+	for( i = 0; i < state->numPlayers; i++ ) {
+		SDLNet_Write32( state->players[i].score, &args[4 + 4 * i] );
+	}
+}
+
+/*
+====================
+ReplayQuit
+
+Records that the game was quit. Nothing is recorded after this.
+====================
+*/
+static void ReplayQuit( void ) {
+	if( !replay || replay->hasQuit ) {
+		return;
+	}
+	if( ReserveRecord( replay, RR_QUIT, 0 ) ) {
+		replay->hasQuit = 1;
+	}
+}
+
+/*
+====================
+OpenReplayReader
+
+Maps the replay file at path and sets state up for its players, at the start of the game.
+Returns 0 on success and -1 if the file can't be read or isn't a replay.
+====================
+*/
+int OpenReplayReader( struct ReplayReader *reader, const char *path, struct GameState *state ) {
+	uint64_t	indexOffset;
+	int			i;
+
+	memset( reader, 0, sizeof( *reader ) );
+	reader->fd = -1;
+#ifdef REPLAY_MMAP
+	struct stat	status;
+	void *		map;
+
+	reader->fd = open( path, O_RDONLY );
+	if( reader->fd == -1 || fstat( reader->fd, &status ) == -1 || status.st_size < REPLAY_HEADER_LENGTH ) {
+		DebugPrintF( "Could not open the replay file %s.", path );
+		CloseReplayReader( reader );
+		return -1;
+	}
+	map = mmap( NULL, status.st_size, PROT_READ, MAP_SHARED, reader->fd, 0 );
+	if( map == MAP_FAILED ) {
+		DebugPrintF( "Could not map the replay file %s.", path );
+		CloseReplayReader( reader );
+		return -1;
+	}
+	reader->map = map;
+	reader->length = status.st_size;
+#else
+	FILE *	file = fopen( path, "rb" );
+	char *	map;
+	long	length;
+
+	if( !file || fseek( file, 0, SEEK_END ) || ( length = ftell( file ) ) < REPLAY_HEADER_LENGTH || fseek( file, 0, SEEK_SET ) ) {
+		DebugPrintF( "Could not open the replay file %s.", path );
+		if( file ) {
+			fclose( file );
+		}
+		return -1;
+	}
+	map = malloc( length );
+	if( !map || fread( map, 1, length, file ) != ( size_t )length ) {
+		DebugPrintF( "Could not read the replay file %s.", path );
+		free( map );
+		fclose( file );
+		return -1;
+	}
+	fclose( file );
+	reader->map = map;
+	reader->length = length;
+#endif
+
+	if( SDLNet_Read32( &reader->map[0] ) != REPLAY_MAGIC || SDLNet_Read32( &reader->map[4] ) != REPLAY_VERSION ) {
+		DebugPrintF( "%s is no replay we can play.", path );
+		CloseReplayReader( reader );
+		return -1;
+	}
+	reader->numPlayers = SDLNet_Read32( &reader->map[8] );
+	reader->tickRate = SDLNet_Read32( &reader->map[12] );
+	indexOffset = Read64( &reader->map[16] );
+	reader->numKeyframes = SDLNet_Read32( &reader->map[24] );
+	reader->numTicks = SDLNet_Read32( &reader->map[28] );
+	reader->seed = Read64( &reader->map[32] );
+	if( reader->numPlayers < 2 || reader->numPlayers > MAX_PLAYERS || reader->tickRate < 1 || reader->tickRate > MAX_TICK_RATE ) {
+		DebugPrintF( "%s is broken.", path );
+		CloseReplayReader( reader );
+		return -1;
+	}
+
+	// A recording that wasn't closed has no index, so we make one.
+	if( indexOffset < REPLAY_HEADER_LENGTH || indexOffset + ( uint64_t )reader->numKeyframes * REPLAY_INDEX_ENTRY_LENGTH > reader->length ) {
+		DebugPrintF( "%s has no index, scanning it.", path );
+		if( ScanReplay( reader ) ) {
+			CloseReplayReader( reader );
+			return -1;
+		}
+	} else {
+		reader->end = indexOffset;
+		reader->index = malloc( ( reader->numKeyframes + 1 ) * sizeof( struct ReplayKeyframe ) );
+		if( !reader->index ) {
+			CloseReplayReader( reader );
+			return -1;
+		}
+		for( i = 0; i < reader->numKeyframes; i++ ) {
+			reader->index[i].tick = SDLNet_Read32( &reader->map[indexOffset + i * REPLAY_INDEX_ENTRY_LENGTH] );
+			reader->index[i].offset = Read64( &reader->map[indexOffset + i * REPLAY_INDEX_ENTRY_LENGTH + 4] );
+		}
+	}
+
+	free( state->players );
+	state->numPlayers = reader->numPlayers;
+	state->players = calloc( state->numPlayers, sizeof( struct Player ) );
+	state->lastHit = -1;
+	state->seed = reader->seed;
+	memset( &state->ball, 0, sizeof( state->ball ) );
+	reader->position = REPLAY_HEADER_LENGTH;
+	return state->players ? 0 : -1;
+}
+
+/*
+====================
+ScanReplay
+
+Finds the end of the records and all keyframes of a replay that has no index.
+Returns 0 on success and -1 on failure.
+====================
+*/
+static int ScanReplay( struct ReplayReader *reader ) {
+	uint64_t	position = REPLAY_HEADER_LENGTH;
+	int			maxKeyframes = 0;
+	int			type;
+	int			length;
+	void *		index;
+
+	reader->numKeyframes = 0;
+	reader->numTicks = 0;
+	while( position + REPLAY_RECORD_HEADER_LENGTH <= reader->length ) {
+		length = SDLNet_Read16( &reader->map[position + 2] );
+		// The file ends in zeros where the recording stopped.
+		if( length < REPLAY_RECORD_HEADER_LENGTH || position + length > reader->length ) {
+			break;
+		}
+		type = SDLNet_Read16( &reader->map[position] );
+		if( type == RR_KEYFRAME || type == RR_TICK ) {
+			reader->numTicks = SDLNet_Read32( &reader->map[position + 4] ) + 1;
+		}
+		if( type == RR_KEYFRAME ) {
+			if( reader->numKeyframes == maxKeyframes ) {
+				maxKeyframes = maxKeyframes * 2 + 16;
+				index = realloc( reader->index, maxKeyframes * sizeof( struct ReplayKeyframe ) );
+				if( !index ) {
+					return -1;
+				}
+				reader->index = index;
+			}
+			reader->index[reader->numKeyframes].tick = SDLNet_Read32( &reader->map[position + 4] );
+			reader->index[reader->numKeyframes].offset = position;
+			reader->numKeyframes++;
+		}
+		position += length;
+		if( type == RR_QUIT ) {
+			break;
+		}
+	}
+	reader->end = position;
+	return 0;
+}
+
+/*
+====================
+CloseReplayReader
+
+Unmaps the replay file.
+====================
+*/
+void CloseReplayReader( struct ReplayReader *reader ) {
+#ifdef REPLAY_MMAP
+	if( reader->map ) {
+		munmap( ( void * )reader->map, reader->length );
+	}
+	if( reader->fd != -1 ) {
+		close( reader->fd );
+	}
+#else
+	free( ( void * )reader->map );
+#endif
+	free( reader->index );
+	memset( reader, 0, sizeof( *reader ) );
+	reader->fd = -1;
+}
+
+/*
+====================
+ApplyGeometry
+
+Decodes the snapshot of an RR_TICK or RR_KEYFRAME record into state.
+Returns 0 on success and -1 on failure.
+====================
+*/
+static int ApplyGeometry( struct ReplayReader *reader, struct GameState *state, const char *args, int length, int isKeyframe ) {
+	struct Snapshot	snapshot;
+	int				offset = 0;
+	int				player;
+
+	if( isKeyframe ) {
+		offset = 4 + 4 * reader->numPlayers;
+		if( length < offset ) {
+			return -1;
+		}
+		state->lastHit = ( int )SDLNet_Read32( &args[0] );
+		for( player = 0; player < reader->numPlayers; player++ ) {
+			state->players[player].score = SDLNet_Read32( &args[4 + 4 * player] );
+		}
+	}
+	if( DecodeSnapshot( &snapshot, &reader->history, reader->numPlayers, &args[offset], length - offset ) ) {
+		return -1;
+	}
+	StoreSnapshot( &reader->history, &snapshot );
+
+	state->ball = snapshot.ball;
+	for( player = 0; player < reader->numPlayers; player++ ) {
+		state->players[player].position = snapshot.positions[player];
+	}
+	reader->tick = snapshot.sequence - 1;
+	reader->hasTick = 1;
+	return 0;
+}
+
+/*
+====================
+ReadReplayTick
+
+Plays the next tick of a replay into state. Hits and points call their event handlers,
+unless isQuiet is set. Returns 0 on success, -2 when the game is over and -1 if the
+file is broken.
+====================
+*/
+int ReadReplayTick( struct ReplayReader *reader, struct GameState *state, int isQuiet ) {
+	const char *	record;
+	int				type;
+	int				length;
+	int				player;
+	int				i;
+
+	while( reader->position + REPLAY_RECORD_HEADER_LENGTH <= reader->end ) {
+		record = &reader->map[reader->position];
+		type = SDLNet_Read16( &record[0] );
+		length = SDLNet_Read16( &record[2] );
+		if( length < REPLAY_RECORD_HEADER_LENGTH || reader->position + length > reader->end ) {
+			return -1;
+		}
+		reader->position += length;
+		length -= REPLAY_RECORD_HEADER_LENGTH;
+		record += REPLAY_RECORD_HEADER_LENGTH;
+
+		switch( type ) {
+			case RR_KEYFRAME:
+			case RR_TICK:
+				return ApplyGeometry( reader, state, record, length, type == RR_KEYFRAME );
+			case RR_HIT:
+				if( length < 4 ) {
+					return -1;
+				}
+				player = ( int )SDLNet_Read32( record );
+				if( isQuiet ) {
+					state->lastHit = player;
+				} else {
+					RegisterHit( state, player );
+				}
+				break;
+			case RR_SCORE:
+				if( length < 4 + 4 * reader->numPlayers ) {
+					return -1;
+				}
+				player = ( int )SDLNet_Read32( record );
+				for( i = 0; i < reader->numPlayers; i++ ) {
+					state->players[i].score = SDLNet_Read32( &record[4 + 4 * i] );
+				}
+				if( !isQuiet ) {
+					RegisterScore( state, player );
+				}
+				break;
+			case RR_QUIT:
+				return -2;
+			default:
+				// Newer record types are skipped.
+				break;
+		}
+	}
+	return -2;
+}
+
+/*
+====================
+SeekReplay
+
+Jumps to the tick at the given time of the replay. Finds the last keyframe before it
+with a binary search on the index and plays quietly from there, so it never decodes
+more than REPLAY_KEYFRAME_INTERVAL ticks. Returns 0 on success, -2 if the replay
+ends before that time and -1 if the file is broken.
+====================
+*/
+int SeekReplay( struct ReplayReader *reader, struct GameState *state, uint32_t milliseconds ) {
+	uint32_t	tick = ( uint32_t )( ( uint64_t )milliseconds * reader->tickRate / 1000 );
+	int			low = 0;
+	int			high = reader->numKeyframes - 1;
+	int			middle;
+	int			result;
+
+	if( reader->numKeyframes == 0 || reader->index[0].tick > tick ) {
+		reader->position = REPLAY_HEADER_LENGTH;
+	} else {
+		// Finds the last keyframe whose tick isn't after the one we want.
+		while( low < high ) {
+			middle = low + ( high - low + 1 ) / 2;
+			if( reader->index[middle].tick <= tick ) {
+				low = middle;
+			} else {
+				high = middle - 1;
+			}
+		}
+		reader->position = reader->index[low].offset;
+	}
+	reader->hasTick = 0;
+
+	do {
+		result = ReadReplayTick( reader, state, 1 );
+	} while( !result && reader->tick < tick );
+	return result;
+}
+
+/*
+====================
+ReplayDuration
+
+Returns how long the recorded game lasted in milliseconds.
+====================
+*/
+uint32_t ReplayDuration( const struct ReplayReader *reader ) {
+	return ( uint32_t )( ( uint64_t )reader->numTicks * 1000 / reader->tickRate );
+}
+
+/*
+====================
+IsReplay
+
+Determines whether the program plays a replay instead of the game.
+====================
+*/
+int IsReplay( void ) {
+	return replayPlayPath != NULL;
+}
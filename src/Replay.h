@@ -0,0 +1,131 @@
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "Game.h"
+#include "Snapshot.h"
+
+#define REPLAY_MAGIC 0x4d505250u			// "MPRP"
+#define REPLAY_VERSION 2
+#define REPLAY_HEADER_LENGTH 40
+#define REPLAY_RECORD_HEADER_LENGTH 8
+#define REPLAY_INDEX_ENTRY_LENGTH 12
+#define REPLAY_KEYFRAME_INTERVAL 120		// Ticks between two keyframes, so a seek decodes at most this many
+#define REPLAY_GROWTH ( 1 << 20 )			// Bytes the file grows by whenever the mapping is full
+#define REPLAY_MAX_SPEED 1000
+
+/*
+==========================================================
+
+A replay file records one game tick by tick. All numbers are
+big endian, like on the wire. It starts with a header:
+	Name		Length	Description
+	Magic		4		REPLAY_MAGIC
+	Version		4		REPLAY_VERSION
+	Players		4		The amount of players
+	TickRate	4		Ticks per second of the recording
+	Index		8		Offset of the index, 0 if the recording
+						wasn't closed properly
+	Keyframes	4		Amount of entries in the index
+	Ticks		4		Amount of ticks recorded, 0 if the recording
+						wasn't closed properly
+	Seed		8		The seed of the game, see GameState
+It is followed by the records, which all look like this:
+	Type		2		See enum ReplayRecordType
+	Len			2		The length of the whole record in bytes
+	Tick		4		The tick the record belongs to
+	Args		Len-8	Depending on the type
+The events of a tick come before its geometry. At the end is
+the index, Tick (4) and Offset (8) of every keyframe, sorted
+by tick.
+
+==========================================================
+*/
+enum ReplayRecordType {
+	RR_KEYFRAME,	// Geometry that needs nothing before it (+last_hit+scores+full snapshot)
+	RR_TICK,		// Geometry (+snapshot encoded against the previous tick)
+	RR_HIT,			// The ball hit a paddle (+player_id)
+	RR_SCORE,		// New score (+scores)
+	RR_QUIT			// The game is over
+};
+
+/*
+==========================================================
+
+Where a keyframe is in the replay file.
+
+==========================================================
+*/
+struct ReplayKeyframe {
+	uint32_t	tick;
+	uint64_t	offset;
+};
+
+/*
+==========================================================
+
+Records a game into a replay file. The file is mapped into
+memory and grows in steps of REPLAY_GROWTH bytes, so that
+recording a tick is a memcpy and never waits for the disk.
+The geometry is stored as snapshots, with the same precision
+as it is sent to the clients.
+
+==========================================================
+*/
+struct ReplayWriter {
+	int						isOpen;
+	int						fd;
+	FILE *					file;			// Where the recording goes at the end if files can't be mapped
+	char *					map;			// The mapped file, or the whole recording in memory
+	uint64_t				mapLength;		// Bytes mapped, the file is this long while recording
+	uint64_t				length;			// Bytes recorded so far
+	int						numPlayers;
+	int						tickRate;
+	uint32_t				tick;			// The tick that is being simulated
+	struct Snapshot			previous;		// Geometry of the last tick that was recorded
+	int						hasPrevious;	// A boolean value which is 1 if previous is the tick before this one
+	struct ReplayKeyframe *	index;
+	int						numKeyframes;
+	int						maxKeyframes;
+	int						hasQuit;		// A boolean value which is 1 once RR_QUIT is recorded
+};
+
+/*
+==========================================================
+
+Plays a replay file back. The whole file is mapped, so
+reading a tick is decoding it in place.
+
+==========================================================
+*/
+struct ReplayReader {
+	int						fd;
+	const char *			map;
+	uint64_t				length;			// Bytes in the file
+	uint64_t				end;			// Where the records end
+	uint64_t				position;		// Offset of the next record
+	int						numPlayers;
+	int						tickRate;
+	uint32_t				numTicks;		// How many ticks were recorded
+	uint64_t				seed;			// The seed of the recorded game
+	uint32_t				tick;			// The tick of the geometry read last
+	int						hasTick;		// A boolean value which is 0 until the first geometry is read
+	struct SnapshotHistory	history;
+	struct ReplayKeyframe *	index;
+	int						numKeyframes;
+};
+
+void		InitializeReplay( void );
+int			OpenReplayWriter( struct ReplayWriter *writer, const char *path, const struct GameState *state, int tickRate );
+void		CloseReplayWriter( struct ReplayWriter *writer );
+void		SelectReplayWriter( struct ReplayWriter *writer );
+void		RecordTick( const struct GameState *state );
+int			OpenReplayReader( struct ReplayReader *reader, const char *path, struct GameState *state );
+void		CloseReplayReader( struct ReplayReader *reader );
+int			ReadReplayTick( struct ReplayReader *reader, struct GameState *state, int isQuiet );
+int			SeekReplay( struct ReplayReader *reader, struct GameState *state, uint32_t milliseconds );
+uint32_t	ReplayDuration( const struct ReplayReader *reader );
+int			IsReplay( void );
+
+#endif
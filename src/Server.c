@@ -0,0 +1,515 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+#include "Server.h"
+#include "Main.h"
+#include "Game.h"
+#include "Network.h"
+#include "Relay.h"
+#include "Replay.h"
+#include "Random.h"
+#include "Debug/Debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_net.h>
+
+// DEFINITIONS
+
+#define LOBBY_WAIT 50				// Milliseconds a worker sleeps if none of its matches has a tick due
+#define BENCHMARK_SINK_PORT ( ( uint16_t )( NETWORK_STANDARD_SERVER_PORT - 1 ) )	// Where the snapshots of simulated clients go
+
+// TYPES
+
+/*
+==========================================================
+
+Whether a match waits for its players or plays.
+
+==========================================================
+*/
+enum MatchPhase {
+	MP_LOBBY,
+	MP_RUNNING
+};
+
+/*
+==========================================================
+
+One match of a dedicated server. Its network context is
+only ever selected by the worker thread that owns it. When a
+match ends, the same ports open a new lobby.
+
+==========================================================
+*/
+struct Match {
+	struct NetworkContext *	network;		// NULL if the match couldn't open its ports
+	struct GameState		state;
+	enum MatchPhase			phase;
+	double					accumulator;	// Seconds of game time that haven't been simulated yet
+	uint64_t				lastTime;		// SDL_GetPerformanceCounter() when the accumulator was last filled
+	uint16_t				port;			// TCP port of the lobby, the game uses the UDP port after it
+	unsigned long			numTicks;		// Ticks run by a benchmark
+	struct ReplayWriter		replay;			// Records the running game if --record is set
+	int						numGames;		// Games started so far, names the replay files
+};
+
+/*
+==========================================================
+
+A thread that runs a fixed share of the matches, pinned to
+one processor so its matches stay in that processor's cache.
+
+==========================================================
+*/
+struct Worker {
+	SDL_Thread *	thread;
+	int				cpu;			// The processor the thread runs on
+	struct Match *	matches;		// The first match of this worker's share
+	int				numMatches;
+	int				isFlatOut;		// Tick every match as often as possible instead of on time, for benchmarks
+	SDL_atomic_t *	stop;			// Set to 1 when all workers should return
+};
+
+// VARIABLES
+
+int				serverMatches = 1;		// Set with --matches
+int				serverThreads = 0;		// Set with --threads, 0 means one per processor
+
+// Imported from Game.
+extern int		gameTickRate;
+extern int		gameSnapshotRate;
+extern int		gameDedicatedPlayers;
+// Imported from Relay.
+extern uint16_t	relayPort;
+// Imported from Replay.
+extern const char *	replayRecordPath;
+
+// FUNCTIONS
+
+static int		OpenMatch( struct Match *match, uint16_t port, struct SpectatorFeed *feed );
+static void		CloseMatch( struct Match *match );
+static void		StartMatch( struct Match *match );
+static void		ProcessMatch( struct Match *match );
+static double	MatchWait( const struct Match *match );
+static int		CountNamedPlayers( void );
+static void		PinThread( int cpu );
+static int		WorkerThread( void *data );
+static int		RunWorkers( struct Match *matches, int numMatches, int numWorkers, int isFlatOut, unsigned int duration );
+
+/*
+====================
+OpenMatch
+
+Creates the network context of a match and opens its lobby on the given port.
+Its games are published to feed, which may be NULL.
+====================
+*/
+static int OpenMatch( struct Match *match, uint16_t port, struct SpectatorFeed *feed ) {
+	memset( match, 0, sizeof( *match ) );
+	match->port = port;
+	match->network = CreateNetworkContext();
+	if( !match->network ) {
+		return -1;
+	}
+
+	SelectNetworkContext( match->network );
+	if( Connect( 1, NULL, port ) ) {
+		DebugPrintF( "Could not open port %d for a match.", port );
+		SelectNetworkContext( NULL );
+		DestroyNetworkContext( match->network );
+		match->network = NULL;
+		return -1;
+	}
+	SetSpectatorFeed( feed );
+	SelectNetworkContext( NULL );
+	match->phase = MP_LOBBY;
+	return 0;
+}
+
+/*
+====================
+CloseMatch
+
+Disconnects everybody from a match and frees it.
+====================
+*/
+static void CloseMatch( struct Match *match ) {
+	if( !match->network ) {
+		return;
+	}
+	SelectNetworkContext( match->network );
+	Disconnect();
+	SelectNetworkContext( NULL );
+	DestroyNetworkContext( match->network );
+	match->network = NULL;
+	CloseReplayWriter( &match->replay );
+	free( match->state.players );
+	match->state.players = NULL;
+}
+
+/*
+====================
+StartMatch
+
+Starts the game with everybody who is in the lobby of the selected match. With --record,
+every game goes to a file of its own, named after the record path, the port and the game.
+====================
+*/
+static void StartMatch( struct Match *match ) {
+	char path[FILENAME_MAX];
+
+	// Matches start in any order on any thread, so the seed is keyed by which game of which match this is.
+	InitializeGameState( &match->state, RANDOM_COUNTER( match->port, match->numGames ) );
+	SetNetworkRates( gameTickRate, gameSnapshotRate );
+	NetworkStartGame( match->port + 1 );
+	match->phase = MP_RUNNING;
+	match->accumulator = 0.0;
+	match->lastTime = SDL_GetPerformanceCounter();
+	match->numGames++;
+	DebugPrintF( "Match on port %d started with %d players.", match->port, match->state.numPlayers );
+
+	if( replayRecordPath ) {
+		snprintf( path, sizeof( path ), "%s-%d-%d", replayRecordPath, match->port, match->numGames );
+		if( !OpenReplayWriter( &match->replay, path, &match->state, gameTickRate ) ) {
+			SelectReplayWriter( &match->replay );
+		}
+	}
+}
+
+/*
+====================
+ProcessMatch
+
+Handles the lobby of the selected match, or runs the ticks that are due. When a game
+ends, the match opens a new lobby on the same ports.
+====================
+*/
+static void ProcessMatch( struct Match *match ) {
+	uint64_t now;
+
+	if( match->phase == MP_LOBBY ) {
+		ProcessLobby();
+		if( CountNamedPlayers() >= gameDedicatedPlayers ) {
+			StartMatch( match );
+		}
+		return;
+	}
+
+	now = SDL_GetPerformanceCounter();
+	match->accumulator += ( now - match->lastTime ) / ( double )SDL_GetPerformanceFrequency();
+	match->lastTime = now;
+	if( RunServerTicks( &match->state, NULL, &match->accumulator ) == -2 ) {
+		DebugPrintF( "Match on port %d is over.", match->port );
+		CloseReplayWriter( &match->replay );
+		Disconnect();
+		if( Connect( 1, NULL, match->port ) ) {
+			DebugPrintF( "Could not open port %d for the next match.", match->port );
+			CloseMatch( match );
+			return;
+		}
+		match->phase = MP_LOBBY;
+	}
+}
+
+/*
+====================
+MatchWait
+
+Returns the seconds until a match needs its worker again.
+====================
+*/
+static double MatchWait( const struct Match *match ) {
+	double elapsed;
+
+	if( match->phase == MP_LOBBY ) {
+		return LOBBY_WAIT / 1000.0;
+	}
+	elapsed = ( SDL_GetPerformanceCounter() - match->lastTime ) / ( double )SDL_GetPerformanceFrequency();
+	return 1.0 / gameTickRate - match->accumulator - elapsed;
+}
+
+/*
+====================
+CountNamedPlayers
+
+Returns how many players in the lobby of the selected match have told us their names.
+====================
+*/
+static int CountNamedPlayers( void ) {
+	char *	playerNames[MAX_PLAYERS];
+	int		numPlayers = 0;
+	int		numNamed = 0;
+	int		i;
+
+	GetPlayerList( playerNames, &numPlayers );
+	for( i = 0; i < numPlayers; i++ ) {
+		if( playerNames[i] ) {
+			numNamed++;
+		}
+	}
+	return numNamed;
+}
+
+/*
+====================
+PinThread
+
+Keeps the calling thread on one processor. Does nothing where we don't know how.
+====================
+*/
+static void PinThread( int cpu ) {
+#ifdef __linux__
+	cpu_set_t set;
+
+	CPU_ZERO( &set );
+	CPU_SET( cpu % CPU_SETSIZE, &set );
+	if( sched_setaffinity( 0, sizeof( set ), &set ) ) {
+		DebugPrintF( "Could not pin a worker to processor %d.", cpu );
+	}
+#endif
+}
+
+/*
+====================
+WorkerThread
+
+Runs the matches of one worker until stop is set or none of them is open anymore.
+A worker that has a single match sleeps on its sockets, otherwise it sleeps until
+the next tick of any of its matches is due.
+====================
+*/
+static int WorkerThread( void *data ) {
+	struct Worker *	worker = data;
+	struct Match *	match;
+	double			wait;
+	int				numOpen;
+	int				i;
+
+	PinThread( worker->cpu );
+
+	while( !SDL_AtomicGet( worker->stop ) ) {
+		wait = LOBBY_WAIT / 1000.0;
+		numOpen = 0;
+		for( i = 0; i < worker->numMatches; i++ ) {
+			match = &worker->matches[i];
+			if( !match->network ) {
+				continue;
+			}
+			SelectNetworkContext( match->network );
+			SelectReplayWriter( &match->replay );
+			if( worker->isFlatOut ) {
+				match->accumulator = 1.0 / gameTickRate;
+				RunServerTicks( &match->state, NULL, &match->accumulator );
+				match->numTicks++;
+			} else {
+				ProcessMatch( match );
+			}
+			if( match->network ) {
+				wait = SDL_min( wait, MatchWait( match ) );
+				numOpen++;
+			}
+		}
+		if( !numOpen ) {
+			break;
+		}
+		if( worker->isFlatOut ) {
+			continue;
+		}
+
+		match = &worker->matches[0];
+		if( worker->numMatches == 1 ) {
+			// Handles incoming packets while it waits, just like a single game does.
+			if( wait * 1000.0 >= 1.0 ) {
+				WaitForNetwork( match->phase == MP_RUNNING ? &match->state : NULL, ( unsigned int )( wait * 1000.0 ) );
+			}
+		} else if( wait * 1000.0 >= 1.0 ) {
+			SDL_Delay( ( unsigned int )( wait * 1000.0 ) );
+		}
+	}
+
+	SelectNetworkContext( NULL );
+	SelectReplayWriter( NULL );
+	return 0;
+}
+
+/*
+====================
+RunWorkers
+
+Splits the matches evenly between numWorkers threads and runs them for duration
+milliseconds, or until no match is open anymore if duration is 0.
+====================
+*/
+static int RunWorkers( struct Match *matches, int numMatches, int numWorkers, int isFlatOut, unsigned int duration ) {
+	struct Worker *	workers;
+	SDL_atomic_t	stop;
+	int				numCpus = SDL_GetCPUCount();
+	int				first = 0;
+	int				i;
+
+	if( numWorkers > numMatches ) {
+		numWorkers = numMatches;
+	}
+	workers = calloc( numWorkers, sizeof( struct Worker ) );
+	if( !workers ) {
+		return -1;
+	}
+	SDL_AtomicSet( &stop, 0 );
+
+	for( i = 0; i < numWorkers; i++ ) {
+		workers[i].cpu = i % ( numCpus > 0 ? numCpus : 1 );
+		workers[i].matches = &matches[first];
+		workers[i].numMatches = ( i + 1 ) * numMatches / numWorkers - first;
+		workers[i].isFlatOut = isFlatOut;
+		workers[i].stop = &stop;
+		first += workers[i].numMatches;
+		workers[i].thread = SDL_CreateThread( &WorkerThread, "Worker", &workers[i] );
+		DebugAssert( workers[i].thread );
+	}
+
+	if( duration ) {
+		SDL_Delay( duration );
+		SDL_AtomicSet( &stop, 1 );
+	}
+	for( i = 0; i < numWorkers; i++ ) {
+		if( workers[i].thread ) {
+			SDL_WaitThread( workers[i].thread, NULL );
+		}
+	}
+
+	free( workers );
+	return 0;
+}
+
+/*
+====================
+RunMatchServer
+
+Hosts numMatches matches at once on numWorkers threads, match i on port
+NETWORK_STANDARD_SERVER_PORT + MATCH_PORT_STRIDE * i. Every match waits for
+gameDedicatedPlayers players, plays, and then waits for the next ones.
+Spectators of all matches connect to relayPort. Returns when no match can
+be hosted anymore.
+====================
+*/
+int RunMatchServer( int numMatches, int numWorkers ) {
+	struct Match *			matches = calloc( numMatches, sizeof( struct Match ) );
+	struct SpectatorFeed **	feeds = calloc( numMatches, sizeof( struct SpectatorFeed * ) );
+	struct Relay			relay;
+	int						isRelaying;
+	int						numOpen = 0;
+	int						i;
+
+	if( !matches || !feeds ) {
+		free( matches );
+		free( feeds );
+		return -1;
+	}
+	for( i = 0; i < numMatches; i++ ) {
+		feeds[i] = CreateSpectatorFeed();
+		if( !OpenMatch( &matches[i], NETWORK_STANDARD_SERVER_PORT + MATCH_PORT_STRIDE * i, feeds[i] ) ) {
+			numOpen++;
+		}
+	}
+	DebugPrintF( "Dedicated server hosts %d matches of %d players on %d threads.", numOpen, gameDedicatedPlayers, numWorkers );
+
+	// The matches go on without spectators if they can't have any.
+	isRelaying = !StartRelay( &relay, relayPort, feeds, numMatches );
+	if( isRelaying ) {
+		DebugPrintF( "Spectators can watch on port %d.", relayPort );
+	}
+
+	if( numOpen ) {
+		RunWorkers( matches, numMatches, numWorkers, 0, 0 );
+	}
+
+	if( isRelaying ) {
+		StopRelay( &relay );
+	}
+	for( i = 0; i < numMatches; i++ ) {
+		CloseMatch( &matches[i] );
+		DestroySpectatorFeed( feeds[i] );
+	}
+	free( matches );
+	free( feeds );
+	return numOpen ? 0 : -1;
+}
+
+/*
+====================
+BenchmarkMatchServer
+
+Runs numMatches games of numPlayers simulated clients each on numWorkers threads
+for duration milliseconds, ticking every match as fast as possible. Snapshots go
+out to a local socket, just like they would to real clients. Writes how many
+ticks all matches together ran per second into ticksPerSecond.
+====================
+*/
+int BenchmarkMatchServer( int numMatches, int numWorkers, int numPlayers, unsigned int duration, double *ticksPerSecond ) {
+	struct Match *	matches = calloc( numMatches, sizeof( struct Match ) );
+	UDPsocket		sink;
+	unsigned long	numTicks = 0;
+	uint64_t		start;
+	double			seconds;
+	int				i;
+	int				player;
+
+	if( !matches ) {
+		return -1;
+	}
+	// Nobody reads from here, the kernel drops what doesn't fit.
+	sink = SDLNet_UDP_Open( BENCHMARK_SINK_PORT );
+	if( !sink ) {
+		DebugPrintF( "Could not open port %d for the benchmark.", BENCHMARK_SINK_PORT );
+		free( matches );
+		return -1;
+	}
+
+	for( i = 0; i < numMatches; i++ ) {
+		if( OpenMatch( &matches[i], NETWORK_STANDARD_SERVER_PORT + MATCH_PORT_STRIDE * i, NULL ) ) {
+			continue;
+		}
+		SelectNetworkContext( matches[i].network );
+		for( player = 0; player < numPlayers; player++ ) {
+			AddSimulatedClient( BENCHMARK_SINK_PORT );
+		}
+		StartMatch( &matches[i] );
+		SelectNetworkContext( NULL );
+	}
+
+	start = SDL_GetPerformanceCounter();
+	RunWorkers( matches, numMatches, numWorkers, 1, duration );
+	seconds = ( SDL_GetPerformanceCounter() - start ) / ( double )SDL_GetPerformanceFrequency();
+
+	for( i = 0; i < numMatches; i++ ) {
+		numTicks += matches[i].numTicks;
+		CloseMatch( &matches[i] );
+	}
+	free( matches );
+	SDLNet_UDP_Close( sink );
+
+	*ticksPerSecond = numTicks / seconds;
+	return 0;
+}
+
+/*
+====================
+RunDedicatedServer
+
+Hosts serverMatches matches without graphics, audio or a player of our own,
+on serverThreads worker threads.
+====================
+*/
+enum ProgramState RunDedicatedServer( void ) {
+	int numWorkers = serverThreads;
+
+	if( numWorkers <= 0 ) {
+		numWorkers = SDL_GetCPUCount() > 0 ? SDL_GetCPUCount() : 1;
+	}
+	RunMatchServer( serverMatches, numWorkers );
+	return PS_QUIT;
+}
@@ -0,0 +1,11 @@
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#define MATCH_PORT_STRIDE 2			// Match i listens on NETWORK_STANDARD_SERVER_PORT + 2 * i and plays on the UDP port after it
+#define MAX_MATCHES 1000
+
+enum ProgramState	RunDedicatedServer( void );
+int					RunMatchServer( int numMatches, int numWorkers );
+int					BenchmarkMatchServer( int numMatches, int numWorkers, int numPlayers, unsigned int duration, double *ticksPerSecond );
+
+#endif
@@ -0,0 +1,393 @@
+#include "Simulation.h"
+#include "Random.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Everything in here depends on its arguments only: no SDL, no globals and no rand(),
+ * so that matches can run on any thread and a seed always gives the same match. The
+ * paddles and the ball move by the same code as in the game, see Motion.h. */
+
+// FUNCTIONS
+
+static float	SimulationRandom( void *data );
+static void		SimulationHit( void *data, int player, float spot );
+static void		SimulationMiss( void *data, int player );
+static void		SimulationWall( void *data );
+static void		ServeSimulatedBall( struct SimulationMatch *match );
+static void		DrawAims( struct SimulationMatch *match );
+static void		EndRally( struct SimulationMatch *match, int player );
+
+static const struct BallHandlers simulationHandlers = { &SimulationRandom, &SimulationHit, &SimulationMiss, &SimulationWall, NULL };
+
+/*
+====================
+GetDefaultSimulationParameters
+
+Fills in the parameters the game itself plays with.
+====================
+*/
+void GetDefaultSimulationParameters( struct SimulationParameters *parameters ) {
+	parameters->tickRate = DEFAULT_TICK_RATE;
+	parameters->physics = *GetDefaultPhysicsParameters();
+	parameters->pointsToWin = SIMULATION_POINTS_TO_WIN;
+	parameters->maxTicks = SIMULATION_MAX_SECONDS * DEFAULT_TICK_RATE;
+}
+
+/*
+====================
+ParseSimulationParameters
+
+Changes the parameters given in a comma separated list of settings, e.g.
+"speed=1.2,acceleration=5,deflection=15,points=7". The names are tickrate, speed,
+radius, paddle, tolerance, acceleration, maxspeed, braking, deflection, points and
+seconds. Returns -1 and leaves parameters alone if the list is invalid.
+====================
+*/
+int ParseSimulationParameters( const char *value, struct SimulationParameters *parameters ) {
+	struct SimulationParameters	parsed = *parameters;
+	double						seconds = parameters->maxTicks / ( double )parameters->tickRate;
+	char						name[16];
+	double						number;
+	int							consumed;
+
+	while( *value ) {
+		if( sscanf( value, "%15[a-z]=%lf%n", name, &number, &consumed ) != 2 || number < 0.0 ) {
+			return -1;
+		}
+		if( !strcmp( name, "tickrate" ) && number >= 1.0 && number <= MAX_TICK_RATE ) {
+			parsed.tickRate = ( int )number;
+		} else if( !strcmp( name, "speed" ) && number > 0.0 ) {
+			parsed.physics.ballSpeed = ( float )number;
+		} else if( !strcmp( name, "radius" ) && number > 0.0 && number < ARENA_EXTENT ) {
+			parsed.physics.ballRadius = ( float )number;
+		} else if( !strcmp( name, "paddle" ) && number > 0.0 && number <= 1.0 ) {
+			parsed.physics.paddleSize = ( float )number;
+		} else if( !strcmp( name, "tolerance" ) ) {
+			parsed.physics.paddleTolerance = ( float )number;
+		} else if( !strcmp( name, "acceleration" ) ) {
+			parsed.physics.paddleAcceleration = ( float )number;
+		} else if( !strcmp( name, "maxspeed" ) && number > 0.0 ) {
+			parsed.physics.paddleMaxSpeed = ( float )number;
+		} else if( !strcmp( name, "braking" ) ) {
+			parsed.physics.paddleBraking = ( float )number;
+		} else if( !strcmp( name, "deflection" ) && number < 90.0 ) {
+			parsed.physics.deflectionDegrees = ( float )number;
+		} else if( !strcmp( name, "points" ) && number >= 1.0 ) {
+			parsed.pointsToWin = ( int )number;
+		} else if( !strcmp( name, "seconds" ) && number > 0.0 ) {
+			seconds = number;
+		} else {
+			return -1;
+		}
+
+		value += consumed;
+		if( *value == ',' ) {
+			value++;
+		} else if( *value ) {
+			return -1;
+		}
+	}
+
+	parsed.maxTicks = ( int )( seconds * parsed.tickRate );
+	*parameters = parsed;
+	return 0;
+}
+
+/*
+====================
+SimulationRandom
+
+Returns the next random number between 0 and 1 of the match, like DrawRandom in Physics.c.
+====================
+*/
+static float SimulationRandom( void *data ) {
+	struct SimulationMatch *match = data;
+
+	return GetRandomFloat( match->seed, RANDOM_COUNTER( match->tick, match->numDraws++ ) );
+}
+
+/*
+====================
+InitializeSimulationMatch
+
+Sets up a match of as many players as the arena has, with its first serve. The seed decides
+everything that is left to chance. What happens is added to statistics.
+====================
+*/
+void InitializeSimulationMatch( struct SimulationMatch *match, const struct SimulationParameters *parameters, const struct ArenaGeometry *arena, struct SimulationStatistics *statistics, uint64_t seed ) {
+	memset( match, 0, sizeof( *match ) );
+	match->parameters = parameters;
+	match->arena = arena;
+	match->statistics = statistics;
+	match->numPlayers = arena->numPlayers;
+	match->seed = seed;
+	ServeSimulatedBall( match );
+}
+
+/*
+====================
+DrawAims
+
+Draws where every bot aims until the next serve or hit.
+====================
+*/
+static void DrawAims( struct SimulationMatch *match ) {
+	int player;
+
+	for( player = 0; player < match->numPlayers; player++ ) {
+		match->aim[player] = 2.0f * SimulationRandom( match ) - 1.0f;
+	}
+}
+
+/*
+====================
+ServeSimulatedBall
+
+Serves the ball like the game does and starts a new rally.
+====================
+*/
+static void ServeSimulatedBall( struct SimulationMatch *match ) {
+	struct BallHandlers handlers = simulationHandlers;
+
+	handlers.data = match;
+	ServeBall( &match->parameters->physics, match->arena, &match->ball, &handlers );
+	match->lastHit = -1;
+	match->rallyHits = 0;
+	match->rallyStart = match->tick;
+	DrawAims( match );
+}
+
+/*
+====================
+EndRally
+
+Counts the rally that player just lost and gives the player who hit the ball last a point.
+====================
+*/
+static void EndRally( struct SimulationMatch *match, int player ) {
+	struct SimulationStatistics *statistics = match->statistics;
+
+	statistics->misses[player]++;
+	if( match->lastHit >= 0 ) {
+		match->players[match->lastHit].score++;
+		statistics->points[match->lastHit]++;
+	} else {
+		statistics->numUnclaimed++;
+	}
+	statistics->numRallies++;
+	statistics->rallyHits[match->rallyHits < SIMULATION_RALLY_BINS ? match->rallyHits : SIMULATION_RALLY_BINS - 1]++;
+	statistics->rallyTicks += match->tick + 1 - match->rallyStart;
+}
+
+/*
+====================
+SimulationHit
+
+Counts a hit of player at spot and draws new aims.
+====================
+*/
+static void SimulationHit( void *data, int player, float spot ) {
+	struct SimulationMatch *	match = data;
+	int							bin = ( int )( spot * SIMULATION_HIT_BINS );
+
+	match->lastHit = player;
+	match->rallyHits++;
+	match->statistics->numHits++;
+	match->statistics->hits[player]++;
+	match->statistics->hitSpots[bin < 0 ? 0 : bin >= SIMULATION_HIT_BINS ? SIMULATION_HIT_BINS - 1 : bin]++;
+	DrawAims( match );
+}
+
+/*
+====================
+SimulationMiss
+
+Ends the rally that player lost and serves the ball again.
+====================
+*/
+static void SimulationMiss( void *data, int player ) {
+	EndRally( data, player );
+	ServeSimulatedBall( data );
+}
+
+/*
+====================
+SimulationWall
+
+Counts a bounce off a wall.
+====================
+*/
+static void SimulationWall( void *data ) {
+	( ( struct SimulationMatch * )data )->statistics->numWalls++;
+}
+
+/*
+====================
+StepSimulationMatch
+
+Runs one tick of the match: asks the policy for every player's input, moves the paddles and then the ball.
+====================
+*/
+void StepSimulationMatch( struct SimulationMatch *match, botPolicy_t policy, const void *data ) {
+	struct BallHandlers	handlers = simulationHandlers;
+	float				deltaSeconds = 1.0f / match->parameters->tickRate;
+	int					player;
+
+	for( player = 0; player < match->numPlayers; player++ ) {
+		MovePaddle( &match->parameters->physics, &match->players[player], policy( match, player, data ), deltaSeconds );
+	}
+	handlers.data = match;
+	MoveBall( &match->parameters->physics, match->arena, match->players, &match->ball, deltaSeconds, &handlers );
+	match->tick++;
+	match->numDraws = 0;
+	match->statistics->numTicks++;
+}
+
+/*
+====================
+RunSimulationMatch
+
+Plays the match until somebody has pointsToWin points or maxTicks have passed. Returns the
+winner, or -1 if the match was cut off.
+====================
+*/
+int RunSimulationMatch( struct SimulationMatch *match, botPolicy_t policy, const void *data ) {
+	int winner = -1;
+	int player;
+
+	while( winner == -1 && match->tick < match->parameters->maxTicks ) {
+		StepSimulationMatch( match, policy, data );
+		for( player = 0; player < match->numPlayers; player++ ) {
+			if( match->players[player].score >= match->parameters->pointsToWin ) {
+				winner = player;
+			}
+		}
+	}
+
+	match->statistics->numMatches++;
+	if( winner == -1 ) {
+		match->statistics->numTimeouts++;
+	} else {
+		match->statistics->wins[winner]++;
+	}
+	return winner;
+}
+
+/*
+====================
+TrackingBot
+
+A policy that moves the paddle to where the ball will cross the player's line if it flies
+towards it, and back to the middle if not. It doesn't see bounces coming. data is a
+struct TrackingBotSkill.
+====================
+*/
+int TrackingBot( const struct SimulationMatch *match, int player, const void *data ) {
+	const struct TrackingBotSkill *	skill = data;
+	const struct ArenaSegment *		segment = &match->arena->segments[player];
+	const struct Ball *				ball = &match->ball;
+	float							approach = ball->direction.dx * segment->normal.dx + ball->direction.dy * segment->normal.dy;
+	float							target = 0.5f;
+	float							seconds;
+	float							x;
+	float							y;
+	float							position;
+
+	if( approach < 0.0f ) {
+		seconds = ( ball->position.x * segment->normal.dx + ball->position.y * segment->normal.dy - segment->offset - match->parameters->physics.ballRadius ) / -approach;
+		x = ball->position.x + ball->direction.dx * seconds;
+		y = ball->position.y + ball->direction.dy * seconds;
+		target = ( ( x - segment->start.x ) * segment->direction.dx + ( y - segment->start.y ) * segment->direction.dy ) * segment->inverseLength;
+	}
+
+	// Compare the middle of the paddle, shifted by where the bot aims, with the target.
+	position = match->players[player].position + match->parameters->physics.paddleSize * ( 1.0f + match->aim[player] * skill->aimSpread ) / 2.0f;
+	if( target > position + skill->deadZone ) {
+		return 1;
+	}
+	if( target < position - skill->deadZone ) {
+		return -1;
+	}
+	return 0;
+}
+
+/*
+====================
+AddSimulationStatistics
+
+Adds statistics to total, e.g. those of one thread to those of all of them.
+====================
+*/
+void AddSimulationStatistics( struct SimulationStatistics *total, const struct SimulationStatistics *statistics ) {
+	int i;
+
+	total->numMatches += statistics->numMatches;
+	total->numTimeouts += statistics->numTimeouts;
+	total->numTicks += statistics->numTicks;
+	total->numRallies += statistics->numRallies;
+	total->numHits += statistics->numHits;
+	total->numWalls += statistics->numWalls;
+	total->numUnclaimed += statistics->numUnclaimed;
+	total->rallyTicks += statistics->rallyTicks;
+	for( i = 0; i < MAX_PLAYERS; i++ ) {
+		total->points[i] += statistics->points[i];
+		total->hits[i] += statistics->hits[i];
+		total->misses[i] += statistics->misses[i];
+		total->wins[i] += statistics->wins[i];
+	}
+	for( i = 0; i < SIMULATION_RALLY_BINS; i++ ) {
+		total->rallyHits[i] += statistics->rallyHits[i];
+	}
+	for( i = 0; i < SIMULATION_HIT_BINS; i++ ) {
+		total->hitSpots[i] += statistics->hitSpots[i];
+	}
+}
+
+/*
+====================
+WriteSimulationStatistics
+
+Writes the statistics of matches of numPlayers players with the given parameters to a text
+file, one value per line after its name. Returns 0 on success and -1 on failure.
+====================
+*/
+int WriteSimulationStatistics( const char *path, const struct SimulationStatistics *statistics, const struct SimulationParameters *parameters, int numPlayers ) {
+	FILE *	file = fopen( path, "w" );
+	double	rallies = statistics->numRallies ? ( double )statistics->numRallies : 1.0;
+	int		i;
+
+	if( !file ) {
+		return -1;
+	}
+	fprintf( file, "# Parameters\n" );
+	fprintf( file, "players %d\ntickrate %d\nspeed %g\nradius %g\npaddle %g\ntolerance %g\n", numPlayers, parameters->tickRate, parameters->physics.ballSpeed, parameters->physics.ballRadius, parameters->physics.paddleSize, parameters->physics.paddleTolerance );
+	fprintf( file, "acceleration %g\nmaxspeed %g\nbraking %g\ndeflection %g\npoints %d\nseconds %g\n", parameters->physics.paddleAcceleration, parameters->physics.paddleMaxSpeed, parameters->physics.paddleBraking, parameters->physics.deflectionDegrees, parameters->pointsToWin, parameters->maxTicks / ( double )parameters->tickRate );
+
+	fprintf( file, "\n# Totals\n" );
+	fprintf( file, "matches %llu\ntimeouts %llu\nticks %llu\nrallies %llu\nhits %llu\nwalls %llu\nunclaimed %llu\n",
+			( unsigned long long )statistics->numMatches, ( unsigned long long )statistics->numTimeouts, ( unsigned long long )statistics->numTicks,
+			( unsigned long long )statistics->numRallies, ( unsigned long long )statistics->numHits, ( unsigned long long )statistics->numWalls,
+			( unsigned long long )statistics->numUnclaimed );
+	fprintf( file, "mean_rally_hits %.4f\nmean_rally_seconds %.4f\n", statistics->numHits / rallies, statistics->rallyTicks / rallies / parameters->tickRate );
+
+	fprintf( file, "\n# Seats: seat points hits misses wins\n" );
+	for( i = 0; i < numPlayers; i++ ) {
+		fprintf( file, "seat %d %llu %llu %llu %llu\n", i, ( unsigned long long )statistics->points[i], ( unsigned long long )statistics->hits[i],
+				( unsigned long long )statistics->misses[i], ( unsigned long long )statistics->wins[i] );
+	}
+
+	fprintf( file, "\n# Rally length: hits rallies, the last line counts that many hits or more\n" );
+	for( i = 0; i < SIMULATION_RALLY_BINS; i++ ) {
+		fprintf( file, "rally %d %llu\n", i, ( unsigned long long )statistics->rallyHits[i] );
+	}
+
+	fprintf( file, "\n# Hit distribution: slice hits, from the start of the paddle's tolerance to the end of it\n" );
+	for( i = 0; i < SIMULATION_HIT_BINS; i++ ) {
+		fprintf( file, "spot %d %llu\n", i, ( unsigned long long )statistics->hitSpots[i] );
+	}
+
+	if( fclose( file ) ) {
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,113 @@
+#ifndef _SIMULATION_H
+#define _SIMULATION_H
+
+#include <stdint.h>
+#include "Game.h"
+#include "Arena.h"
+#include "Motion.h"
+
+#define SIMULATION_POINTS_TO_WIN 5		// A simulated match ends when somebody has this many points
+#define SIMULATION_MAX_SECONDS 600		// or after this long
+#define SIMULATION_RALLY_BINS 32		// Rallies of up to SIMULATION_RALLY_BINS - 1 hits are counted one by one, longer ones together
+#define SIMULATION_HIT_BINS 12			// Slices of a paddle, plus the tolerance on both sides, that hits are counted in
+
+/*
+==========================================================
+
+Everything about the rules of a match that can be tuned.
+GetDefaultSimulationParameters fills in the values the
+game uses.
+
+==========================================================
+*/
+struct SimulationParameters {
+	int							tickRate;		// Physics steps per second
+	struct PhysicsParameters	physics;		// How paddles and balls move
+	int							pointsToWin;
+	int							maxTicks;		// A match that takes longer is cut off
+};
+
+/*
+==========================================================
+
+What happened in any amount of simulated matches.
+
+==========================================================
+*/
+struct SimulationStatistics {
+	uint64_t	numMatches;
+	uint64_t	numTimeouts;						// Matches that were cut off after maxTicks
+	uint64_t	numTicks;
+	uint64_t	numRallies;							// From a serve to a miss
+	uint64_t	numHits;
+	uint64_t	numWalls;							// Bounces off the walls of the two-player arena
+	uint64_t	numUnclaimed;						// Misses before anybody hit the ball, nobody gets a point for those
+	uint64_t	points[MAX_PLAYERS];				// Per seat
+	uint64_t	hits[MAX_PLAYERS];					// Per seat
+	uint64_t	misses[MAX_PLAYERS];				// Per seat
+	uint64_t	wins[MAX_PLAYERS];					// Per seat
+	uint64_t	rallyHits[SIMULATION_RALLY_BINS];	// How many rallies had how many hits
+	uint64_t	hitSpots[SIMULATION_HIT_BINS];		// Where on the paddle, from its start to its end, the hits were
+	uint64_t	rallyTicks;							// Of all rallies together
+};
+
+struct SimulationMatch;
+
+/*
+==========================================================
+
+Decides which way a player moves their paddle in the coming
+tick: 1 for clockwise, -1 for counterclockwise or 0 for not
+at all, like the input MovePaddle takes. data is what was
+given to RunSimulationMatch.
+
+==========================================================
+*/
+typedef int ( *botPolicy_t )( const struct SimulationMatch *match, int player, const void *data );
+
+/*
+==========================================================
+
+One simulated match. It is independent of everything else,
+so any number of them can run on any number of threads.
+
+==========================================================
+*/
+struct SimulationMatch {
+	const struct SimulationParameters *	parameters;
+	const struct ArenaGeometry *		arena;
+	struct SimulationStatistics *		statistics;		// Where the match counts what happens
+	int									numPlayers;
+	struct Player						players[MAX_PLAYERS];
+	struct Ball							ball;
+	int									lastHit;		// -1 if nobody has hit the ball since the serve
+	int									tick;
+	int									rallyHits;
+	int									rallyStart;		// The tick of the serve
+	float								aim[MAX_PLAYERS];	// Between -1 and 1, drawn for every player at every serve and hit, for bots that shouldn't be perfect
+	uint64_t							seed;			// Keys the random numbers of the match, see Random.h
+	uint32_t							numDraws;		// Random numbers drawn in the current tick
+};
+
+/*
+==========================================================
+
+How well TrackingBot plays.
+
+==========================================================
+*/
+struct TrackingBotSkill {
+	float	aimSpread;		// How far off the middle of the paddle the bot aims, in half paddle sizes times aim
+	float	deadZone;		// The bot stops when its paddle is this close to where it wants it
+};
+
+void		GetDefaultSimulationParameters( struct SimulationParameters *parameters );
+int			ParseSimulationParameters( const char *value, struct SimulationParameters *parameters );
+void		InitializeSimulationMatch( struct SimulationMatch *match, const struct SimulationParameters *parameters, const struct ArenaGeometry *arena, struct SimulationStatistics *statistics, uint64_t seed );
+void		StepSimulationMatch( struct SimulationMatch *match, botPolicy_t policy, const void *data );
+int			RunSimulationMatch( struct SimulationMatch *match, botPolicy_t policy, const void *data );
+int			TrackingBot( const struct SimulationMatch *match, int player, const void *data );
+void		AddSimulationStatistics( struct SimulationStatistics *total, const struct SimulationStatistics *statistics );
+int			WriteSimulationStatistics( const char *path, const struct SimulationStatistics *statistics, const struct SimulationParameters *parameters, int numPlayers );
+
+#endif
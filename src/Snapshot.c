@@ -0,0 +1,376 @@
+#include <string.h>
+#include <math.h>
+#include "Snapshot.h"
+#include "BitStream.h"
+#include "Physics.h"
+#include "Debug/Debug.h"
+
+/*
+==========================================================
+
+The bits of the changed-field mask of an encoded snapshot.
+Bit SF_PLAYER + n stands for the paddle position of player n.
+
+==========================================================
+*/
+enum SnapshotField {
+	SF_BALL_X,
+	SF_BALL_Y,
+	SF_BALL_DX,
+	SF_BALL_DY,
+	SF_PLAYER
+};
+
+/*
+==========================================================
+
+The value range and precision of a field on the wire.
+
+==========================================================
+*/
+struct FieldQuantization {
+	float	min;
+	float	max;
+	int		bits;
+};
+
+static float *			SnapshotField( struct Snapshot *snapshot, int field );
+static const float *	ConstSnapshotField( const struct Snapshot *snapshot, int field );
+static struct FieldQuantization	GetFieldQuantization( int field );
+
+/*
+====================
+SnapshotField
+
+Returns a pointer to the float that belongs to a bit of the changed-field mask.
+====================
+*/
+static float *SnapshotField( struct Snapshot *snapshot, int field ) {
+	switch( field ) {
+		case SF_BALL_X:
+			return &snapshot->ball.position.x;
+		case SF_BALL_Y:
+			return &snapshot->ball.position.y;
+		case SF_BALL_DX:
+			return &snapshot->ball.direction.dx;
+		case SF_BALL_DY:
+			return &snapshot->ball.direction.dy;
+		default:
+			return &snapshot->positions[field - SF_PLAYER];
+	}
+}
+
+/*
+====================
+ConstSnapshotField
+
+Same as SnapshotField for read-only snapshots.
+====================
+*/
+static const float *ConstSnapshotField( const struct Snapshot *snapshot, int field ) {
+	return SnapshotField( ( struct Snapshot * )snapshot, field );
+}
+
+/*
+====================
+GetFieldQuantization
+
+Returns the value range and precision of a bit of the changed-field mask.
+====================
+*/
+static struct FieldQuantization GetFieldQuantization( int field ) {
+	struct FieldQuantization result;
+
+	switch( field ) {
+		case SF_BALL_X:
+		case SF_BALL_Y:
+			result.min = -1.0f;
+			result.max = 1.0f;
+			result.bits = SNAPSHOT_POSITION_BITS;
+			break;
+		case SF_BALL_DX:
+		case SF_BALL_DY:
+			result.min = -2.0f * DEFAULT_BALL_SPEED;
+			result.max = 2.0f * DEFAULT_BALL_SPEED;
+			result.bits = SNAPSHOT_DIRECTION_BITS;
+			break;
+		default:
+			result.min = PADDLE_MIN_POS;
+			result.max = PADDLE_MAX_POS;
+			result.bits = SNAPSHOT_PADDLE_BITS;
+			break;
+	}
+	return result;
+}
+
+/*
+====================
+CaptureSnapshot
+
+Copies the geometry of a GameState into a snapshot with the given sequence number and time
+and snaps every value to its quantization grid.
+====================
+*/
+void CaptureSnapshot( struct Snapshot *snapshot, const struct GameState *state, uint32_t sequence, uint32_t time ) {
+	struct FieldQuantization	quantization;
+	float *						value;
+	float						original;
+	int							player;
+	int							field;
+
+	DebugAssert( state->numPlayers <= MAX_PLAYERS );
+
+	memset( snapshot, 0, sizeof( struct Snapshot ) );
+	snapshot->sequence = sequence;
+	snapshot->time = time;
+	snapshot->numPlayers = state->numPlayers;
+	snapshot->ball = state->ball;
+	for( player = 0; player < state->numPlayers; player++ ) {
+		snapshot->positions[player] = state->players[player].position;
+	}
+
+	for( field = 0; field < SF_PLAYER + snapshot->numPlayers; field++ ) {
+		quantization = GetFieldQuantization( field );
+		value = SnapshotField( snapshot, field );
+		original = *value;
+		*value = DequantizeFloat( QuantizeFloat( original, quantization.min, quantization.max, quantization.bits ), quantization.min, quantization.max, quantization.bits );
+
+		// Anything inside the range has to survive the round trip within the error bound.
+		DebugAssert( original < quantization.min || original > quantization.max || fabsf( *value - original ) <= QUANTIZATION_MAX_ERROR( quantization.min, quantization.max, quantization.bits ) + 1e-6f );
+		DebugAssert( QUANTIZATION_MAX_ERROR( quantization.min, quantization.max, quantization.bits ) <= SNAPSHOT_MAX_ERROR );
+	}
+}
+
+/*
+====================
+StoreSnapshot
+
+Puts a snapshot into the history, replacing the one that is SNAPSHOT_HISTORY_LENGTH sequence numbers older.
+====================
+*/
+void StoreSnapshot( struct SnapshotHistory *history, const struct Snapshot *snapshot ) {
+	history->snapshots[snapshot->sequence % SNAPSHOT_HISTORY_LENGTH] = *snapshot;
+}
+
+/*
+====================
+FindSnapshot
+
+Returns the snapshot with the given sequence number from the history or NULL if it is not in there (anymore).
+====================
+*/
+const struct Snapshot *FindSnapshot( const struct SnapshotHistory *history, uint32_t sequence ) {
+	const struct Snapshot *snapshot = &history->snapshots[sequence % SNAPSHOT_HISTORY_LENGTH];
+
+	if( sequence == 0 || snapshot->sequence != sequence ) {
+		return NULL;
+	}
+	return snapshot;
+}
+
+/*
+====================
+EncodeSnapshot
+
+Serializes a snapshot as a delta against baseline, which may be NULL to send everything.
+The snapshot is packed to the bit, most significant bit first:
+	Name		Bits					Description
+	Seq			32						Sequence number of the snapshot
+	Base		SNAPSHOT_HISTORY_BITS	How many snapshots before this one
+										the baseline is, 0 if none
+	Time		32 or SNAPSHOT_TIME_DELTA_BITS
+										Server time of the snapshot, relative
+										to the baseline if there is one
+	Mask		4 + numPlayers			Changed-field mask, see enum SnapshotField
+	Fields		see Snapshot.h each		The quantized values of the fields whose
+										bit is set, in the order of the bits
+Returns the length of the encoded snapshot in bytes or -1 if it doesn't fit into maxlen.
+====================
+*/
+int EncodeSnapshot( const struct Snapshot *snapshot, const struct Snapshot *baseline, char *buffer, int maxlen ) {
+	struct BitWriter			writer;
+	struct FieldQuantization	quantization;
+	uint32_t					values[SF_PLAYER + MAX_PLAYERS];
+	uint32_t					mask = 0;
+	int							numFields = SF_PLAYER + snapshot->numPlayers;
+	int							field;
+
+	if( baseline && ( baseline->numPlayers != snapshot->numPlayers || snapshot->sequence - baseline->sequence >= SNAPSHOT_HISTORY_LENGTH
+		|| snapshot->time - baseline->time >= ( 1u << SNAPSHOT_TIME_DELTA_BITS ) ) ) {
+		baseline = NULL;
+	}
+
+	// Compare the quantized values, so that the receiver reconstructs exactly what we have.
+	for( field = 0; field < numFields; field++ ) {
+		quantization = GetFieldQuantization( field );
+		values[field] = QuantizeFloat( *ConstSnapshotField( snapshot, field ), quantization.min, quantization.max, quantization.bits );
+		if( !baseline || values[field] != QuantizeFloat( *ConstSnapshotField( baseline, field ), quantization.min, quantization.max, quantization.bits ) ) {
+			mask |= 1u << field;
+		}
+	}
+
+	InitBitWriter( &writer, buffer, maxlen );
+	WriteBits( &writer, snapshot->sequence, 32 );
+	WriteBits( &writer, baseline ? snapshot->sequence - baseline->sequence : 0, SNAPSHOT_HISTORY_BITS );
+	if( baseline ) {
+		WriteBits( &writer, snapshot->time - baseline->time, SNAPSHOT_TIME_DELTA_BITS );
+	} else {
+		WriteBits( &writer, snapshot->time, 32 );
+	}
+	WriteBits( &writer, mask, numFields );
+	for( field = 0; field < numFields; field++ ) {
+		if( mask & ( 1u << field ) ) {
+			WriteBits( &writer, values[field], GetFieldQuantization( field ).bits );
+		}
+	}
+
+	return FlushBitWriter( &writer );
+}
+
+/*
+====================
+DecodeSnapshot
+
+Reconstructs a full snapshot from an encoded one. The baseline is looked up in the history.
+Returns 0 on success and -1 if the buffer is malformed or the baseline is unknown.
+====================
+*/
+int DecodeSnapshot( struct Snapshot *snapshot, const struct SnapshotHistory *history, int numPlayers, const char *buffer, int length ) {
+	const struct Snapshot *		baseline = NULL;
+	struct BitReader			reader;
+	struct FieldQuantization	quantization;
+	uint32_t					sequence;
+	uint32_t					baseOffset;
+	uint32_t					time;
+	uint32_t					mask;
+	int							numFields = SF_PLAYER + numPlayers;
+	int							field;
+
+	if( numPlayers > MAX_PLAYERS ) {
+		return -1;
+	}
+
+	InitBitReader( &reader, buffer, length );
+	sequence = ReadBits( &reader, 32 );
+	baseOffset = ReadBits( &reader, SNAPSHOT_HISTORY_BITS );
+	time = ReadBits( &reader, baseOffset ? SNAPSHOT_TIME_DELTA_BITS : 32 );
+	mask = ReadBits( &reader, numFields );
+
+	// Start from the baseline, or from nothing if this is a full snapshot.
+	if( baseOffset ) {
+		baseline = FindSnapshot( history, sequence - baseOffset );
+		if( !baseline || baseline->numPlayers != numPlayers ) {
+			return -1;
+		}
+		*snapshot = *baseline;
+		time += baseline->time;
+	} else {
+		memset( snapshot, 0, sizeof( struct Snapshot ) );
+		if( mask != ( 1u << numFields ) - 1 ) {
+			return -1;
+		}
+	}
+	snapshot->sequence = sequence;
+	snapshot->time = time;
+	snapshot->numPlayers = numPlayers;
+
+	for( field = 0; field < numFields; field++ ) {
+		if( mask & ( 1u << field ) ) {
+			quantization = GetFieldQuantization( field );
+			*SnapshotField( snapshot, field ) = ReadQuantized( &reader, quantization.min, quantization.max, quantization.bits );
+		}
+	}
+
+	// Everything but the padding of the last byte has to be used up.
+	if( reader.overflow || reader.position != length ) {
+		return -1;
+	}
+	return 0;
+}
+
+
+/*
+====================
+CheckSnapshotQuantization
+
+Sweeps every field of a snapshot of MAX_PLAYERS players through numSteps values, at least
+2, from the start of its range to its end, both included, and then through the values
+right inside both ends. Every snapshot goes through CaptureSnapshot, EncodeSnapshot and
+DecodeSnapshot twice: as a full snapshot, and as a delta against the one before. Writes the
+largest error of every field into maxErrors, indexed like the changed-field mask. Returns
+how many values came back further off than QUANTIZATION_MAX_ERROR of their field or than
+SNAPSHOT_MAX_ERROR, or that a delta didn't reconstruct exactly.
+====================
+*/
+int CheckSnapshotQuantization( int numSteps, float maxErrors[SNAPSHOT_NUM_FIELDS] ) {
+	struct SnapshotHistory		history;
+	struct Player				players[MAX_PLAYERS];
+	struct GameState			state = { .numPlayers = MAX_PLAYERS, .players = players, .lastHit = -1 };
+	struct Snapshot				original;
+	struct Snapshot				captured;
+	struct Snapshot				decoded;
+	struct Snapshot				delta;
+	struct FieldQuantization	quantization;
+	char						buffer[MAX_SNAPSHOT_LENGTH];
+	float						bound;
+	float						error;
+	uint32_t					sequence;
+	int							numFailures = 0;
+	int							length;
+	int							player;
+	int							field;
+	int							step;
+
+	memset( &history, 0, sizeof( history ) );
+	memset( players, 0, sizeof( players ) );
+	memset( &original, 0, sizeof( original ) );
+	for( field = 0; field < SNAPSHOT_NUM_FIELDS; field++ ) {
+		maxErrors[field] = 0.0f;
+	}
+
+	for( step = 0; step < numSteps + 2; step++ ) {
+		sequence = step + 1;
+		for( field = 0; field < SNAPSHOT_NUM_FIELDS; field++ ) {
+			quantization = GetFieldQuantization( field );
+			if( step < numSteps ) {
+				*SnapshotField( &original, field ) = quantization.min + ( quantization.max - quantization.min ) * step / ( numSteps - 1 );
+			} else {
+				*SnapshotField( &original, field ) = step == numSteps ? nextafterf( quantization.min, quantization.max ) : nextafterf( quantization.max, quantization.min );
+			}
+		}
+		state.ball = original.ball;
+		for( player = 0; player < MAX_PLAYERS; player++ ) {
+			players[player].position = original.positions[player];
+		}
+		CaptureSnapshot( &captured, &state, sequence, sequence );
+
+		// The full snapshot has to come back within the error bounds.
+		length = EncodeSnapshot( &captured, NULL, buffer, sizeof( buffer ) );
+		if( length < 0 || DecodeSnapshot( &decoded, &history, MAX_PLAYERS, buffer, length ) ) {
+			numFailures++;
+			continue;
+		}
+		for( field = 0; field < SNAPSHOT_NUM_FIELDS; field++ ) {
+			quantization = GetFieldQuantization( field );
+			bound = QUANTIZATION_MAX_ERROR( quantization.min, quantization.max, quantization.bits );
+			error = fabsf( *SnapshotField( &decoded, field ) - *SnapshotField( &original, field ) );
+			if( error > maxErrors[field] ) {
+				maxErrors[field] = error;
+			}
+			// Rounding to floats may add a little on top of the grid's own error.
+			if( error > bound + 1e-6f || error > SNAPSHOT_MAX_ERROR || bound > SNAPSHOT_MAX_ERROR ) {
+				numFailures++;
+			}
+		}
+
+		// A delta against the previous snapshot has to reconstruct exactly the same values.
+		if( step > 0 ) {
+			length = EncodeSnapshot( &captured, FindSnapshot( &history, sequence - 1 ), buffer, sizeof( buffer ) );
+			if( length < 0 || DecodeSnapshot( &delta, &history, MAX_PLAYERS, buffer, length ) || memcmp( &delta, &decoded, sizeof( delta ) ) ) {
+				numFailures++;
+			}
+		}
+		StoreSnapshot( &history, &decoded );
+	}
+	return numFailures;
+}
@@ -0,0 +1,61 @@
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+#include <stdint.h>
+#include "Game.h"
+
+#define SNAPSHOT_HISTORY_BITS 5
+#define SNAPSHOT_HISTORY_LENGTH ( 1 << SNAPSHOT_HISTORY_BITS )
+#define SNAPSHOT_TIME_DELTA_BITS 16		// Time relative to the baseline, in milliseconds
+
+// Precision of the quantized fields on the wire, in bits.
+#define SNAPSHOT_POSITION_BITS 16		// Ball position, range [-1, 1]
+#define SNAPSHOT_DIRECTION_BITS 16		// Ball direction, range [-2, 2] * DEFAULT_BALL_SPEED
+#define SNAPSHOT_PADDLE_BITS 12			// Paddle position, range [PADDLE_MIN_POS, PADDLE_MAX_POS]
+
+// How far quantization may move anything. Checked by CheckSnapshotQuantization, and for every snapshot in debug builds.
+#define SNAPSHOT_MAX_ERROR ( PADDLE_TOLERANCE / 64.0f )
+#define SNAPSHOT_NUM_FIELDS ( 4 + MAX_PLAYERS )	// Bits of the changed-field mask with every seat taken
+
+#define MAX_SNAPSHOT_LENGTH ( ( 32 + SNAPSHOT_HISTORY_BITS + 32 + 4 + MAX_PLAYERS + 2 * SNAPSHOT_POSITION_BITS + 2 * SNAPSHOT_DIRECTION_BITS + MAX_PLAYERS * SNAPSHOT_PADDLE_BITS + 7 ) / 8 )
+
+/*
+==========================================================
+
+The geometry of a GameState at one point in time, as it is
+sent over the network. All values are already snapped to the
+quantization grid, so both ends of a connection hold exactly
+the same snapshot. Sequence number 0 is never used for a real
+snapshot. The time is SDL_GetTicks() of the server when it
+took the snapshot.
+
+==========================================================
+*/
+struct Snapshot {
+	uint32_t	sequence;
+	uint32_t	time;
+	int			numPlayers;
+	struct Ball	ball;
+	float		positions[MAX_PLAYERS];
+};
+
+/*
+==========================================================
+
+The last SNAPSHOT_HISTORY_LENGTH snapshots sent to or
+received from one peer, indexed by their sequence number.
+
+==========================================================
+*/
+struct SnapshotHistory {
+	struct Snapshot	snapshots[SNAPSHOT_HISTORY_LENGTH];
+};
+
+void					CaptureSnapshot( struct Snapshot *snapshot, const struct GameState *state, uint32_t sequence, uint32_t time );
+void					StoreSnapshot( struct SnapshotHistory *history, const struct Snapshot *snapshot );
+const struct Snapshot *	FindSnapshot( const struct SnapshotHistory *history, uint32_t sequence );
+int						EncodeSnapshot( const struct Snapshot *snapshot, const struct Snapshot *baseline, char *buffer, int maxlen );
+int						DecodeSnapshot( struct Snapshot *snapshot, const struct SnapshotHistory *history, int numPlayers, const char *buffer, int length );
+int						CheckSnapshotQuantization( int numSteps, float maxErrors[SNAPSHOT_NUM_FIELDS] );
+
+#endif
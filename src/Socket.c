@@ -0,0 +1,386 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include "Socket.h"
+#include "Debug/Debug.h"
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+/*
+====================
+OpenStreamListener
+
+Listens for TCP connections on port. Returns the listening socket or NO_STREAM_SOCKET
+on failure.
+====================
+*/
+streamSocket_t OpenStreamListener( uint16_t port ) {
+#ifdef __linux__
+	struct sockaddr_in	address;
+	int					listener;
+	int					yes = 1;
+
+	listener = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+	if( listener == -1 ) {
+		return NO_STREAM_SOCKET;
+	}
+	memset( &address, 0, sizeof( address ) );
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl( INADDR_ANY );
+	address.sin_port = htons( port );
+	setsockopt( listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof( yes ) );
+	if( bind( listener, ( struct sockaddr * )&address, sizeof( address ) ) == -1 || listen( listener, SOMAXCONN ) == -1 ) {
+		DebugPrintF( "Could not listen on port %d: %s", port, strerror( errno ) );
+		close( listener );
+		return NO_STREAM_SOCKET;
+	}
+	return listener;
+#else
+	IPaddress ip;
+
+	if( SDLNet_ResolveHost( &ip, NULL, port ) ) {
+		return NO_STREAM_SOCKET;
+	}
+	return SDLNet_TCP_Open( &ip );
+#endif
+}
+
+/*
+====================
+AcceptStream
+
+Accepts a connection that is waiting on listener without blocking and writes where it
+comes from to peer, which may be NULL. Returns the new socket or NO_STREAM_SOCKET if
+nobody is waiting.
+====================
+*/
+streamSocket_t AcceptStream( streamSocket_t listener, IPaddress *peer ) {
+#ifdef __linux__
+	struct sockaddr_in	address;
+	socklen_t			addressLength = sizeof( address );
+	int					socket;
+	int					yes = 1;
+
+	socket = accept4( listener, ( struct sockaddr * )&address, &addressLength, SOCK_NONBLOCK | SOCK_CLOEXEC );
+	if( socket == -1 ) {
+		return NO_STREAM_SOCKET;
+	}
+	// Like SDL_net does, so that small packets go out right away.
+	setsockopt( socket, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof( yes ) );
+	if( peer ) {
+		peer->host = address.sin_addr.s_addr;
+		peer->port = address.sin_port;
+	}
+	return socket;
+#else
+	TCPsocket	socket = SDLNet_TCP_Accept( listener );
+	IPaddress *	address;
+
+	if( socket && peer ) {
+		address = SDLNet_TCP_GetPeerAddress( socket );
+		if( address ) {
+			*peer = *address;
+		}
+	}
+	return socket;
+#endif
+}
+
+/*
+====================
+ConnectStream
+
+Connects to a TCP server, blocking until the connection is up. Returns the new socket
+or NO_STREAM_SOCKET on failure.
+====================
+*/
+streamSocket_t ConnectStream( const IPaddress *address ) {
+#ifdef __linux__
+	struct sockaddr_in	remote;
+	int					connection;
+	int					yes = 1;
+
+	connection = socket( AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+	if( connection == -1 ) {
+		return NO_STREAM_SOCKET;
+	}
+	memset( &remote, 0, sizeof( remote ) );
+	remote.sin_family = AF_INET;
+	remote.sin_addr.s_addr = address->host;
+	remote.sin_port = address->port;
+	if( connect( connection, ( struct sockaddr * )&remote, sizeof( remote ) ) == -1 ) {
+		close( connection );
+		return NO_STREAM_SOCKET;
+	}
+	setsockopt( connection, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof( yes ) );
+	fcntl( connection, F_SETFL, fcntl( connection, F_GETFL ) | O_NONBLOCK );
+	return connection;
+#else
+	IPaddress remote = *address;
+
+	return SDLNet_TCP_Open( &remote );
+#endif
+}
+
+/*
+====================
+CloseStream
+
+Closes a socket opened by OpenStreamListener, AcceptStream or ConnectStream.
+====================
+*/
+void CloseStream( streamSocket_t socket ) {
+	if( socket == NO_STREAM_SOCKET ) {
+		return;
+	}
+#ifdef __linux__
+	close( socket );
+#else
+	SDLNet_TCP_Close( socket );
+#endif
+}
+
+/*
+====================
+SendStream
+
+Sends all of data on a stream socket, waiting up to STREAM_SEND_TIMEOUT milliseconds at
+a time for room in its send buffer. Returns 0 on success. A peer that doesn't take the
+data in time has its connection shut down, so that the next read from it reports the
+connection as lost, and -1 is returned.
+====================
+*/
+int SendStream( streamSocket_t socket, const void *data, int length ) {
+#ifdef __linux__
+	const char *	bytes = data;
+	struct pollfd	writable;
+	int				sent;
+	int				result;
+
+	while( length > 0 ) {
+		sent = SendNonBlocking( socket, bytes, length );
+		if( sent == -1 ) {
+			break;
+		}
+		bytes += sent;
+		length -= sent;
+		if( sent > 0 ) {
+			continue;
+		}
+
+		writable.fd = socket;
+		writable.events = POLLOUT;
+		result = poll( &writable, 1, STREAM_SEND_TIMEOUT );
+		if( result == 0 || ( result == -1 && errno != EINTR ) ) {
+			break;
+		}
+	}
+	if( length == 0 ) {
+		return 0;
+	}
+
+	// Part of a packet may be on its way, so the stream can't go on anyway.
+	shutdown( socket, SHUT_RDWR );
+	return -1;
+#else
+	return SDLNet_TCP_Send( socket, data, length ) < length ? -1 : 0;
+#endif
+}
+
+/*
+====================
+SendNonBlocking
+
+Sends as much of data on a stream socket as fits into its send buffer right now.
+Returns the amount of bytes sent, which may be 0, or -1 if the connection failed.
+Where we can't send without blocking, everything is sent at once.
+====================
+*/
+int SendNonBlocking( streamSocket_t socket, const void *data, int length ) {
+#ifdef __linux__
+	ssize_t sent = send( socket, data, length, MSG_DONTWAIT | MSG_NOSIGNAL );
+
+	if( sent == -1 ) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+	}
+	return ( int )sent;
+#else
+	return SDLNet_TCP_Send( socket, data, length ) < length ? -1 : length;
+#endif
+}
+
+/*
+====================
+ReceiveNonBlocking
+
+Receives up to maxlen bytes that have arrived on a stream socket. Returns the amount of
+bytes received, which may be 0, or -1 if the connection failed or the peer closed it.
+====================
+*/
+int ReceiveNonBlocking( streamSocket_t socket, void *data, int maxlen ) {
+#ifdef __linux__
+	ssize_t received = recv( socket, data, maxlen, MSG_DONTWAIT );
+
+	if( received == -1 ) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+	}
+	return received > 0 ? ( int )received : -1;
+#else
+	static _Thread_local SDLNet_SocketSet	set = NULL;
+	int										received = 0;
+
+	// One set per thread, which holds the socket only while we look at it.
+	if( !set ) {
+		set = SDLNet_AllocSocketSet( 1 );
+		if( !set ) {
+			return -1;
+		}
+	}
+	SDLNet_TCP_AddSocket( set, socket );
+	if( SDLNet_CheckSockets( set, 0 ) > 0 ) {
+		received = SDLNet_TCP_Recv( socket, data, maxlen );
+		if( received <= 0 ) {
+			received = -1;
+		}
+	}
+	SDLNet_TCP_DelSocket( set, socket );
+	return received;
+#endif
+}
+
+/*
+====================
+GetSendQueueLength
+
+Returns how many bytes sent on a stream socket the peer hasn't acknowledged yet, or -1
+if we can't tell.
+====================
+*/
+int GetSendQueueLength( streamSocket_t socket ) {
+#ifdef __linux__
+	int length;
+
+	if( socket == NO_STREAM_SOCKET || ioctl( socket, SIOCOUTQ, &length ) == -1 ) {
+		return -1;
+	}
+	return length;
+#else
+	return -1;
+#endif
+}
+
+/*
+====================
+OpenDatagramSocket
+
+Opens a UDP socket on port, or on any free port if port is 0. Returns the socket or
+NO_DATAGRAM_SOCKET on failure.
+====================
+*/
+datagramSocket_t OpenDatagramSocket( uint16_t port ) {
+#ifdef __linux__
+	struct sockaddr_in	address;
+	int					datagram;
+
+	datagram = socket( AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+	if( datagram == -1 ) {
+		return NO_DATAGRAM_SOCKET;
+	}
+	memset( &address, 0, sizeof( address ) );
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl( INADDR_ANY );
+	address.sin_port = htons( port );
+	if( bind( datagram, ( struct sockaddr * )&address, sizeof( address ) ) == -1 ) {
+		DebugPrintF( "Could not open UDP port %d: %s", port, strerror( errno ) );
+		close( datagram );
+		return NO_DATAGRAM_SOCKET;
+	}
+	return datagram;
+#else
+	return SDLNet_UDP_Open( port );
+#endif
+}
+
+/*
+====================
+CloseDatagramSocket
+
+Closes a socket opened by OpenDatagramSocket.
+====================
+*/
+void CloseDatagramSocket( datagramSocket_t socket ) {
+	if( socket == NO_DATAGRAM_SOCKET ) {
+		return;
+	}
+#ifdef __linux__
+	close( socket );
+#else
+	SDLNet_UDP_Close( socket );
+#endif
+}
+
+/*
+====================
+SendDatagramPacket
+
+Sends the packet to its address, like SDLNet_UDP_Send on channel -1. Returns 1 if it
+was sent and 0 otherwise.
+====================
+*/
+int SendDatagramPacket( datagramSocket_t socket, UDPpacket *packet ) {
+#ifdef __linux__
+	struct sockaddr_in address;
+
+	memset( &address, 0, sizeof( address ) );
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = packet->address.host;
+	address.sin_port = packet->address.port;
+	if( sendto( socket, packet->data, packet->len, 0, ( struct sockaddr * )&address, sizeof( address ) ) == -1 ) {
+		packet->status = -1;
+		return 0;
+	}
+	packet->status = packet->len;
+	return 1;
+#else
+	return SDLNet_UDP_Send( socket, -1, packet );
+#endif
+}
+
+/*
+====================
+ReceiveDatagramPacket
+
+Receives the next datagram into packet without blocking, like SDLNet_UDP_Recv. Returns
+1 if there was one, 0 if there wasn't and -1 on failure.
+====================
+*/
+int ReceiveDatagramPacket( datagramSocket_t socket, UDPpacket *packet ) {
+#ifdef __linux__
+	struct sockaddr_in	address;
+	socklen_t			addressLength = sizeof( address );
+	ssize_t				received;
+
+	received = recvfrom( socket, packet->data, packet->maxlen, MSG_DONTWAIT, ( struct sockaddr * )&address, &addressLength );
+	if( received == -1 ) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+	}
+	packet->len = ( int )received;
+	packet->channel = -1;
+	packet->address.host = address.sin_addr.s_addr;
+	packet->address.port = address.sin_port;
+	return 1;
+#else
+	return SDLNet_UDP_Recv( socket, packet );
+#endif
+}
@@ -0,0 +1,49 @@
+#ifndef _SOCKET_H
+#define _SOCKET_H
+
+#include <stdint.h>
+#include <SDL2/SDL_net.h>
+
+#define STREAM_SEND_TIMEOUT 1000	// Milliseconds SendStream waits for room in the send buffer before it gives up on the peer
+
+/*
+==========================================================
+
+The TCP and UDP sockets of the network component and the
+relay. Servers keep thousands of them open and have to wait
+on all of them at once, see struct Reactor, without ever
+blocking on a single peer. SDL_net can't do that, so on Linux
+these are plain non-blocking sockets. Everywhere else they
+are SDL_net sockets, and sends may block.
+
+Addresses are IPaddresses like in SDL_net, so host and port
+are in network byte order.
+
+==========================================================
+*/
+#ifdef __linux__
+typedef int			streamSocket_t;
+typedef int			datagramSocket_t;
+#define NO_STREAM_SOCKET -1
+#define NO_DATAGRAM_SOCKET -1
+#else
+typedef TCPsocket	streamSocket_t;
+typedef UDPsocket	datagramSocket_t;
+#define NO_STREAM_SOCKET NULL
+#define NO_DATAGRAM_SOCKET NULL
+#endif
+
+streamSocket_t		OpenStreamListener( uint16_t port );
+streamSocket_t		AcceptStream( streamSocket_t listener, IPaddress *peer );
+streamSocket_t		ConnectStream( const IPaddress *address );
+void				CloseStream( streamSocket_t socket );
+int					SendStream( streamSocket_t socket, const void *data, int length );
+int					SendNonBlocking( streamSocket_t socket, const void *data, int length );
+int					ReceiveNonBlocking( streamSocket_t socket, void *data, int maxlen );
+int					GetSendQueueLength( streamSocket_t socket );
+datagramSocket_t	OpenDatagramSocket( uint16_t port );
+void				CloseDatagramSocket( datagramSocket_t socket );
+int					SendDatagramPacket( datagramSocket_t socket, UDPpacket *packet );
+int					ReceiveDatagramPacket( datagramSocket_t socket, UDPpacket *packet );
+
+#endif